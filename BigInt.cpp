@@ -0,0 +1,658 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "BigInt.h"
+#include "ObjectType.h"
+#include "StringType.h"
+#include "Utilities.h"
+
+typedef vector<uint32_t> Limbs;
+
+/*** Magnitudes (base 2^32, little-endian, without leading zero limb) ***/
+static void Trim(Limbs &a)
+{
+  while (!a.empty() && a.back() == 0)
+    a.pop_back();
+}
+
+static int CompareMagnitude(const Limbs &a, const Limbs &b)
+{
+  if (a.size() != b.size())
+    return (a.size() < b.size()) ? -1 : 1;
+  for (size_t i = a.size(); i-- > 0; ) {
+    if (a[i] != b[i])
+      return (a[i] < b[i]) ? -1 : 1;
+  }
+  return 0;
+}
+
+static Limbs AddMagnitude(const Limbs &a, const Limbs &b)
+{
+  const Limbs &l = (a.size() >= b.size()) ? a : b;
+  const Limbs &s = (a.size() >= b.size()) ? b : a;
+  Limbs r(l.size() + 1);
+  uint64_t carry = 0;
+  for (size_t i = 0; i < l.size(); i++) {
+    uint64_t sum = (uint64_t)l[i] + ((i < s.size()) ? s[i] : 0) + carry;
+    r[i] = (uint32_t)sum;
+    carry = sum >> 32;
+  }
+  r[l.size()] = (uint32_t)carry;
+  Trim(r);
+  return r;
+}
+
+/* |a| - |b|, with |a| >= |b| */
+static Limbs SubMagnitude(const Limbs &a, const Limbs &b)
+{
+  Limbs r(a.size());
+  int64_t borrow = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    int64_t diff = (int64_t)a[i] - ((i < b.size()) ? b[i] : 0) - borrow;
+    borrow = (diff < 0);
+    r[i] = (uint32_t)(diff + (borrow << 32));
+  }
+  Trim(r);
+  return r;
+}
+
+static Limbs MulSchoolbook(const Limbs &a, const Limbs &b)
+{
+  if (a.empty() || b.empty())
+    return Limbs();
+  
+  Limbs r(a.size() + b.size());
+  for (size_t i = 0; i < a.size(); i++) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < b.size(); j++) {
+      uint64_t p = (uint64_t)a[i] * b[j] + r[i + j] + carry;
+      r[i + j] = (uint32_t)p;
+      carry = p >> 32;
+    }
+    r[i + b.size()] = (uint32_t)carry;
+  }
+  Trim(r);
+  return r;
+}
+
+/* |a| * B^|shift| added to |r| (at least as large) */
+static void AddShifted(Limbs &r, const Limbs &a, size_t shift)
+{
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < a.size() || carry; i++) {
+    uint64_t sum = (uint64_t)r[i + shift] + ((i < a.size()) ? a[i] : 0) + carry;
+    r[i + shift] = (uint32_t)sum;
+    carry = sum >> 32;
+  }
+}
+
+static Limbs MulMagnitude(const Limbs &a, const Limbs &b)
+{
+  if (min(a.size(), b.size()) < kBigIntKaratsubaThreshold)
+    return MulSchoolbook(a, b);
+  
+  /*
+   * Karatsuba: a = a1 * B^m + a0, b = b1 * B^m + b0
+   *   a * b = z2 * B^2m + (z1 - z2 - z0) * B^m + z0
+   *   with z0 = a0 * b0, z2 = a1 * b1, z1 = (a0 + a1) * (b0 + b1)
+   */
+  size_t m = max(a.size(), b.size()) / 2;
+  Limbs a0(a.begin(), a.begin() + min(m, a.size())), a1;
+  Limbs b0(b.begin(), b.begin() + min(m, b.size())), b1;
+  if (a.size() > m) a1.assign(a.begin() + m, a.end());
+  if (b.size() > m) b1.assign(b.begin() + m, b.end());
+  Trim(a0); Trim(b0);
+  
+  Limbs z0 = MulMagnitude(a0, b0);
+  Limbs z2 = MulMagnitude(a1, b1);
+  Limbs z1 = MulMagnitude(AddMagnitude(a0, a1), AddMagnitude(b0, b1));
+  z1 = SubMagnitude(SubMagnitude(z1, z0), z2);
+  
+  Limbs r(a.size() + b.size() + 1);
+  AddShifted(r, z0, 0);
+  AddShifted(r, z1, m);
+  AddShifted(r, z2, 2 * m);
+  Trim(r);
+  return r;
+}
+
+/* Divide |a| by the single limb |d| (not zero), returns the remainder */
+static uint32_t DivModSmall(Limbs &a, uint32_t d)
+{
+  uint64_t rem = 0;
+  for (size_t i = a.size(); i-- > 0; ) {
+    uint64_t cur = (rem << 32) | a[i];
+    a[i] = (uint32_t)(cur / d);
+    rem = cur % d;
+  }
+  Trim(a);
+  return (uint32_t)rem;
+}
+
+/* Knuth's algorithm D (|v| not zero) */
+static void DivModMagnitude(const Limbs &u, const Limbs &v, Limbs &q, Limbs &r)
+{
+  if (CompareMagnitude(u, v) < 0) {
+    q.clear(); r = u;
+    return;
+  }
+  if (v.size() == 1) {
+    q = u;
+    uint32_t rem = DivModSmall(q, v[0]);
+    r.clear();
+    if (rem) r.push_back(rem);
+    return;
+  }
+  
+  size_t n = v.size(), m = u.size();
+  
+  // Normalize: the top limb of the divisor has its high bit set
+  int s = __builtin_clz(v[n - 1]);
+  Limbs vn(n), un(m + 1);
+  for (size_t i = n - 1; i > 0; i--)
+    vn[i] = (v[i] << s) | (s ? (uint32_t)((uint64_t)v[i - 1] >> (32 - s)) : 0);
+  vn[0] = v[0] << s;
+  un[m] = s ? (uint32_t)((uint64_t)u[m - 1] >> (32 - s)) : 0;
+  for (size_t i = m - 1; i > 0; i--)
+    un[i] = (u[i] << s) | (s ? (uint32_t)((uint64_t)u[i - 1] >> (32 - s)) : 0);
+  un[0] = u[0] << s;
+  
+  const uint64_t base = 1ULL << 32;
+  q.assign(m - n + 1, 0);
+  for (size_t j = m - n + 1; j-- > 0; ) {
+    // Estimate the quotient limb from the two top limbs
+    uint64_t num = ((uint64_t)un[j + n] << 32) | un[j + n - 1];
+    uint64_t qhat = num / vn[n - 1];
+    uint64_t rhat = num % vn[n - 1];
+    while (qhat >= base || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+      qhat--;
+      rhat += vn[n - 1];
+      if (rhat >= base) break;
+    }
+    
+    // Multiply and subtract
+    int64_t k = 0, t;
+    for (size_t i = 0; i < n; i++) {
+      uint64_t p = qhat * vn[i];
+      t = (int64_t)un[i + j] - k - (int64_t)(p & 0xFFFFFFFF);
+      un[i + j] = (uint32_t)t;
+      k = (int64_t)(p >> 32) - (t >> 32);
+    }
+    t = (int64_t)un[j + n] - k;
+    un[j + n] = (uint32_t)t;
+    
+    q[j] = (uint32_t)qhat;
+    if (t < 0) { // Subtracted too much, add back
+      q[j]--;
+      uint64_t carry = 0;
+      for (size_t i = 0; i < n; i++) {
+        uint64_t sum = (uint64_t)un[i + j] + vn[i] + carry;
+        un[i + j] = (uint32_t)sum;
+        carry = sum >> 32;
+      }
+      un[j + n] += (uint32_t)carry;
+    }
+  }
+  
+  // Unnormalize the remainder
+  r.assign(n, 0);
+  for (size_t i = 0; i < n; i++)
+    r[i] = (un[i] >> s) | (s ? (uint32_t)((uint64_t)un[i + 1] << (32 - s)) : 0);
+  Trim(q); Trim(r);
+}
+
+/*** BigInt ***/
+BigInt::BigInt(int64_t value) : _negative(value < 0)
+{
+  uint64_t magnitude = (value < 0) ? -(uint64_t)value : (uint64_t)value;
+  _limbs.push_back((uint32_t)magnitude);
+  _limbs.push_back((uint32_t)(magnitude >> 32));
+  trim();
+}
+
+BigInt::BigInt(const vector<uint32_t> &limbs, bool negative) : _limbs(limbs), _negative(negative)
+{
+  trim();
+}
+
+void BigInt::trim()
+{
+  Trim(_limbs);
+  if (_limbs.empty())
+    _negative = false;
+}
+
+BigInt BigInt::FromString(const char *s)
+{
+  while (isspace(*s)) s++;
+  bool negative = (*s == '-');
+  if (*s == '-' || *s == '+') s++;
+  
+  // 9 digits at a time
+  Limbs limbs;
+  size_t length = 0;
+  while (isdigit(s[length])) length++;
+  size_t chunk = length % 9 ?: 9;
+  for (size_t i = 0; i < length; i += chunk, chunk = 9) {
+    uint32_t value = 0;
+    for (size_t j = i; j < i + chunk; j++)
+      value = value * 10 + (s[j] - '0');
+    
+    uint64_t carry = value;
+    for (size_t j = 0; j < limbs.size(); j++) {
+      uint64_t p = (uint64_t)limbs[j] * 1000000000 + carry;
+      limbs[j] = (uint32_t)p;
+      carry = p >> 32;
+    }
+    if (carry) limbs.push_back((uint32_t)carry);
+  }
+  return BigInt(limbs, negative);
+}
+
+bool BigInt::fitsWord(int64_t &value) const
+{
+  if (_limbs.size() > 2)
+    return false;
+  
+  uint64_t magnitude = 0;
+  if (_limbs.size() > 0) magnitude |= _limbs[0];
+  if (_limbs.size() > 1) magnitude |= (uint64_t)_limbs[1] << 32;
+  
+  // Words hold integers into [-2^62, 2^62[
+  const uint64_t limit = 1ULL << 62;
+  if ((_negative && magnitude > limit) || (!_negative && magnitude >= limit))
+    return false;
+  value = (_negative) ? -(int64_t)magnitude : (int64_t)magnitude;
+  return true;
+}
+
+int64_t BigInt::saturated() const
+{
+  uint64_t magnitude = 0;
+  if (_limbs.size() > 2)
+    return (_negative) ? INT64_MIN : INT64_MAX;
+  if (_limbs.size() > 0) magnitude |= _limbs[0];
+  if (_limbs.size() > 1) magnitude |= (uint64_t)_limbs[1] << 32;
+  if (_negative)
+    return (magnitude >= (1ULL << 63)) ? INT64_MIN : -(int64_t)magnitude;
+  return (magnitude >= (1ULL << 63)) ? INT64_MAX : (int64_t)magnitude;
+}
+
+/* Decimal digits of |a| appended to |s|, with leading zeros up to |width| digits,
+ * |powers| are 10^(9 * 2^k) (see "toString()") */
+static void AppendDecimal(const Limbs &a, const vector<Limbs> &powers, size_t width, string &s)
+{
+  if (a.size() < kBigIntDecimalThreshold || powers.size() == 1) {
+    // 9 digits per division (by 10^9), from the lowest
+    vector<uint32_t> chunks;
+    Limbs magnitude = a;
+    while (!magnitude.empty())
+      chunks.push_back(DivModSmall(magnitude, 1000000000));
+    
+    string digits;
+    char buffer[16];
+    for (size_t i = chunks.size(); i-- > 0; ) {
+      snprintf(buffer, sizeof(buffer), (i == chunks.size() - 1) ? "%u" : "%09u", chunks[i]);
+      digits += buffer;
+    }
+    if (digits.size() < width)
+      s.append(width - digits.size(), '0');
+    s += digits;
+    return;
+  }
+  
+  // Split by the largest power with at most half the limbs of |a|: high digits, then low ones
+  size_t k = powers.size() - 1;
+  while (k > 0 && powers[k].size() * 2 > a.size())
+    k--;
+  Limbs high, low;
+  DivModMagnitude(a, powers[k], high, low);
+  size_t lowWidth = (size_t)9 << k;
+  AppendDecimal(high, powers, (width > lowWidth) ? width - lowWidth : 0, s);
+  AppendDecimal(low, powers, lowWidth, s);
+}
+
+string BigInt::toString() const
+{
+  if (isZero())
+    return "0";
+  
+  // Divide and conquer, by 10^(9 * 2^k) up to about the square root
+  vector<Limbs> powers(1, Limbs(1, 1000000000));
+  while (powers.back().size() * 4 <= _limbs.size())
+    powers.push_back(MulMagnitude(powers.back(), powers.back()));
+  
+  string s = (_negative) ? "-" : "";
+  AppendDecimal(_limbs, powers, 0, s);
+  return s;
+}
+
+BigInt BigInt::Add(const BigInt &a, const BigInt &b)
+{
+  if (a._negative == b._negative)
+    return BigInt(AddMagnitude(a._limbs, b._limbs), a._negative);
+  
+  // Different signs: subtract the smallest magnitude
+  if (CompareMagnitude(a._limbs, b._limbs) >= 0)
+    return BigInt(SubMagnitude(a._limbs, b._limbs), a._negative);
+  return BigInt(SubMagnitude(b._limbs, a._limbs), b._negative);
+}
+
+BigInt BigInt::Sub(const BigInt &a, const BigInt &b)
+{
+  BigInt negB(b._limbs, !b._negative);
+  return Add(a, negB);
+}
+
+BigInt BigInt::Mul(const BigInt &a, const BigInt &b)
+{
+  return BigInt(MulMagnitude(a._limbs, b._limbs), a._negative != b._negative);
+}
+
+void BigInt::DivMod(const BigInt &a, const BigInt &b, BigInt &quotient, BigInt &remainder)
+{
+  Limbs q, r;
+  DivModMagnitude(a._limbs, b._limbs, q, r);
+  quotient = BigInt(q, a._negative != b._negative);
+  remainder = BigInt(r, a._negative); // Sign of the dividend
+}
+
+/* Two's complement of |a| on |size| limbs */
+static Limbs TwosComplement(const BigInt &a, size_t size)
+{
+  Limbs r(a.limbs());
+  r.resize(size, 0);
+  if (a.isNegative()) {
+    uint64_t carry = 1;
+    for (size_t i = 0; i < size; i++) {
+      uint64_t sum = (uint64_t)(uint32_t)~r[i] + carry;
+      r[i] = (uint32_t)sum;
+      carry = sum >> 32;
+    }
+  }
+  return r;
+}
+
+/* Value of the two's complement |r| (the top limb gives the sign) */
+static BigInt FromTwosComplement(Limbs r)
+{
+  bool negative = (r.back() >> 31);
+  if (negative) {
+    uint64_t carry = 1;
+    for (size_t i = 0; i < r.size(); i++) {
+      uint64_t sum = (uint64_t)(uint32_t)~r[i] + carry;
+      r[i] = (uint32_t)sum;
+      carry = sum >> 32;
+    }
+  }
+  return BigInt(r, negative);
+}
+
+BigInt BigInt::And(const BigInt &a, const BigInt &b)
+{
+  size_t size = max(a._limbs.size(), b._limbs.size()) + 1; // One more limb for the sign
+  Limbs ta = TwosComplement(a, size), tb = TwosComplement(b, size);
+  for (size_t i = 0; i < size; i++)
+    ta[i] &= tb[i];
+  return FromTwosComplement(ta);
+}
+
+BigInt BigInt::Or(const BigInt &a, const BigInt &b)
+{
+  size_t size = max(a._limbs.size(), b._limbs.size()) + 1;
+  Limbs ta = TwosComplement(a, size), tb = TwosComplement(b, size);
+  for (size_t i = 0; i < size; i++)
+    ta[i] |= tb[i];
+  return FromTwosComplement(ta);
+}
+
+/*** Words ***/
+/* Same layout as "strhdr" (see "getStrHdrTy()") */
+struct BigIntHeader {
+  int64_t length;
+  int64_t capacity;
+  uint32_t hash;
+  uint32_t flags;
+  int64_t refcount;
+};
+
+static BigInt WordToBigInt(int64_t word)
+{
+  if ((word & kObjectTagMask) == ObjectTypeInteger)
+    return BigInt(word >> kObjectTagBits);
+  
+  const char *digits = (const char *)((uint64_t)word >> kObjectStrTagBits);
+  const BigIntHeader *hdr = (const BigIntHeader *)digits - 1;
+  const int64_t *count = (const int64_t *)(digits + ((hdr->capacity + 1 + 7) & ~7));
+  const uint32_t *limbs = (const uint32_t *)(count + 1);
+  int64_t size = (*count < 0) ? -*count : *count;
+  return BigInt(Limbs(limbs, limbs + size), *count < 0);
+}
+
+/* Integer word if |value| fits, else a new big integer (owned by the caller), without its digits */
+static int64_t BigIntToWord(const BigInt &value)
+{
+  int64_t integer;
+  if (value.fitsWord(integer))
+    return (int64_t)((uint64_t)integer << kObjectTagBits);
+  
+  // Room for the digits of any value of this number of limbs (1234 / 4096 > log10(2)), and the sign
+  const Limbs &limbs = value.limbs();
+  int64_t capacity = ((limbs.size() * 32 * 1234) >> 12) + 1 + 1;
+  size_t limbsOffset = (capacity + 1 + 7) & ~7;
+  
+  char *alloc = (char *)malloc(sizeof(BigIntHeader) + limbsOffset + sizeof(int64_t) + limbs.size() * sizeof(uint32_t));
+  BigIntHeader *hdr = (BigIntHeader *)alloc;
+  hdr->length = 0; // Digits not written yet (see "smil_bigint_digits()")
+  hdr->capacity = capacity;
+  hdr->hash = 0;
+  hdr->flags = StringFlagBigInt;
+  hdr->refcount = 1;
+  
+  char *s = (char *)(hdr + 1);
+  s[0] = '\0';
+  int64_t *count = (int64_t *)(s + limbsOffset);
+  *count = (value.isNegative()) ? -(int64_t)limbs.size() : (int64_t)limbs.size();
+  memcpy(count + 1, limbs.data(), limbs.size() * sizeof(uint32_t));
+  
+  return (int64_t)(((uint64_t)s << kObjectStrTagBits) | kObjectStrTagHeap);
+}
+
+int64_t smil_bigint_binop(int32_t op, int64_t lhs, int64_t rhs)
+{
+  BigInt a = WordToBigInt(lhs), b = WordToBigInt(rhs);
+  switch (op) {
+    case BigIntOpAdd: return BigIntToWord(BigInt::Add(a, b));
+    case BigIntOpSub: return BigIntToWord(BigInt::Sub(a, b));
+    case BigIntOpMul: return BigIntToWord(BigInt::Mul(a, b));
+    case BigIntOpAnd: return BigIntToWord(BigInt::And(a, b));
+    case BigIntOpOr: return BigIntToWord(BigInt::Or(a, b));
+    case BigIntOpDiv:
+    case BigIntOpMod: {
+      // Never zero, asserted by the generated code (see "BinOpSlowPath()")
+      BigInt quotient, remainder;
+      BigInt::DivMod(a, b, quotient, remainder);
+      return BigIntToWord((op == BigIntOpDiv) ? quotient : remainder);
+    }
+  }
+  return 0;
+}
+
+int64_t smil_bigint_fromstr(const char *s)
+{
+  return BigIntToWord(BigInt::FromString(s));
+}
+
+int64_t smil_bigint_saturated(int64_t word)
+{
+  return WordToBigInt(word).saturated();
+}
+
+void smil_bigint_digits(int64_t word)
+{
+  char *digits = (char *)((uint64_t)word >> kObjectStrTagBits);
+  BigIntHeader *hdr = (BigIntHeader *)digits - 1;
+  string s = WordToBigInt(word).toString();
+  memcpy(digits, s.c_str(), s.size() + 1);
+  hdr->length = s.size();
+}
+
+void MapBigIntRuntime(ExecutionEngine *EE, Module *M)
+{
+  Function *F;
+  if ((F = M->getFunction("smil_bigint_binop")))
+    EE->addGlobalMapping(F, (void *)&smil_bigint_binop);
+  if ((F = M->getFunction("smil_bigint_fromstr")))
+    EE->addGlobalMapping(F, (void *)&smil_bigint_fromstr);
+  if ((F = M->getFunction("smil_bigint_saturated")))
+    EE->addGlobalMapping(F, (void *)&smil_bigint_saturated);
+  if ((F = M->getFunction("smil_bigint_digits")))
+    EE->addGlobalMapping(F, (void *)&smil_bigint_digits);
+}
+
+/*** Code generation ***/
+// i64 @smil_bigint_binop(i32 %op, i64 %lhs, i64 %rhs)
+Value * BigIntBinOp(BigIntOp op, Value *LHSWord, Value *RHSWord, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  // Host function (see "MapBigIntRuntime()")
+  Function *BinOpF = cast<Function>(M->getOrInsertFunction("smil_bigint_binop", Type::getInt64Ty(C),
+                                                           Type::getInt32Ty(C),
+                                                           Type::getInt64Ty(C),
+                                                           Type::getInt64Ty(C),
+                                                           (Type *)0));
+  return B.CreateCall(BinOpF, ArrayRef<Value *>{ B.getInt32(op), LHSWord, RHSWord });
+}
+
+// i64 @smil_bigint_fromstr(i8* %str)
+Value * BigIntFromStr(Value *Str, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *FromStrF = cast<Function>(M->getOrInsertFunction("smil_bigint_fromstr", Type::getInt64Ty(C),
+                                                             Type::getInt8PtrTy(C),
+                                                             (Type *)0));
+  return B.CreateCall(FromStrF, Str);
+}
+
+// i64 @smil_bigint_saturated(i64 %word)
+Value * BigIntSaturated(Value *Word, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *SaturatedF = cast<Function>(M->getOrInsertFunction("smil_bigint_saturated", Type::getInt64Ty(C),
+                                                               Type::getInt64Ty(C),
+                                                               (Type *)0));
+  return B.CreateCall(SaturatedF, Word);
+}
+
+// i1 @wordisbigint(i64 %word)
+Value * WordIsBigInt(Value *Word, Module *M, IRBuilder<> &B)
+{
+  /*
+   * bool wordisbigint(long word) {
+   *   if ((word & kObjectStrTagMask) != kObjectStrTagHeap)
+   *     return false;
+   *   return (header((char *)(word >> 2))->flags & StringFlagBigInt) != 0;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *IsBigF = cast<Function>(M->getOrInsertFunction("wordisbigint", Type::getInt1Ty(C),
+                                                           Type::getInt64Ty(C),
+                                                           (Type *)0));
+  if (IsBigF->empty()) {
+    Argument *WArg = IsBigF->arg_begin();
+    WArg->setName("word");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", IsBigF);
+    BasicBlock *HeapBB = BasicBlock::Create(C, "HeapBlock", IsBigF);
+    BasicBlock *OtherBB = BasicBlock::Create(C, "OtherBlock", IsBigF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *IsHeap = EB.CreateICmpEQ(EB.CreateAnd(WArg, EB.getInt64(kObjectStrTagMask)),
+                                    EB.getInt64(kObjectStrTagHeap));
+    EB.CreateCondBr(IsHeap, HeapBB, OtherBB);
+    
+    /* Heap Block */
+    IRBuilder<> HB(HeapBB);
+    Value *Str = HB.CreateIntToPtr(HB.CreateLShr(WArg, HB.getInt64(kObjectStrTagBits)),
+                                   Type::getInt8PtrTy(C));
+    Value *Flags = HB.CreateLoad(HB.CreateStructGEP(getStrHdrTy(C), StrHeader(Str, HB), StrHdrFieldFlags));
+    HB.CreateRet(HB.CreateICmpNE(HB.CreateAnd(Flags, HB.getInt32(StringFlagBigInt)), HB.getInt32(0)));
+    
+    /* Other Block */
+    IRBuilder<> OB(OtherBB);
+    OB.CreateRet(OB.getFalse());
+  }
+  
+  // Call "wordisbigint" function
+  return B.CreateCall(IsBigF, Word);
+}
+
+// void @bigintdigits(i64 %word)
+void BigIntDigits(Value *Word, Module *M, IRBuilder<> &B)
+{
+  /*
+   * void bigintdigits(long word) {
+   *   if ((word & kObjectStrTagMask) != kObjectStrTagHeap)
+   *     return;
+   *   strhdr *hdr = header((char *)(word >> 2));
+   *   if ((hdr->flags & StringFlagBigInt) && hdr->length == 0)
+   *     smil_bigint_digits(word);
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *DigitsF = cast<Function>(M->getOrInsertFunction("bigintdigits", Type::getVoidTy(C),
+                                                            Type::getInt64Ty(C),
+                                                            (Type *)0));
+  if (DigitsF->empty()) {
+    Argument *WArg = DigitsF->arg_begin();
+    WArg->setName("word");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", DigitsF);
+    BasicBlock *HeapBB = BasicBlock::Create(C, "HeapBlock", DigitsF);
+    BasicBlock *WriteBB = BasicBlock::Create(C, "WriteBlock", DigitsF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", DigitsF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *IsHeap = EB.CreateICmpEQ(EB.CreateAnd(WArg, EB.getInt64(kObjectStrTagMask)),
+                                    EB.getInt64(kObjectStrTagHeap));
+    EB.CreateCondBr(IsHeap, HeapBB, DoneBB);
+    
+    /* Heap Block */
+    IRBuilder<> HB(HeapBB);
+    Value *Str = HB.CreateIntToPtr(HB.CreateLShr(WArg, HB.getInt64(kObjectStrTagBits)),
+                                   Type::getInt8PtrTy(C));
+    Value *Hdr = StrHeader(Str, HB);
+    Value *Flags = HB.CreateLoad(HB.CreateStructGEP(getStrHdrTy(C), Hdr, StrHdrFieldFlags));
+    Value *Length = HB.CreateLoad(HB.CreateStructGEP(getStrHdrTy(C), Hdr, StrHdrFieldLength));
+    Value *Pending = HB.CreateAnd(HB.CreateICmpNE(HB.CreateAnd(Flags, HB.getInt32(StringFlagBigInt)), HB.getInt32(0)),
+                                  HB.CreateICmpEQ(Length, HB.getInt64(0)));
+    HB.CreateCondBr(Pending, WriteBB, DoneBB, UnlikelyBranchWeights(C));
+    
+    /* Write Block */
+    IRBuilder<> WB(WriteBB);
+    // Host function (see "MapBigIntRuntime()")
+    Function *WriteF = cast<Function>(M->getOrInsertFunction("smil_bigint_digits", Type::getVoidTy(C),
+                                                             Type::getInt64Ty(C),
+                                                             (Type *)0));
+    WB.CreateCall(WriteF, WArg);
+    WB.CreateBr(DoneBB);
+    
+    /* Done Block */
+    IRBuilder<> DB(DoneBB);
+    DB.CreateRetVoid();
+  }
+  
+  // Call "bigintdigits" function
+  B.CreateCall(DigitsF, Word);
+}
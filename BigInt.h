@@ -0,0 +1,109 @@
+#ifndef SMIL_BIGINT_H
+#define SMIL_BIGINT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+using namespace std;
+using namespace llvm;
+
+/*
+ * Integers are words (63 bits) on the fast path, arithmetic is checked (overflow intrinsics) and
+ * promoted to a big integer only on overflow. A big integer is a heap string (StringFlagBigInt)
+ * holding its decimal digits (so it can be printed, concatenated or used as a name like any
+ * integer converted to string), followed by its limbs:
+ *   struct strhdr hdr; char digits[capacity + 1]; (padding to 8 bytes) long count; unsigned limbs[|count|];
+ * with |count| negative for a negative value. The digits are only written when the string is first
+ * read (length of zero until then, see "WordToStr()"), not by each operation.
+ * Results that fit into a word are always returned as integer words.
+ */
+#define kBigIntKaratsubaThreshold 32 // Minimum number of limbs to multiply with Karatsuba
+#define kBigIntDecimalThreshold 64 // Minimum number of limbs to convert to decimal by divide and conquer
+
+enum BigIntOp {
+  BigIntOpAdd = 0,
+  BigIntOpSub,
+  BigIntOpMul,
+  BigIntOpDiv,
+  BigIntOpMod,
+  BigIntOpAnd,
+  BigIntOpOr
+};
+
+/* Arbitrary-precision integer (host side), sign and magnitude (base 2^32, little-endian) */
+class BigInt {
+  vector<uint32_t> _limbs; // Without leading zero limb (empty for zero)
+  bool _negative;
+
+  void trim();
+
+public:
+  BigInt() : _negative(false) {}
+  BigInt(int64_t value);
+  BigInt(const vector<uint32_t> &limbs, bool negative);
+
+  /* Decimal string, with an optional '-' */
+  static BigInt FromString(const char *s);
+
+  bool isZero() const { return _limbs.empty(); }
+  bool isNegative() const { return _negative; }
+  const vector<uint32_t> & limbs() const { return _limbs; }
+
+  /* Return true and set |value| if it fits into a word (63 bits) */
+  bool fitsWord(int64_t &value) const;
+
+  /* Value clamped to [INT64_MIN, INT64_MAX] */
+  int64_t saturated() const;
+
+  string toString() const;
+
+  static BigInt Add(const BigInt &a, const BigInt &b);
+  static BigInt Sub(const BigInt &a, const BigInt &b);
+  static BigInt Mul(const BigInt &a, const BigInt &b);
+  /* Truncated division (like C), |b| must not be zero */
+  static void DivMod(const BigInt &a, const BigInt &b, BigInt &quotient, BigInt &remainder);
+  /* Bitwise operations on the two's complement (infinite sign extension) */
+  static BigInt And(const BigInt &a, const BigInt &b);
+  static BigInt Or(const BigInt &a, const BigInt &b);
+};
+
+/* Runtime entry points (host functions called by the generated code, see "MapBigIntRuntime()") */
+extern "C" {
+  /* |Op| on two words (integers or big integers), returns a word (a new big integer if needed) */
+  int64_t smil_bigint_binop(int32_t op, int64_t lhs, int64_t rhs);
+  /* Word of the decimal string |s| (an integer, or a new big integer if too large) */
+  int64_t smil_bigint_fromstr(const char *s);
+  /* Value of the big integer word |word| clamped to [INT64_MIN, INT64_MAX] */
+  int64_t smil_bigint_saturated(int64_t word);
+  /* Write the digits of the big integer word |word| (not written yet) */
+  void smil_bigint_digits(int64_t word);
+}
+
+/* Map the runtime entry points used by |M| to the host functions */
+void MapBigIntRuntime(ExecutionEngine *EE, Module *M);
+
+// i64 @smil_bigint_binop(i32 %op, i64 %lhs, i64 %rhs)
+Value * BigIntBinOp(BigIntOp op, Value *LHSWord, Value *RHSWord, Module *M, IRBuilder<> &B);
+
+// i64 @smil_bigint_fromstr(i8* %str)
+Value * BigIntFromStr(Value *Str, Module *M, IRBuilder<> &B);
+
+// i64 @smil_bigint_saturated(i64 %word)
+Value * BigIntSaturated(Value *Word, Module *M, IRBuilder<> &B);
+
+/* Write the digits of |Word| if it is a big integer without its digits yet (nothing for other words) */
+// void @bigintdigits(i64 %word)
+void BigIntDigits(Value *Word, Module *M, IRBuilder<> &B);
+
+/* True (i1) if |Word| is a big integer (a heap string with StringFlagBigInt) */
+// i1 @wordisbigint(i64 %word)
+Value * WordIsBigInt(Value *Word, Module *M, IRBuilder<> &B);
+
+#endif // SMIL_BIGINT_H
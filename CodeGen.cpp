@@ -1,13 +1,67 @@
 #include "CodeGen.h"
 
 /*** Inputs helper ***/
-Value * InputAtIndex(int index /* >= 0 */, Module *M, IRBuilder<> &B)
+/* Name of the variable holding the input |index| (":$", ":$:$", etc.) */
+static string InputName(int index /* >= 0 */)
 {
   string name;
   for (int i = 0; i < (index + 1); i++)
     name += tok_input;
+  return name;
+}
+
+Value * InputAtIndex(int index /* >= 0 */, Module *M, IRBuilder<> &B)
+{
+  string name = InputName(index);
+  return VariableNamed(name, M, B);
+}
+
+/*** Variables helper ***/
+/* Return true if |name| is the canonical decimal form of an integer (same rule as "@strtointkey") */
+static bool isIntegerName(const string &name, long long &value)
+{
+  if (name.empty())
+    return false;
+  
+  value = atoll(name.c_str());
+  ostringstream ostr;
+  ostr << value;
+  return (ostr.str() == name);
+}
+
+/* Variables looked up into loop preheaders (one scope per loop being generated),
+ * variables are never moved so their %obj* stay valid for the whole loop */
+static vector< map<string, Value *> > __HoistedVariables;
+static map<Expr *, Value *> __HoistedNamedVariables;
+
+/* Set when the next binary operator generated is stored into a variable or pushed (its result
+ * is then allocated on the heap), else its result is a temporary from the region (see "Region.h") */
+static bool __TemporaryEscapes = false;
+
+/* Set when the next binary operator generated is assigned to the variable of its left operand
+ * ("a = a + b"), it then owns the word of this variable (released, or modified in place) */
+static bool __OwnsLHSVariable = false;
+
+/* Object of the variable the next binary operator generated is assigned to (not inversed), its
+ * result is then constructed directly into this variable (no temporary object to copy from) */
+static Value *__ResultObject = NULL;
+
+Value * VariableNamed(string &name, Module *M, IRBuilder<> &B)
+{
+  vector< map<string, Value *> >::reverse_iterator it;
+  for (it = __HoistedVariables.rbegin(); it != __HoistedVariables.rend(); it++) {
+    map<string, Value *>::iterator found = it->find(name);
+    if (found != it->end())
+      return found->second;
+  }
+  
+  long long value;
+  if (isIntegerName(name, value))
+    return GetPtrOrInsertInt(B.getInt64(value), M, B);
+  
+  // Hash of the name computed now (same as "@strhash")
   Value *NameV = CxxStrToVal(name, M, B);
-  return GetPtrOrInsert(NameV, M, B);
+  return GetPtrOrInsertHashed(NameV, B.getInt32(HostStrHash(name)), M, B);
 }
 
 bool canGen(Expr *expr)
@@ -40,15 +94,88 @@ Value * InputExpr::CodeGen(Module *M, IRBuilder<> &B)
 /*** Variable Expression ***/
 Value * VarExpr::CodeGen(Module *M, IRBuilder<> &B)
 {
-  Value *NameV = CxxStrToVal(_name, M, B);
-  return GetPtrOrInsert(NameV, M, B);
+  return VariableNamed(_name, M, B);
+}
+
+/*** Reference counting helpers ***/
+/* Binary operators return a new object (a temporary) owning its word, other expressions return
+ * a variable (the table or the hoisted lookup owns the word, see "RefCount.h") */
+static bool IsTemporary(Expr *expr)
+{
+  return isa<BinOpExpr>(expr);
+}
+
+/* Release the word of |Obj| (returned by |expr|) once consumed, if it's a temporary */
+static void ReleaseTemporary(Expr *expr, Value *Obj, Module *M, IRBuilder<> &B)
+{
+  if (IsTemporary(expr))
+    ObjRelease(LoadObjWord(Obj, B), M, B);
+}
+
+/* True for "a = a + b", "a = a - b" and "a = a / b" (the variable |a| only, not inversed),
+ * operators that can modify a string left operand in place */
+static bool IsSelfUpdate(AssignableExpr *LHS, Expr *RHS)
+{
+  BinOpExpr *BinOp = dyn_cast<BinOpExpr>(RHS);
+  if (!BinOp || !isa<VarExpr>(LHS) || LHS->getInversed())
+    return false;
+  
+  Token op = BinOp->getOp();
+  if (op != tok_add && op != tok_sub && op != tok_div)
+    return false;
+  
+  VarExpr *Var = dyn_cast<VarExpr>(BinOp->getLHS());
+  return (Var && !Var->getInversed() && Var->getName() == LHS->getName());
+}
+
+/* New object into the entry block (not to grow the stack at each iteration of a loop) */
+static Value * EntryObject(IRBuilder<> &B)
+{
+  BasicBlock &EntryBB = B.GetInsertBlock()->getParent()->getEntryBlock();
+  IRBuilder<> EntryB(&EntryBB, EntryBB.begin());
+  return EntryB.CreateAlloca(getObjTy(B.getContext()));
 }
 
 /*** Named Variable Expression ***/
 Value * NamedVarExpr::CodeGen(Module *M, IRBuilder<> &B)
 {
-  Value *NameV = ObjToStr(_expr->CodeGen(M, B), M, B);
-  return GetPtrOrInsert(NameV, M, B);
+  LLVMContext &C = M->getContext();
+  
+  // Invariant into the loop being generated, already looked up into its preheader
+  map<Expr *, Value *>::iterator found = __HoistedNamedVariables.find(this);
+  if (found != __HoistedNamedVariables.end())
+    return found->second;
+  
+  Value *NameObj = _expr->CodeGen(M, B);
+  Value *NameWord = LoadObjWord(NameObj, B);
+  Value *IsInt = WordIsInteger(NameWord, B);
+  
+  Function *F = B.GetInsertBlock()->getParent();
+  BasicBlock *IntBB = BasicBlock::Create(C, "NamedVar.IntegerBlock", F);
+  BasicBlock *StrBB = BasicBlock::Create(C, "NamedVar.StringBlock", F);
+  BasicBlock *DoneBB = BasicBlock::Create(C, "NamedVar.DoneBlock", F);
+  B.CreateCondBr(IsInt, IntBB, StrBB);
+  
+  /* Integer Block: array-like access, no conversion to string */
+  IRBuilder<> IntB(IntBB);
+  Value *Key = WordToInt64(NameWord, IntB);
+  Value *IntPtr = GetPtrOrInsertInt(Key, M, IntB);
+  IntB.CreateBr(DoneBB);
+  
+  /* String Block: the name is only converted (and looked up) when the site's inline cache misses */
+  IRBuilder<> StrB(StrBB);
+  Value *StrPtr = GetPtrOrInsertCached(NameObj, M, StrB);
+  StrB.CreateBr(DoneBB);
+  
+  B.SetInsertPoint(DoneBB);
+  PHINode *PHI = B.CreatePHI(getObjPtrTy(C), 2);
+  PHI->addIncoming(IntPtr, IntBB);
+  PHI->addIncoming(StrPtr, StrBB);
+  
+  // The inline cache and the table keep their own key
+  if (IsTemporary(_expr))
+    ObjRelease(NameWord, M, B);
+  return PHI;
 }
 
 /*** Initialisation Expression ***/
@@ -56,8 +183,23 @@ Value * InitExpr::CodeGen(Module *M, IRBuilder<> &B)
 {
   LLVMContext &C = M->getContext();
   
+  // The result of a binary operator is moved to the variable (not inversed)
+  __TemporaryEscapes = IsTemporary(_RHS) && !cast<AssignableExpr>(_LHS)->getInversed();
+  bool selfUpdate = __OwnsLHSVariable = IsSelfUpdate(cast<AssignableExpr>(_LHS), _RHS);
+  
+  // "a = b + c": the variable is looked up first and the operator stores its result into it
+  // (operands are loaded before), the word it held is released once replaced
+  bool constructsInLHS = __TemporaryEscapes && isa<VarExpr>(_LHS);
+  Value *LHSPtr = NULL, *OldWord = NULL;
+  if (constructsInLHS) {
+    __ResultObject = LHSPtr = _LHS->CodeGen(M, B);
+    OldWord = (selfUpdate) ? NULL : LoadObjWord(LHSPtr, B);
+  }
   Value *RHSPtr = _RHS->CodeGen(M, B);
-  Value *LHSPtr = _LHS->CodeGen(M, B);
+  __TemporaryEscapes = __OwnsLHSVariable = false;
+  __ResultObject = NULL;
+  if (!constructsInLHS)
+    LHSPtr = _LHS->CodeGen(M, B);
   
   /* Possible cases:
    * LHS and RHS
@@ -75,18 +217,13 @@ Value * InitExpr::CodeGen(Module *M, IRBuilder<> &B)
   if (LHSInversed &&
       (RHSisVar && cast<VarExpr>(_RHS)->getInversed())) { // x(LHS) && x(RHS)
     
-    Value *LHSDataPtr = B.CreateStructGEP(getObjTy(C), LHSPtr, ObjectFieldData);
-    Value *RHSDataPtr = B.CreateStructGEP(getObjTy(C), RHSPtr, ObjectFieldData);
-    
     // Inversed: set |V| to zero if |int(V)| != 1 or if |str(V)| is a ptr != NULL
-    Value *ResEQZ = B.CreateICmpEQ(B.CreateLoad(RHSDataPtr), B.getInt64(0));
+    // (only the integer zero has a null word, strings are tagged)
+    Value *ResEQZ = B.CreateICmpEQ(LoadObjWord(RHSPtr, B), Int64ToWord(B.getInt64(0), B));
     Value *RHSDataNot = B.CreateSelect(ResEQZ, B.getInt64(0), B.getInt64(1));
-    B.CreateStore(B.CreateIntCast(RHSDataNot, Type::getInt64Ty(C), false),
-                  LHSDataPtr);
-    
-    /* Update the index of the field used */
-    B.CreateStore(B.getInt1(ObjectTypeInteger),
-                  B.CreateStructGEP(getObjTy(C), LHSPtr, ObjectFieldType));
+    Value *OldWord = LoadObjWord(LHSPtr, B);
+    StoreObjWord(Int64ToWord(RHSDataNot, B), LHSPtr, B);
+    ObjRelease(OldWord, M, B);
     
   } else if ((LHSInversed
               && ((RHSisVar && !cast<VarExpr>(_RHS)->getInversed())
@@ -95,116 +232,192 @@ Value * InitExpr::CodeGen(Module *M, IRBuilder<> &B)
                     && (RHSisVar && cast<VarExpr>(_RHS)->getInversed()))
              ) { // ( ( x(LHS) && ( RHS || Input ) ) || ( LHS && x(RHS) ) )
     
-    Value *LHSDataPtr = B.CreateStructGEP(getObjTy(C), LHSPtr, ObjectFieldData);
-    Value *RHSDataPtr = B.CreateStructGEP(getObjTy(C), RHSPtr, ObjectFieldData);
-    
     // Inversed: set |V| to zero if |int(V)| != 1 or if |str(V)| is a ptr != NULL
-    Value *ResEQZ = B.CreateICmpEQ(B.CreateLoad(RHSDataPtr), B.getInt64(0));
+    Value *ResEQZ = B.CreateICmpEQ(LoadObjWord(RHSPtr, B), Int64ToWord(B.getInt64(0), B));
     Value *RHSDataNot = B.CreateSelect(ResEQZ, B.getInt64(1), B.getInt64(0));
-    B.CreateStore(B.CreateIntCast(RHSDataNot, Type::getInt64Ty(C), false),
-                  LHSDataPtr);
+    Value *OldWord = LoadObjWord(LHSPtr, B);
+    StoreObjWord(Int64ToWord(RHSDataNot, B), LHSPtr, B);
+    ObjRelease(OldWord, M, B);
+    ReleaseTemporary(_RHS, RHSPtr, M, B);
     
-    // Update the index of the field used
-    B.CreateStore(B.getInt1(ObjectTypeInteger),
-                  B.CreateStructGEP(getObjTy(C), LHSPtr, ObjectFieldType));
+  } else if (constructsInLHS) {
+    // Already stored by the binary operator
+    if (OldWord) // Else already released (or modified in place) by the binary operator
+      ObjRelease(OldWord, M, B);
     
   } else {
-    Value *RHSDataPtr = B.CreateStructGEP(getObjTy(C), RHSPtr, ObjectFieldData);
-    B.CreateStore(B.CreateLoad(RHSDataPtr),
-                  B.CreateStructGEP(getObjTy(C), LHSPtr, ObjectFieldData));
-    
-    Value *RHSTypePtr = B.CreateStructGEP(getObjTy(C), RHSPtr, ObjectFieldType);
-    B.CreateStore(B.CreateLoad(RHSTypePtr),
-                  B.CreateStructGEP(getObjTy(C), LHSPtr, ObjectFieldType));
+    // The word of a temporary is moved (no count change), else shared (retained before the release,
+    // the old word can be the same string)
+    Value *OldWord = LoadObjWord(LHSPtr, B);
+    Value *Word = LoadObjWord(RHSPtr, B);
+    StoreObjWord(Word, LHSPtr, B);
+    if (!IsTemporary(_RHS))
+      ObjRetain(Word, M, B);
+    if (!selfUpdate) // Else already released (or modified in place) by the binary operator
+      ObjRelease(OldWord, M, B);
   }
   
   return LHSPtr;
 }
 
-/*** Binary Operator Expression ***/
-Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
+/* Buffer for the result (of |Length| bytes) of a string operation: a buffer of the site
+ * (into the entry block) if the result will be stored inline (see "PackStr()"), else a new string
+ * (from the region if the result does not escape the statement) */
+static Value * NewStrBuffer(Value *Length, bool escapes, Module *M, IRBuilder<> &B)
 {
   LLVMContext &C = M->getContext();
   
-  if (_LHS == NULL) {
-    out() << "|LHS| == NULL" << "\n";
-    exit(1);
-  }
-  
-  if (_RHS == NULL) {
-    out() << "|RHS| == NULL" << "\n";
-    exit(1);
-  }
+  BasicBlock &EntryBB = B.GetInsertBlock()->getParent()->getEntryBlock();
+  IRBuilder<> EntryB(&EntryBB, EntryBB.begin());
+  Value *Scratch = EntryB.CreateAlloca(Type::getInt8Ty(C),
+                                       EntryB.getInt64(kObjectInlineStrMaxLength + 1), "scratchstr");
   
-  Value *LHSV = _LHS->CodeGen(M, B);
-  Value *LHSFieldPtr = B.CreateStructGEP(getObjTy(C), LHSV, ObjectFieldType);
-  Value *LHSisInt = B.CreateICmpEQ(B.CreateLoad(LHSFieldPtr),
-                                   B.getInt1(ObjectTypeInteger));
-  Value *LHSDataPtr = B.CreateStructGEP(getObjTy(C), LHSV, ObjectFieldData);
-  LHSDataPtr->setName("LHSDataPtr");
+  return (escapes) ? StrBuffer(Length, Scratch, M, B) : RegionStrBuffer(Length, Scratch, M, B);
+}
+
+/* Keep the first |Length| bytes of the left operand in place if it's the string operand
+ * (|StrIsLHS|), a heap string only owned by the operator and |Length| is into [0, length],
+ * then go to |DoneBB|; else |B| continues to build a new string */
+static void TruncateOwnedLHS(Value *LHSWord, Value *StrIsLHS, Value *Length, Value *StrLen,
+                             Value *ObjPtr, Value *ReleaseLHSPtr, BasicBlock *DoneBB,
+                             Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  Function *F = B.GetInsertBlock()->getParent();
   
-  Value *RHSV = _RHS->CodeGen(M, B);
-  Value *RHSFieldPtr = B.CreateStructGEP(getObjTy(C), RHSV, ObjectFieldType);
-  Value *RHSisInt = B.CreateICmpEQ(B.CreateLoad(RHSFieldPtr),
-                                   B.getInt1(ObjectTypeInteger));
-  Value *RHSDataPtr = B.CreateStructGEP(getObjTy(C), RHSV, ObjectFieldData);
-  LHSDataPtr->setName("RHSDataPtr");
+  BasicBlock *CheckUniqueBB = BasicBlock::Create(C, "CheckUniqueBlock", F);
+  BasicBlock *TruncateBB = BasicBlock::Create(C, "TruncateBlock", F);
+  BasicBlock *CopyBB = BasicBlock::Create(C, "CopyBlock", F);
   
-  Value *ObjPtr = B.CreateAlloca(getObjTy(C));
-  ObjPtr->setName("objPtr");
+  Value *IsHeapStr = B.CreateAnd(StrIsLHS, B.CreateNot(WordIsInlineStr(LHSWord, B)));
+  Value *IsPrefix = B.CreateICmpULE(Length, StrLen); // Negative lengths too
+  B.CreateCondBr(B.CreateAnd(IsHeapStr, IsPrefix), CheckUniqueBB, CopyBB);
   
-  Function *F = B.GetInsertBlock()->getParent();
-  BasicBlock *IntBB = BasicBlock::Create(C, "IntegerBlock", F);
-  BasicBlock *StrBB = BasicBlock::Create(C, "StringBlock", F);
+  IRBuilder<> CUB(CheckUniqueBB);
+  Value *Str = CUB.CreateIntToPtr(CUB.CreateLShr(LHSWord, CUB.getInt64(kObjectStrTagBits)),
+                                  Type::getInt8PtrTy(C));
+  CUB.CreateCondBr(StrIsUnique(Str, M, CUB), TruncateBB, CopyBB);
   
-  B.CreateCondBr(B.CreateAnd(LHSisInt, RHSisInt),
-                 IntBB,
-                 StrBB);
+  IRBuilder<> TB(TruncateBB);
+  StoreObjWord(StrToWord(StrTruncate(Str, Length, M, TB), TB), ObjPtr, TB);
+  TB.CreateStore(TB.getInt64(0), ReleaseLHSPtr); // Moved to the result
+  TB.CreateBr(DoneBB);
   
-  /* Only integers block */
-  IRBuilder<> IntB(IntBB);
-  B.SetInsertPoint(IntBB);
+  B.SetInsertPoint(CopyBB);
+}
+
+/* Value of an integer word or of a big integer (saturated), the count of string operators */
+static Value * NumWordToInt64(Value *Word, Module *M, IRBuilder<> &B)
+{
+  return B.CreateSelect(WordIsInteger(Word, B), WordToInt64(Word, B), BigIntSaturated(Word, M, B));
+}
+
+/* Message of the "SMILDividedByZero" exception, for integer and string divisions */
+static Value * DiviseByZeroMessage(IRBuilder<> &B)
+{
+  static Value *GDiviseByZeroAssertMessage = NULL;
+  if (!GDiviseByZeroAssertMessage) {
+    GDiviseByZeroAssertMessage = B.CreateGlobalString("Can not divise by zero (SMILDividedByZero)",
+                                                      "smil.divise.by.zero.assert.message");
+  }
+  return GDiviseByZeroAssertMessage;
+}
+
+/* Outlined slow path of the binary operator |op| (anything but two integers without overflow),
+ * one function per operator and kind of site (escaping result, owned left operand), with the position
+ * of the site as arguments for the assertions */
+// void @binop.<op>.slow(i64 %lhs, i64 %rhs, %obj* %result, i64* %releaselhs, i32 %line, i32 %col)
+static Function * BinOpSlowPath(int op, bool escapes, bool ownsLHS, Module *M)
+{
+  LLVMContext &C = M->getContext();
   
-  Instruction::BinaryOps Op = (_op == tok_add) ? Instruction::Add :
-  /*                       */ (_op == tok_sub) ? Instruction::Sub :
-  /*                       */ (_op == tok_mul) ? Instruction::Mul :
-  /*                       */ (_op == tok_div) ? Instruction::UDiv : // @TODO: Or signed "SDiv"?
-  /*                       */ (_op == tok_mod) ? Instruction::URem : // @TODO: Or signed "SRem"?
-  /*                       */ (_op == tok_and) ? Instruction::And :
-  /*                                          */ Instruction::Or;
+  string name = (op == tok_add) ? "add" :
+  /*         */ (op == tok_sub) ? "sub" :
+  /*         */ (op == tok_mul) ? "mul" :
+  /*         */ (op == tok_div) ? "div" :
+  /*         */ (op == tok_mod) ? "mod" :
+  /*         */ (op == tok_and) ? "and" :
+  /*                           */ "or";
+  name = "binop." + name + ".slow" + ((escapes) ? ".escaping" : "") + ((ownsLHS) ? ".owned" : "");
   
-  Value *Result = IntB.CreateBinOp(Op,
-                                   IntB.CreateLoad(LHSDataPtr),
-                                   IntB.CreateLoad(RHSDataPtr));
+  Function *F = cast<Function>(M->getOrInsertFunction(name, Type::getVoidTy(C),
+                                                      Type::getInt64Ty(C),
+                                                      Type::getInt64Ty(C),
+                                                      getObjPtrTy(C),
+                                                      Type::getInt64PtrTy(C),
+                                                      Type::getInt32Ty(C),
+                                                      Type::getInt32Ty(C),
+                                                      (Type *)0));
+  if (!F->empty())
+    return F;
   
-  IntB.CreateStore(Result,
-                   IntB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldData));
+  // Laid out away from the inline fast paths, and kept outlined
+  F->addFnAttr(Attribute::Cold);
+  F->addFnAttr(Attribute::NoInline);
   
-  IntB.CreateStore(IntB.getInt1(ObjectTypeInteger),
-                   IntB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldType));
+  Function::arg_iterator it = F->arg_begin();
+  Value *LHSWord = it;
+  LHSWord->setName("lhs");
+  Value *RHSWord = ++it;
+  RHSWord->setName("rhs");
+  Value *ObjPtr = ++it;
+  ObjPtr->setName("result");
+  Value *ReleaseLHSPtr = ++it; // NULL if the left operand is not owned
+  ReleaseLHSPtr->setName("releaselhs");
+  Value *LineArg = ++it;
+  LineArg->setName("line");
+  Value *ColArg = ++it;
+  ColArg->setName("col");
   
+  BasicBlock *NumBB = BasicBlock::Create(C, "NumberBlock", F);
+  BasicBlock *BigBB = BasicBlock::Create(C, "BigIntegerBlock", F);
+  BasicBlock *StrBB = BasicBlock::Create(C, "StringBlock", F);
   BasicBlock *EndBB = BasicBlock::Create(C, "EndBlock", F);
-  IntB.CreateBr(EndBB);
+  
+  IRBuilder<> NumB(NumBB);
+  Value *LHSisInt = WordIsInteger(LHSWord, NumB);
+  Value *RHSisInt = WordIsInteger(RHSWord, NumB);
+  
+  BigIntOp BigOp = (op == tok_add) ? BigIntOpAdd :
+  /*            */ (op == tok_sub) ? BigIntOpSub :
+  /*            */ (op == tok_mul) ? BigIntOpMul :
+  /*            */ (op == tok_div) ? BigIntOpDiv :
+  /*            */ (op == tok_mod) ? BigIntOpMod :
+  /*            */ (op == tok_and) ? BigIntOpAnd :
+  /*                              */ BigIntOpOr;
+  
+  /* Number Block */
+  // Integers (at least one big) go to the big integer block, anything else is a string operation
+  Value *LHSisNum = NumB.CreateOr(LHSisInt, WordIsBigInt(LHSWord, M, NumB));
+  Value *RHSisNum = NumB.CreateOr(RHSisInt, WordIsBigInt(RHSWord, M, NumB));
+  NumB.CreateCondBr(NumB.CreateAnd(LHSisNum, RHSisNum), BigBB, StrBB);
+  
+  /* Big Integer Block */
+  IRBuilder<> BigB(BigBB);
+  if (op == tok_div || op == tok_mod) {
+    // Throw a "SMILDividedByZero" exception for a big integer divided by zero (never a big integer itself)
+    Value *NEqZeroV = BigB.CreateICmpNE(RHSWord, BigB.getInt64(0));
+    CreateAssert(NEqZeroV, DiviseByZeroMessage(BigB), LineArg, ColArg,
+                 M, BigB);
+  }
+  StoreObjWord(BigIntBinOp(BigOp, LHSWord, RHSWord, M, BigB), ObjPtr, BigB);
+  BigB.CreateBr(EndBB);
   
   /*** String and (string or integer) block ***/
   IRBuilder<> StrB(StrBB);
-  B.SetInsertPoint(StrBB);
-  
-  StrB.CreateStore(StrB.getInt1(ObjectTypeString),
-                   StrB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldType));
   
   // const char *sOutput = [...];
   // const char *sInput1 = [...];
   // const char *sInput2 = [...];
   // int Input2 = [...];
   
-  if /**/ (_op == tok_add) { // string and (string or integer)
+  if /**/ (op == tok_add) { // string and (string or integer)
     
     // sOutput = strcat(sInput1, sInput2)
     // or:
     /*
      sInput = [...]
-     sprintf(sInput, "%lld", Input2)
+     smil_rt_itoa(Input2, sInput)
      sOutput = strcat(sInput1, sInput)
      */
     
@@ -233,9 +446,14 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     StrB.SetInsertPoint(LHSBB);
     StrB.SetInsertPoint(RHSBB);
     
+    // Locals into the entry block (not to grow the stack at each iteration of a loop)
+    IRBuilder<> EntryB(&F->getEntryBlock(), F->getEntryBlock().begin());
+    
     /** Left Hand Side **/
-    Value *LHSPtrPtr = LHSB.CreateAlloca(Type::getInt8PtrTy(C));
+    Value *LHSPtrPtr = EntryB.CreateAlloca(Type::getInt8PtrTy(C));
     LHSPtrPtr->setName("LHSPtrPtr");
+    Value *LHSLenPtr = EntryB.CreateAlloca(Type::getInt64Ty(C));
+    LHSLenPtr->setName("LHSLenPtr");
     // @TODO: Use Phi for |LHSPtrPtr|
     
     BasicBlock *LHSisIntBB = BasicBlock::Create(C, "_LHSBlock.LHSisIntegerBlock", F);
@@ -248,20 +466,11 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     LHSB.SetInsertPoint(LHSisIntBB);
     IRBuilder<> LHSisIntB(LHSisIntBB);
     
-    // i32 @sprintf(i8*, i8*, ...)
-    Type* SprintfArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-    FunctionType *SprintfTy = FunctionType::get(Type::getInt32Ty(C), SprintfArgs, true);
-    Function *SprintfF = cast<Function>(M->getOrInsertFunction("sprintf", SprintfTy));
-    
-    static Value *GSprintfFormat = NULL;
-    if (!GSprintfFormat) GSprintfFormat = B.CreateGlobalString("%lld", "sprintf.format");
-    
-    Value *LHSSize = LHSisIntB.getInt32(20 /* = log10(2^64) */ + 1);
-    Value *LHSStrPtr = LHSisIntB.CreateAlloca(Type::getInt8Ty(C), LHSSize);
-    Value* SprintfParams[] = {
-        LHSStrPtr, CastToCStr(GSprintfFormat, LHSisIntB), LHSisIntB.CreateLoad(LHSDataPtr) };
-    LHSisIntB.CreateCall(SprintfF, SprintfParams);
+    Value *LHSSize = EntryB.getInt32(20 /* = log10(2^64) */ + 1);
+    Value *LHSStrPtr = EntryB.CreateAlloca(Type::getInt8Ty(C), LHSSize);
+    Value *LHSLen = RuntimeIntToBuffer(WordToInt64(LHSWord, LHSisIntB), LHSStrPtr, M, LHSisIntB);
     LHSisIntB.CreateStore(LHSStrPtr, LHSPtrPtr);
+    LHSisIntB.CreateStore(LHSLen, LHSLenPtr);
     
     LHSisIntB.CreateBr(LHSDoneBB);
     
@@ -269,9 +478,9 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     LHSB.SetInsertPoint(LHSisStrBB);
     IRBuilder<> LHSisStrB(LHSisStrBB);
     
-    Value *LHSPtr = LHSisStrB.CreateIntToPtr(LHSisStrB.CreateLoad(LHSDataPtr),
-                                             Type::getInt8PtrTy(C));
+    Value *LHSPtr = WordToStr(LHSWord, LHSisStrB);
     LHSisStrB.CreateStore(LHSPtr, LHSPtrPtr);
+    LHSisStrB.CreateStore(StrWordLength(LHSWord, M, LHSisStrB), LHSLenPtr);
     
     LHSisStrB.CreateBr(LHSDoneBB);
     
@@ -281,8 +490,10 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     LHSB.SetInsertPoint(LHSDoneBB);
     
     /** Right Hand Side **/
-    Value *RHSPtrPtr = RHSB.CreateAlloca(Type::getInt8PtrTy(C));
+    Value *RHSPtrPtr = EntryB.CreateAlloca(Type::getInt8PtrTy(C));
     RHSPtrPtr->setName("RHSPtrPtr");
+    Value *RHSLenPtr = EntryB.CreateAlloca(Type::getInt64Ty(C));
+    RHSLenPtr->setName("RHSLenPtr");
     // @TODO: Use Phi for |RHSPtrPtr|
     
     BasicBlock *RHSisIntBB = BasicBlock::Create(C, "_RHSBlock.RHSisIntegerBlock", F);
@@ -296,12 +507,11 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     IRBuilder<> RHSisIntB(RHSisIntBB);
     
     // Convert RHS from int to str (to concat)
-    Value *RHSSize = RHSisIntB.getInt32(20 /* = log10(2^64) */ + 1);
-    Value *RHSStrPtr = RHSisIntB.CreateAlloca(Type::getInt8Ty(C), RHSSize);
-    Value* SprintfParams2[] = {
-        RHSStrPtr, CastToCStr(GSprintfFormat, LHSisIntB), RHSisIntB.CreateLoad(RHSDataPtr) };
-    RHSisIntB.CreateCall(SprintfF, SprintfParams2);
+    Value *RHSSize = EntryB.getInt32(20 /* = log10(2^64) */ + 1);
+    Value *RHSStrPtr = EntryB.CreateAlloca(Type::getInt8Ty(C), RHSSize);
+    Value *RHSLen = RuntimeIntToBuffer(WordToInt64(RHSWord, RHSisIntB), RHSStrPtr, M, RHSisIntB);
     RHSisIntB.CreateStore(RHSStrPtr, RHSPtrPtr);
+    RHSisIntB.CreateStore(RHSLen, RHSLenPtr);
     
     RHSisIntB.CreateBr(RHSDoneBB);
     
@@ -309,9 +519,9 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     RHSB.SetInsertPoint(RHSisStrBB);
     IRBuilder<> RHSisStrB(RHSisStrBB);
     
-    Value *RHSPtr = RHSisStrB.CreateIntToPtr(RHSisStrB.CreateLoad(RHSDataPtr),
-                                             Type::getInt8PtrTy(C));
+    Value *RHSPtr = WordToStr(RHSWord, RHSisStrB);
     RHSisStrB.CreateStore(RHSPtr, RHSPtrPtr);
+    RHSisStrB.CreateStore(StrWordLength(RHSWord, M, RHSisStrB), RHSLenPtr);
     
     RHSisStrB.CreateBr(RHSDoneBB);
     
@@ -325,29 +535,51 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     
     StrB.SetInsertPoint(DoneBB);
     
-    // i8* @strcat(i8*, i8*)
-    Type* StrcatArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-    FunctionType *StrcatTy = FunctionType::get(Type::getInt8PtrTy(C), StrcatArgs, false);
-    Function *StrcatF = cast<Function>(M->getOrInsertFunction("strcat", StrcatTy));
-    
     Value *LHSPtrV = DoneB.CreateLoad(LHSPtrPtr);
     Value *RHSPtrV = DoneB.CreateLoad(RHSPtrPtr);
+    Value *LHSLenV = DoneB.CreateLoad(LHSLenPtr);
+    Value *RHSLenV = DoneB.CreateLoad(RHSLenPtr);
     
-    Value *Length = DoneB.CreateAdd(Strlen(LHSPtrV, M, DoneB),
-                                    Strlen(RHSPtrV, M, DoneB));
-    Value *Size = DoneB.CreateAdd(Length, DoneB.getInt64(1));
-    Value *StrPtr = DoneB.CreateAlloca(Type::getInt8Ty(C), Size);
+    if (ownsLHS) {
+      /*
+       * The left operand is a heap string only owned by this operator: the right one is appended
+       * to it in place (amortized doubling of its capacity, linear time for "a = a + b" in a loop)
+       *   if (is_heap_string(lhs) && !is_bigint(lhs) && lhs != rhs && strisunique(str(lhs)))
+       *     return word(strappend(str(lhs), rhs_str, rhs_len));
+       */
+      BasicBlock *CheckUniqueBB = BasicBlock::Create(C, "_CheckUniqueBlock", F);
+      BasicBlock *AppendBB = BasicBlock::Create(C, "_AppendBlock", F);
+      BasicBlock *ConcatBB = BasicBlock::Create(C, "_ConcatBlock", F);
+      
+      Value *IsHeapStr = DoneB.CreateAnd(DoneB.CreateNot(LHSisNum),
+                                         DoneB.CreateNot(WordIsInlineStr(LHSWord, DoneB)));
+      DoneB.CreateCondBr(DoneB.CreateAnd(IsHeapStr, DoneB.CreateICmpNE(LHSWord, RHSWord)),
+                         CheckUniqueBB, ConcatBB);
+      
+      IRBuilder<> CUB(CheckUniqueBB);
+      CUB.CreateCondBr(StrIsUnique(LHSPtrV, M, CUB), AppendBB, ConcatBB);
+      
+      IRBuilder<> AB(AppendBB);
+      Value *AppendedPtr = StrAppend(LHSPtrV, RHSPtrV, RHSLenV, M, AB);
+      StoreObjWord(StrToWord(AppendedPtr, AB), ObjPtr, AB);
+      AB.CreateStore(AB.getInt64(0), ReleaseLHSPtr); // Moved to the result
+      AB.CreateBr(EndBB);
+      
+      DoneB.SetInsertPoint(ConcatBB);
+    }
     
-    // Set '\0' to the buffer string |StrPtr| (only at [0] to get an empty string)
-    DoneB.CreateMemSet(StrPtr, DoneB.getInt8(0), DoneB.getInt64(1), 8);
-    DoneB.CreateCall(StrcatF, ArrayRef<Value *>{ StrPtr, LHSPtrV });
-    DoneB.CreateCall(StrcatF, ArrayRef<Value *>{ StrPtr, RHSPtrV });
+    // Both lengths are known, copy with memcpy (no scan for NUL like "strcat")
+    Value *Length = DoneB.CreateAdd(LHSLenV, RHSLenV);
+    Value *StrPtr = NewStrBuffer(Length, escapes, M, DoneB);
     
-    DoneB.CreateStore(DoneB.CreatePtrToInt(StrPtr, Type::getInt64Ty(C)),
-                      DoneB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldData));
+    MemCpy(StrPtr, LHSPtrV, LHSLenV, M, DoneB, 1);
+    MemCpy(DoneB.CreateGEP(StrPtr, LHSLenV), RHSPtrV, RHSLenV, M, DoneB, 1);
+    DoneB.CreateStore(DoneB.getInt8(0), DoneB.CreateGEP(StrPtr, Length));
+    
+    StoreObjWord(PackStr(StrPtr, Length, M, DoneB), ObjPtr, DoneB);
     DoneB.CreateBr(EndBB);
   }
-  else if (_op == tok_sub) { // string and (string or integer)
+  else if (op == tok_sub) { // string and (string or integer)
     
     // strncpy(sOutput, sInput1, strlen(sInput1) - Input2)
     
@@ -356,7 +588,7 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     
     BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", F);
     
-    StrB.CreateCondBr(StrB.CreateXor(LHSisInt, RHSisInt),
+    StrB.CreateCondBr(StrB.CreateXor(LHSisNum, RHSisNum),
                       SIBB,
                       SSBB);
     
@@ -366,34 +598,26 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     
     // strncpy([output], [StrV], [StrLen] - [IntV])
     
-    Value *IntV = SIB.CreateLoad(SIB.CreateSelect(RHSisInt,
-                                                  RHSDataPtr,
-                                                  LHSDataPtr,
-                                                  "IntV"));
-    
-    Value *StrVPtr = SIB.CreateLoad(SIB.CreateSelect(RHSisInt,
-                                                     LHSDataPtr,
-                                                     RHSDataPtr,
-                                                     "StrV"));
-    Value *StrV = CastToCStr(SIB.CreateIntToPtr(StrVPtr,
-                                                Type::getInt64Ty(C)->getPointerTo()),
-                             SIB);
-    
-    // i8* @strncpy(i8*, i8*, i64)
-    Type* StrncpyArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C), Type::getInt64Ty(C) };
-    FunctionType *StrncpyTy = FunctionType::get(Type::getInt8PtrTy(C), StrncpyArgs, false);
-    Function *StrncpyF = cast<Function>(M->getOrInsertFunction("strncpy", StrncpyTy));
-    
-    Value *StrLen = Strlen(StrV, M, SIB);
+    Value *IntV = NumWordToInt64(SIB.CreateSelect(RHSisNum,
+                                                  RHSWord,
+                                                  LHSWord,
+                                                  "IntV"), M, SIB);
+    
+    Value *StrWord = SIB.CreateSelect(RHSisNum,
+                                      LHSWord,
+                                      RHSWord,
+                                      "StrWord");
+    Value *StrV = WordToStr(StrWord, SIB);
+    
+    Value *StrLen = StrWordLength(StrWord, M, SIB);
     Value *Length = SIB.CreateSub(StrLen, IntV, "Length"); // @TODO: Be sure that 0 <= |Length| <= |StrLen|
-    Value *Size = SIB.CreateAdd(Length, SIB.getInt64(1));
-    Value *StrPtr = SIB.CreateAlloca(Type::getInt8Ty(C), Size);
-    SIB.CreateMemSet(StrPtr, SIB.getInt8(0), Size, 8);
-    Value* StrncpyParams[] = { StrPtr, StrV, Length };
-    SIB.CreateCall(StrncpyF, StrncpyParams);
+    if (ownsLHS) // O(1) for "a = a - n"
+      TruncateOwnedLHS(LHSWord, RHSisNum, Length, StrLen, ObjPtr, ReleaseLHSPtr, DoneBB, M, SIB);
+    Value *StrPtr = NewStrBuffer(Length, escapes, M, SIB);
+    MemCpy(StrPtr, StrV, Length, M, SIB, 1);
+    SIB.CreateStore(SIB.getInt8(0), SIB.CreateGEP(StrPtr, Length));
     
-    SIB.CreateStore(SIB.CreatePtrToInt(StrPtr, Type::getInt64Ty(C)),
-                    SIB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldData));
+    StoreObjWord(PackStr(StrPtr, Length, M, SIB), ObjPtr, SIB);
     
     SIB.CreateBr(DoneBB);
     
@@ -401,13 +625,14 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
     IRBuilder<> SSB(SSBB);
     StrB.SetInsertPoint(SSBB);
     
-    Value *RetPtr = Strxch(SSB.CreateIntToPtr(SSB.CreateLoad(LHSDataPtr),
-                                              Type::getInt64Ty(C)->getPointerTo()),
-                           SSB.CreateIntToPtr(SSB.CreateLoad(RHSDataPtr),
-                                              Type::getInt64Ty(C)->getPointerTo()),
-                           M, SSB);
-    SSB.CreateStore(SSB.CreatePtrToInt(RetPtr, Type::getInt64Ty(C)),
-                    SSB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldData));
+    Value *RetPtr = RuntimeStrxch(WordToStr(LHSWord, SSB),
+                                  WordToStr(RHSWord, SSB),
+                                  M, SSB);
+    Value *RetWord = PackStr(RetPtr, StrLength(RetPtr, SSB), M, SSB);
+    StoreObjWord(RetWord, ObjPtr, SSB);
+    // Stored inline, the new string is not used anymore
+    ObjRelease(SSB.CreateSelect(WordIsInlineStr(RetWord, SSB), StrToWord(RetPtr, SSB), SSB.getInt64(0)),
+               M, SSB);
     
     SSB.CreateBr(DoneBB);
     
@@ -417,79 +642,69 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
   }
   else {
     
-    /* (|LHSisInt| xor |RHSisInt|) must be true (a string *and* an integer) */
+    /* (|LHSisNum| xor |RHSisNum|) must be true (a string *and* an integer, big integers included) */
     BasicBlock *VTBB = BasicBlock::Create(C, "ValidTypesBlock", F);
     BasicBlock *ITBB = BasicBlock::Create(C, "InvalidTypesBlock", F);
-    StrB.CreateCondBr(StrB.CreateXor(LHSisInt, RHSisInt), VTBB, ITBB);
+    StrB.CreateCondBr(StrB.CreateXor(LHSisNum, RHSisNum), VTBB, ITBB);
     
     // Invalid operation (string and string)
     IRBuilder<> ITB(ITBB);
     StrB.SetInsertPoint(ITBB);
     
     // Throw a "SMILInvalidOperation" exception
-    CreateInvalidBinopAssertion(M, ITB, this->line(), this->col());
+    CreateInvalidBinopAssertion(LineArg, ColArg, M, ITB);
     ITB.CreateBr(EndBB);
     
     // Valid operation
     IRBuilder<> VTB(VTBB);
     StrB.SetInsertPoint(VTBB);
     
-    // %IntV = (|RHSisInt|) ? |RHSDataPtr| : |LHSDataPtr|
-    Value *IntV = VTB.CreateLoad(VTB.CreateSelect(RHSisInt, RHSDataPtr, LHSDataPtr,
-                                                  "IntV"));
+    // %IntV = (|RHSisNum|) ? |RHSWord| : |LHSWord|
+    Value *IntV = NumWordToInt64(VTB.CreateSelect(RHSisNum, RHSWord, LHSWord,
+                                                  "IntV"), M, VTB);
     
-    // %StrV = (|RHSisInt|) ? |LHSDataPtr| : |RHSDataPtr|
-    Value *StrVPtr = VTB.CreateLoad(VTB.CreateSelect(RHSisInt, LHSDataPtr, RHSDataPtr,
-                                                     "StrV"));
-    Value *StrV = CastToCStr(VTB.CreateIntToPtr(StrVPtr,
-                                                Type::getInt64Ty(C)->getPointerTo()),
-                             VTB);
+    // %StrV = (|RHSisNum|) ? |LHSWord| : |RHSWord|
+    Value *StrWord = VTB.CreateSelect(RHSisNum, LHSWord, RHSWord,
+                                      "StrWord");
+    Value *StrV = WordToStr(StrWord, VTB);
     
-    Value *StrLen = Strlen(StrV, M, VTB);
+    Value *StrLen = StrWordLength(StrWord, M, VTB);
     
-    if (_op == tok_mul) { // string and integer
+    if (op == tok_mul) { // string and integer
       
       /*
        * int rep = [IntV];
        * int l = [StrLen];
        * const char * s = [StrPtr];
-       * int size = l * rep + 1;
-       * char * souput = (char *)malloc(size);
+       * char * souput = strbuffer(l * rep);
        *
        * for (int i = 0; i < rep; i++) {
-       * ~~strcpy(souput + (i * l), s);~~
-       *   strcat(souput, s);
+       *   memcpy(souput + (i * l), s, l);
        * }
+       * souput[l * rep] = '\0';
        */
       
       Value *TotalLen = VTB.CreateMul(StrLen, IntV, "TotalLen");
-      Value *Size = VTB.CreateAdd(TotalLen, VTB.getInt64(1));
-      Value *StrPtr = VTB.CreateAlloca(Type::getInt8Ty(C), Size);
-      
-      // i8* @strcpy(i8*, i8*)
-      Type* StrcpyArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-      FunctionType *StrcpyTy = FunctionType::get(Type::getInt8PtrTy(C), StrcpyArgs, false /* not vararg */);
-      Function *StrcpyF = cast<Function>(M->getOrInsertFunction("strcpy", StrcpyTy));
+      Value *StrPtr = NewStrBuffer(TotalLen, escapes, M, VTB);
       
       /* Loop for concatenation */
       BasicBlock *LoopBB = BasicBlock::Create(C, "Loop", F);
-      VTB.CreateBr(LoopBB);
-      
       BasicBlock *DoneBB = BasicBlock::Create(C, "Done", F);
+      BasicBlock *PreheaderBB = VTB.GetInsertBlock();
+      VTB.CreateCondBr(VTB.CreateICmpSGT(IntV, VTB.getInt64(0)), LoopBB, DoneBB);
       
       VTB.SetInsertPoint(LoopBB);
       IRBuilder<> LoopB(LoopBB);
       
       PHINode *CounterPHI = LoopB.CreatePHI(Type::getInt64Ty(C), 2);
       CounterPHI->setName("counter");
-      CounterPHI->addIncoming(LoopB.getInt64(0), VTBB);
+      CounterPHI->addIncoming(LoopB.getInt64(0), PreheaderBB);
       
       Value *OffsetV = LoopB.CreateAdd(LoopB.CreatePtrToInt(StrPtr, Type::getInt64Ty(C)),
                                        LoopB.CreateMul(CounterPHI, StrLen));
-      Value* StrcpyParams[] = {
-        LoopB.CreateIntToPtr(OffsetV, Type::getInt8PtrTy(C)),
-        LoopB.CreatePointerCast(StrV, Type::getInt8PtrTy(C)) };
-      LoopB.CreateCall(StrcpyF, StrcpyParams);
+      MemCpy(LoopB.CreateIntToPtr(OffsetV, Type::getInt8PtrTy(C)),
+             LoopB.CreatePointerCast(StrV, Type::getInt8PtrTy(C)), StrLen,
+             M, LoopB, 1);
       
       Value *NextCounter = LoopB.CreateAdd(CounterPHI, LoopB.getInt64(1));
       NextCounter->setName("nextCounter");
@@ -501,42 +716,31 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
       VTB.SetInsertPoint(DoneBB);
       IRBuilder<> DoneB(DoneBB);
       
-      VTB.CreateStore(VTB.CreatePtrToInt(StrPtr, Type::getInt64Ty(C)),
-                      VTB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldData));
+      VTB.CreateStore(VTB.getInt8(0), VTB.CreateGEP(StrPtr, TotalLen));
+      StoreObjWord(PackStr(StrPtr, TotalLen, M, VTB), ObjPtr, VTB);
       
       DoneB.CreateBr(EndBB);
     }
-    else if (_op == tok_div) { // string and integer
+    else if (op == tok_div) { // string and integer
       
       // Throw a "SMILDividedByZero" exception if |IntV| == 0
-      static Value *GDiviseByZeroAssertMessage = NULL;
-      if (!GDiviseByZeroAssertMessage) {
-        GDiviseByZeroAssertMessage = VTB.CreateGlobalString("Can not divise by zero (SMILDividedByZero)",
-                                                            "smil.divise.by.zero.assert.message");
-      }
       Value *NEqZeroV = VTB.CreateICmpNE(IntV, VTB.getInt64(0)); // Assert(|IntV| != 0)
-      CreateAssert(NEqZeroV, GDiviseByZeroAssertMessage,
-                   M, VTB, this->line(), this->col());
-      
-      // i8* @strncpy(i8*, i8*, i64)
-      Type* StrncpyArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C), Type::getInt64Ty(C) };
-      FunctionType *StrncpyTy = FunctionType::get(Type::getInt8PtrTy(C), StrncpyArgs, false);
-      Function *StrncpyF = cast<Function>(M->getOrInsertFunction("strncpy", StrncpyTy));
+      CreateAssert(NEqZeroV, DiviseByZeroMessage(VTB), LineArg, ColArg,
+                   M, VTB);
       
       // |Length| = ceil( len(|StrLen|) / |IntV| )
       Value *Length = VTB.CreateSDiv(StrLen, IntV, "Length"); // @TODO: Be sure that |IntV| > 0
-      Value *Size = VTB.CreateAdd(Length, VTB.getInt64(1));
-      Value *StrPtr = VTB.CreateAlloca(Type::getInt8Ty(C), Size);
-      VTB.CreateMemSet(StrPtr, VTB.getInt8(0), Size, 8);
-      Value* StrncpyParams[] = { StrPtr, StrV, Length };
-      VTB.CreateCall(StrncpyF, StrncpyParams);
+      if (ownsLHS) // O(1) for "a = a / n"
+        TruncateOwnedLHS(LHSWord, RHSisNum, Length, StrLen, ObjPtr, ReleaseLHSPtr, EndBB, M, VTB);
+      Value *StrPtr = NewStrBuffer(Length, escapes, M, VTB);
+      MemCpy(StrPtr, StrV, Length, M, VTB, 1);
+      VTB.CreateStore(VTB.getInt8(0), VTB.CreateGEP(StrPtr, Length));
       
-      VTB.CreateStore(VTB.CreatePtrToInt(StrPtr, Type::getInt64Ty(C)),
-                      VTB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldData));
+      StoreObjWord(PackStr(StrPtr, Length, M, VTB), ObjPtr, VTB);
       
       VTB.CreateBr(EndBB);
     }
-    else if (_op == tok_mod) { // string and integer
+    else if (op == tok_mod) { // string and integer
       // @TODO: Add rotating to the left if |IntV| is negative
       /*
        int l = [StrLen];
@@ -550,8 +754,7 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
        memcpy(sOutput, sInput+len, offset);
        */
       
-      Value *Size = VTB.CreateAdd(StrLen, VTB.getInt64(1));
-      Value *StrPtr = VTB.CreateAlloca(Type::getInt8Ty(C), Size);
+      Value *StrPtr = NewStrBuffer(StrLen, escapes, M, VTB);
       
       Value *OffsetV = VTB.CreateSRem(IntV, StrLen, "Offset");
       Value *LenV = VTB.CreateSub(StrLen, OffsetV, "Len");
@@ -562,24 +765,400 @@ Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
       MemCpy(VTB.CreateIntToPtr(VTB.CreateAdd(StrPtrToInt, OffsetV),
                                 Type::getInt8PtrTy(C)),
              StrV, LenV,
-             M, VTB);
+             M, VTB, 1);
       MemCpy(StrPtr,
              VTB.CreateIntToPtr(VTB.CreateAdd(StrVToInt, LenV),
                                 Type::getInt8PtrTy(C)),
              OffsetV,
-             M, VTB);
-      VTB.CreateStore(VTB.CreatePtrToInt(StrPtr, Type::getInt64Ty(C)),
-                      VTB.CreateStructGEP(getObjTy(C), ObjPtr, ObjectFieldData));
+             M, VTB, 1);
+      VTB.CreateStore(VTB.getInt8(0), VTB.CreateGEP(StrPtr, StrLen)); // NUL-terminated
+      StoreObjWord(PackStr(StrPtr, StrLen, M, VTB), ObjPtr, VTB);
       
       VTB.CreateBr(EndBB);
     }
     else {
       // Throw a "SMILInvalidOperation" exception
-      CreateInvalidBinopAssertion(M, VTB, this->line(), this->col());
+      CreateInvalidBinopAssertion(LineArg, ColArg, M, VTB);
+      VTB.CreateBr(EndBB);
     }
   }
   
+  IRBuilder<> EndB(EndBB);
+  EndB.CreateRetVoid();
+  
+  return F;
+}
+
+/* Concatenation of |count| words (integers in decimal), into one buffer sized from the lengths
+ * of all pieces first (a new string if the result escapes the statement, else from the region) */
+// i64 @concat(i64* %words, i64 %count)
+static Function * ConcatFunction(bool escapes, Module *M)
+{
+  /*
+   * long concat(long * words, long count) {
+   *   long length = 0;
+   *   for (long i = 0; i < count; i++)
+   *     length += is_integer(words[i]) ? smil_rt_intlen(words[i] >> 1) : strwordlen(words[i]);
+   *   char * s = strbuffer(length, scratch);
+   *   char * p = s;
+   *   for (long i = 0; i < count; i++) {
+   *     if (is_integer(words[i])) {
+   *       p += smil_rt_itoa(words[i] >> 1, p);
+   *     } else {
+   *       long l = strwordlen(words[i]);
+   *       memcpy(p, str(words[i]), l);
+   *       p += l;
+   *     }
+   *   }
+   *   *p = '\0';
+   *   return packstr(s, length);
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *ConcatF = cast<Function>(M->getOrInsertFunction((escapes) ? "concat.escaping" : "concat",
+                                                            Type::getInt64Ty(C),
+                                                            Type::getInt64PtrTy(C),
+                                                            Type::getInt64Ty(C),
+                                                            (Type *)0));
+  if (!ConcatF->empty())
+    return ConcatF;
+  
+  Function::arg_iterator it = ConcatF->arg_begin();
+  Argument *WArg = it;
+  WArg->setName("words");
+  
+  Argument *CArg = ++it;
+  CArg->setName("count");
+  
+  BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", ConcatF);
+  BasicBlock *LengthBB = BasicBlock::Create(C, "LengthBlock", ConcatF);
+  BasicBlock *LengthIntBB = BasicBlock::Create(C, "LengthBlock.IntegerBlock", ConcatF);
+  BasicBlock *LengthStrBB = BasicBlock::Create(C, "LengthBlock.StringBlock", ConcatF);
+  BasicBlock *LengthNextBB = BasicBlock::Create(C, "LengthBlock.NextBlock", ConcatF);
+  BasicBlock *BufferBB = BasicBlock::Create(C, "BufferBlock", ConcatF);
+  BasicBlock *CopyBB = BasicBlock::Create(C, "CopyBlock", ConcatF);
+  BasicBlock *CopyIntBB = BasicBlock::Create(C, "CopyBlock.IntegerBlock", ConcatF);
+  BasicBlock *CopyStrBB = BasicBlock::Create(C, "CopyBlock.StringBlock", ConcatF);
+  BasicBlock *CopyNextBB = BasicBlock::Create(C, "CopyBlock.NextBlock", ConcatF);
+  BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", ConcatF);
+  
+  IRBuilder<> EB(EntryBB);
+  EB.CreateBr(LengthBB); // At least two words
+  
+  /* Length Block */
+  IRBuilder<> LB(LengthBB);
+  PHINode *LengthI = LB.CreatePHI(Type::getInt64Ty(C), 2, "i");
+  PHINode *Length = LB.CreatePHI(Type::getInt64Ty(C), 2, "length");
+  Value *LengthWord = LB.CreateLoad(LB.CreateGEP(WArg, LengthI));
+  LB.CreateCondBr(WordIsInteger(LengthWord, LB), LengthIntBB, LengthStrBB);
+  
+  IRBuilder<> LIB(LengthIntBB);
+  Value *IntLength = RuntimeIntLength(WordToInt64(LengthWord, LIB), M, LIB);
+  LIB.CreateBr(LengthNextBB);
+  
+  IRBuilder<> LSB(LengthStrBB);
+  Value *StrLength = StrWordLength(LengthWord, M, LSB);
+  LSB.CreateBr(LengthNextBB);
+  
+  IRBuilder<> LNB(LengthNextBB);
+  PHINode *PieceLength = LNB.CreatePHI(Type::getInt64Ty(C), 2);
+  PieceLength->addIncoming(IntLength, LengthIntBB);
+  PieceLength->addIncoming(StrLength, LengthStrBB);
+  Value *NextLength = LNB.CreateAdd(Length, PieceLength);
+  Value *NextLengthI = LNB.CreateAdd(LengthI, LNB.getInt64(1));
+  LNB.CreateCondBr(LNB.CreateICmpSLT(NextLengthI, CArg), LengthBB, BufferBB);
+  
+  LengthI->addIncoming(LNB.getInt64(0), EntryBB);
+  LengthI->addIncoming(NextLengthI, LengthNextBB);
+  Length->addIncoming(LNB.getInt64(0), EntryBB);
+  Length->addIncoming(NextLength, LengthNextBB);
+  
+  /* Buffer Block: allocated once */
+  IRBuilder<> BB(BufferBB);
+  Value *StrPtr = NewStrBuffer(NextLength, escapes, M, BB);
+  BB.CreateBr(CopyBB);
+  
+  /* Copy Block */
+  IRBuilder<> CB(CopyBB);
+  PHINode *CopyI = CB.CreatePHI(Type::getInt64Ty(C), 2, "i");
+  PHINode *Ptr = CB.CreatePHI(Type::getInt8PtrTy(C), 2, "p");
+  Value *CopyWord = CB.CreateLoad(CB.CreateGEP(WArg, CopyI));
+  CB.CreateCondBr(WordIsInteger(CopyWord, CB), CopyIntBB, CopyStrBB);
+  
+  IRBuilder<> CIB(CopyIntBB);
+  Value *IntCopied = RuntimeIntToBuffer(WordToInt64(CopyWord, CIB), Ptr, M, CIB);
+  CIB.CreateBr(CopyNextBB);
+  
+  IRBuilder<> CSB(CopyStrBB);
+  Value *StrCopied = StrWordLength(CopyWord, M, CSB);
+  MemCpy(Ptr, WordToStr(CopyWord, CSB), StrCopied, M, CSB, 1);
+  CSB.CreateBr(CopyNextBB);
+  
+  IRBuilder<> CNB(CopyNextBB);
+  PHINode *Copied = CNB.CreatePHI(Type::getInt64Ty(C), 2);
+  Copied->addIncoming(IntCopied, CopyIntBB);
+  Copied->addIncoming(StrCopied, CopyStrBB);
+  Value *NextPtr = CNB.CreateGEP(Ptr, Copied);
+  Value *NextCopyI = CNB.CreateAdd(CopyI, CNB.getInt64(1));
+  CNB.CreateCondBr(CNB.CreateICmpSLT(NextCopyI, CArg), CopyBB, DoneBB);
+  
+  CopyI->addIncoming(CNB.getInt64(0), BufferBB);
+  CopyI->addIncoming(NextCopyI, CopyNextBB);
+  Ptr->addIncoming(StrPtr, BufferBB);
+  Ptr->addIncoming(NextPtr, CopyNextBB);
+  
+  /* Done Block */
+  IRBuilder<> DB(DoneBB);
+  DB.CreateStore(DB.getInt8(0), NextPtr);
+  DB.CreateRet(PackStr(StrPtr, NextLength, M, DB));
+  
+  return ConcatF;
+}
+
+/* Operands of a chain of "+" ("a + b + c" is "(a + b) + c"), from left to right */
+static void ConcatOperands(BinOpExpr *expr, vector<Expr *> &operands)
+{
+  BinOpExpr *LHS = dyn_cast<BinOpExpr>(expr->getLHS());
+  if (LHS && LHS->getOp() == tok_add)
+    ConcatOperands(LHS, operands);
+  else
+    operands.push_back(expr->getLHS());
+  operands.push_back(expr->getRHS());
+}
+
+/* Chain of "+" as one operation: leading numbers are added (like the nested operators would do),
+ * from the first string the remaining operands are concatenated at once (see "ConcatFunction()") */
+static Value * ConcatChain(BinOpExpr *expr, vector<Expr *> &operands, bool escapes, Value *ResultObj,
+                           Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  Function *F = B.GetInsertBlock()->getParent();
+  size_t count = operands.size();
+  
+  IRBuilder<> EntryB(&F->getEntryBlock(), F->getEntryBlock().begin());
+  Value *WordsPtr = EntryB.CreateAlloca(Type::getInt64Ty(C), EntryB.getInt64(count), "concatWords");
+  
+  vector<Value *> Words;
+  for (size_t i = 0; i < count; i++) {
+    Value *Word = LoadObjWord(operands[i]->CodeGen(M, B), B);
+    B.CreateStore(Word, B.CreateGEP(WordsPtr, B.getInt64(i)));
+    Words.push_back(Word);
+  }
+  
+  Value *ObjPtr = (ResultObj) ? ResultObj : EntryObject(B);
+  if (!ResultObj)
+    ObjPtr->setName("objPtr");
+  Value *SumObj = EntryObject(B); // Result of the big integer additions
+  
+  BasicBlock *ConcatBB = BasicBlock::Create(C, "ConcatBlock", F);
+  BasicBlock *EndBB = BasicBlock::Create(C, "EndBlock", F);
+  
+  IRBuilder<> ConcatB(ConcatBB);
+  PHINode *First = ConcatB.CreatePHI(Type::getInt64Ty(C), count - 1, "first");
+  PHINode *FirstWord = ConcatB.CreatePHI(Type::getInt64Ty(C), count - 1, "firstWord");
+  
+  /* Sum Blocks */
+  Value *Sum = Words[0];
+  for (size_t i = 1; i < count; i++) {
+    BasicBlock *IntBB = BasicBlock::Create(C, "Sum.IntegerBlock", F);
+    BasicBlock *NumBB = BasicBlock::Create(C, "Sum.NumberBlock", F);
+    BasicBlock *BigBB = BasicBlock::Create(C, "Sum.BigIntegerBlock", F);
+    BasicBlock *NextBB = BasicBlock::Create(C, "Sum.NextBlock", F);
+    
+    B.CreateCondBr(B.CreateAnd(WordIsInteger(Sum, B), WordIsInteger(Words[i], B)), IntBB, NumBB);
+    
+    IRBuilder<> IntB(IntBB);
+    Function *OverflowF = Intrinsic::getDeclaration(M, Intrinsic::sadd_with_overflow, Type::getInt64Ty(C));
+    Value *ResultPair = IntB.CreateCall(OverflowF, ArrayRef<Value *>{ Sum, Words[i] });
+    Value *IntSum = IntB.CreateExtractValue(ResultPair, 0);
+    IntB.CreateCondBr(IntB.CreateExtractValue(ResultPair, 1), BigBB, NextBB, UnlikelyBranchWeights(C));
+    
+    // Anything else than two numbers: the concatenation starts with the sum so far
+    IRBuilder<> NumB(NumBB);
+    Value *SumIsNum = NumB.CreateOr(WordIsInteger(Sum, NumB), WordIsBigInt(Sum, M, NumB));
+    Value *WordIsNum = NumB.CreateOr(WordIsInteger(Words[i], NumB), WordIsBigInt(Words[i], M, NumB));
+    NumB.CreateCondBr(NumB.CreateAnd(SumIsNum, WordIsNum), BigBB, ConcatBB);
+    First->addIncoming(NumB.getInt64(i - 1), NumBB);
+    FirstWord->addIncoming(Sum, NumBB);
+    
+    IRBuilder<> BigB(BigBB);
+    Value *SlowArgs[] = {
+      Sum, Words[i], SumObj, ConstantPointerNull::get(Type::getInt64PtrTy(C)),
+      BigB.getInt32(expr->line()), BigB.getInt32(expr->col())
+    };
+    BigB.CreateCall(BinOpSlowPath(tok_add, escapes, false, M), SlowArgs);
+    Value *BigSum = LoadObjWord(SumObj, BigB);
+    if (i > 1) // The previous sum is not used anymore
+      ObjRelease(Sum, M, BigB);
+    BigB.CreateBr(NextBB);
+    
+    B.SetInsertPoint(NextBB);
+    PHINode *NextSum = B.CreatePHI(Type::getInt64Ty(C), 2, "sum");
+    NextSum->addIncoming(IntSum, IntBB);
+    NextSum->addIncoming(BigSum, BigBB);
+    Sum = NextSum;
+  }
+  
+  // Only numbers
+  StoreObjWord(Sum, ObjPtr, B);
+  B.CreateBr(EndBB);
+  
+  /* Concat Block */
+  ConcatB.CreateStore(FirstWord, ConcatB.CreateGEP(WordsPtr, First));
+  Value *Args[] = { ConcatB.CreateGEP(WordsPtr, First), ConcatB.CreateSub(ConcatB.getInt64(count), First) };
+  StoreObjWord(ConcatB.CreateCall(ConcatFunction(escapes, M), Args), ObjPtr, ConcatB);
+  // A sum of the leading numbers is not used anymore (the first operand is released below)
+  ObjRelease(ConcatB.CreateSelect(ConcatB.CreateICmpUGT(First, ConcatB.getInt64(0)),
+                                  FirstWord, ConcatB.getInt64(0)),
+             M, ConcatB);
+  ConcatB.CreateBr(EndBB);
+  
   B.SetInsertPoint(EndBB);
+  for (size_t i = 0; i < count; i++) {
+    if (IsTemporary(operands[i])) ObjRelease(Words[i], M, B);
+  }
+  
+  return ObjPtr;
+}
+
+/*** Binary Operator Expression ***/
+Value * BinOpExpr::CodeGen(Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  if (_LHS == NULL) {
+    out() << "|LHS| == NULL" << "\n";
+    exit(1);
+  }
+  
+  if (_RHS == NULL) {
+    out() << "|RHS| == NULL" << "\n";
+    exit(1);
+  }
+  
+  bool escapes = __TemporaryEscapes;
+  bool ownsLHS = IsTemporary(_LHS) || __OwnsLHSVariable;
+  Value *ResultObj = __ResultObject;
+  __TemporaryEscapes = __OwnsLHSVariable = false; // Operands are consumed here
+  __ResultObject = NULL;
+  
+  // "a + b + c + ...": one allocation for the whole chain, not one per operator
+  if (_op == tok_add) {
+    vector<Expr *> operands;
+    ConcatOperands(this, operands);
+    if (operands.size() > 2)
+      return ConcatChain(this, operands, escapes, ResultObj, M, B);
+  }
+  
+  Value *LHSV = _LHS->CodeGen(M, B);
+  Value *LHSWord = LoadObjWord(LHSV, B);
+  LHSWord->setName("LHSWord");
+  Value *LHSisInt = WordIsInteger(LHSWord, B);
+  
+  Value *RHSV = _RHS->CodeGen(M, B);
+  Value *RHSWord = LoadObjWord(RHSV, B);
+  RHSWord->setName("RHSWord");
+  Value *RHSisInt = WordIsInteger(RHSWord, B);
+  
+  Value *ObjPtr = (ResultObj) ? ResultObj : EntryObject(B);
+  if (!ResultObj)
+    ObjPtr->setName("objPtr");
+  
+  // Word of the left operand to release at the end (zero once appended to, see below)
+  Value *ReleaseLHSPtr = NULL;
+  if (ownsLHS) {
+    BasicBlock &EntryBB = B.GetInsertBlock()->getParent()->getEntryBlock();
+    IRBuilder<> EntryB(&EntryBB, EntryBB.begin());
+    ReleaseLHSPtr = EntryB.CreateAlloca(Type::getInt64Ty(C), NULL, "releaseLHSPtr");
+    B.CreateStore(LHSWord, ReleaseLHSPtr);
+  }
+  
+  Function *F = B.GetInsertBlock()->getParent();
+  BasicBlock *IntBB = BasicBlock::Create(C, "IntegerBlock", F);
+  BasicBlock *SlowBB = BasicBlock::Create(C, "SlowPathBlock", F);
+  BasicBlock *EndBB = BasicBlock::Create(C, "EndBlock", F);
+  
+  // Only the integer fast path is inline, big integers and strings are handled by a call
+  B.CreateCondBr(B.CreateAnd(LHSisInt, RHSisInt),
+                 IntBB,
+                 SlowBB,
+                 LikelyBranchWeights(C));
+  
+  /* Only integers block */
+  IRBuilder<> IntB(IntBB);
+  B.SetInsertPoint(IntBB);
+  
+  /*
+   * Words hold 63 bits integers, the result is promoted to a big integer on overflow:
+   *   add, sub: checked on the words directly (the tag of integers is zero)
+   *   mul: checked on (LHS * RHSWord), the result is already shifted
+   *   div, mod: a zero divisor is asserted here, (-2^62 / -1) goes to the big integer block
+   *   and, or: never overflow
+   */
+  if (_op == tok_and || _op == tok_or) {
+    Instruction::BinaryOps Op = (_op == tok_and) ? Instruction::And : Instruction::Or;
+    StoreObjWord(IntB.CreateBinOp(Op, LHSWord, RHSWord), ObjPtr, IntB);
+    IntB.CreateBr(EndBB);
+  }
+  else if (_op == tok_div || _op == tok_mod) {
+    Value *LHSInt = WordToInt64(LHSWord, IntB);
+    Value *RHSInt = WordToInt64(RHSWord, IntB);
+    
+    // Throw a "SMILDividedByZero" exception if |RHSInt| == 0
+    CreateAssert(IntB.CreateICmpNE(RHSInt, IntB.getInt64(0)), DiviseByZeroMessage(IntB),
+                 M, IntB, this->line(), this->col());
+    
+    Value *Overflow = IntB.CreateAnd(IntB.CreateICmpEQ(LHSInt, IntB.getInt64(-(1LL << 62))),
+                                     IntB.CreateICmpEQ(RHSInt, IntB.getInt64(-1)));
+    BasicBlock *DivBB = BasicBlock::Create(C, "IntegerBlock.Divide", F);
+    IntB.CreateCondBr(Overflow, SlowBB, DivBB, UnlikelyBranchWeights(C));
+    
+    IRBuilder<> DivB(DivBB);
+    Value *Result = (_op == tok_div) ? DivB.CreateSDiv(LHSInt, RHSInt) : DivB.CreateSRem(LHSInt, RHSInt);
+    StoreObjWord(Int64ToWord(Result, DivB), ObjPtr, DivB);
+    DivB.CreateBr(EndBB);
+  }
+  else {
+    Intrinsic::ID ID = (_op == tok_add) ? Intrinsic::sadd_with_overflow :
+    /*              */ (_op == tok_sub) ? Intrinsic::ssub_with_overflow :
+    /*                                 */ Intrinsic::smul_with_overflow;
+    Function *OverflowF = Intrinsic::getDeclaration(M, ID, Type::getInt64Ty(C));
+    Value *LHSOperand = (_op == tok_mul) ? WordToInt64(LHSWord, IntB) : LHSWord;
+    Value *ResultPair = IntB.CreateCall(OverflowF, ArrayRef<Value *>{ LHSOperand, RHSWord });
+    StoreObjWord(IntB.CreateExtractValue(ResultPair, 0), ObjPtr, IntB);
+    IntB.CreateCondBr(IntB.CreateExtractValue(ResultPair, 1), SlowBB, EndBB, UnlikelyBranchWeights(C));
+  }
+  
+  /* Slow Path Block */
+  IRBuilder<> SlowB(SlowBB);
+  Value *SlowArgs[] = {
+    LHSWord, RHSWord, ObjPtr,
+    (ownsLHS) ? ReleaseLHSPtr : ConstantPointerNull::get(Type::getInt64PtrTy(C)),
+    SlowB.getInt32(this->line()), SlowB.getInt32(this->col())
+  };
+  SlowB.CreateCall(BinOpSlowPath(_op, escapes, ownsLHS, M), SlowArgs);
+  SlowB.CreateBr(EndBB);
+  
+  B.SetInsertPoint(EndBB);
+  
+  // Operands returned by other binary operators (or moved from the assigned variable) are not used anymore
+  if (ownsLHS) {
+    // Tested inline, no call for integers ("i = i + 1" into loops)
+    Value *ReleaseWord = B.CreateLoad(ReleaseLHSPtr);
+    BasicBlock *ReleaseBB = BasicBlock::Create(C, "ReleaseLHSBlock", F);
+    BasicBlock *ReleasedBB = BasicBlock::Create(C, "ReleasedLHSBlock", F);
+    B.CreateCondBr(WordIsInteger(ReleaseWord, B), ReleasedBB, ReleaseBB);
+    
+    IRBuilder<> RB(ReleaseBB);
+    ObjRelease(ReleaseWord, M, RB);
+    RB.CreateBr(ReleasedBB);
+    
+    B.SetInsertPoint(ReleasedBB);
+  }
+  if (IsTemporary(_RHS)) ObjRelease(RHSWord, M, B);
+  
   return ObjPtr;
 }
 
@@ -603,60 +1182,135 @@ Value * PrintExpr::CodeGen(Module *M, IRBuilder<> &B)
   Function *PrintF = cast<Function>(M->getOrInsertFunction(ostr.str(), PrintTy));
   
   if (PrintF->empty()) {
+    /*
+     * void printN(obj * o1, ..., obj * oN) {
+     *   // Integers as "42 ", strings as "\"str\" ", big integers as "123... " (digits only), then "\n"
+     *   long length = 1;
+     *   for (each oi)
+     *     length += is_integer(oi) ? smil_rt_intlen(int(oi)) + 1 : strwordlen(oi) + (is_bigint(oi) ? 1 : 3);
+     *   char stack[kPrintBufferSize];
+     *   char * buffer = (length <= kPrintBufferSize) ? stack : malloc(length);
+     *   char * p = buffer;
+     *   for (each oi) // Written in place, no format string
+     *     p = is_integer(oi) ? p + smil_rt_itoa(int(oi), p) : [quotes if not bigint] memcpy(p, str(oi), len);
+     *     *p++ = ' ';
+     *   *p = '\n';
+     *   smil_rt_write(buffer, length);
+     *   if (buffer != stack) free(buffer);
+     * }
+     */
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", PrintF);
+    IRBuilder<> FB(EntryBB);
+    Value *StackBuffer = FB.CreateAlloca(Type::getInt8Ty(C), FB.getInt64(kPrintBufferSize), "stackbuffer");
     
-    BasicBlock *FBB = BasicBlock::Create(C, "EntryBlock", PrintF);
-    IRBuilder<> FB(FBB);
-    FB.SetInsertPoint(FBB);
-    
-    // i32 @printf(i8*, ...)
-    Type* PrintfArgs[] = { Type::getInt8PtrTy(C) };
-    FunctionType *PrintfTy = FunctionType::get(Type::getInt32Ty(C), PrintfArgs, true);
-    Function *PrintfF = cast<Function>(M->getOrInsertFunction("printf", PrintfTy));
-    
-    // i8* @strcat(i8*, i8*)
-    Type* StrcatArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-    FunctionType *StrcatTy = FunctionType::get(Type::getInt8PtrTy(C), StrcatArgs, false);
-    Function *StrcatF = cast<Function>(M->getOrInsertFunction("strcat", StrcatTy));
-    
-    static Value *GIntArgFormat = NULL;
-    if (!GIntArgFormat) GIntArgFormat = B.CreateGlobalString("%lld ", "printf.format.arg.integer"); // DEBUG (remove whitespace)
-    static Value *GStrArgFormat = NULL;
-    if (!GStrArgFormat) GStrArgFormat = B.CreateGlobalString("\"%s\" ", "printf.format.arg.string"); // DEBUG (remove quotes and whitespace)
-    static Value *GLBArgFormat = NULL;
-    if (!GLBArgFormat) GLBArgFormat = B.CreateGlobalString("\n", "printf.format.arg.line-break");
-    
-    Value *Size = FB.getInt32(5 /* "%lld " */ * output.size() + 2 /* for "\n" */);
-    Value *FormatPtr = FB.CreateAlloca(Type::getInt8Ty(C), Size, "printf.format");
-    // Set the first byte to '\0' for the buffer string |FormatPtr|
-    FB.CreateMemSet(FormatPtr, FB.getInt8(0), FB.getInt64(1), 8);
-    
-    vector<Value *> printfParams;
+    /* Length Blocks */
+    vector<Value *> Words;
+    Value *Length = FB.getInt64(1); // "\n"
     for (Function::arg_iterator it = PrintF->arg_begin(); it != PrintF->arg_end(); it++) {
       
       Value *Arg = it;
-      Value *FieldPtr = FB.CreateStructGEP(getObjTy(C), Arg, ObjectFieldType);
-      Value *CompResult = FB.CreateICmpEQ(FB.CreateLoad(FieldPtr),
-                                          FB.getInt1(ObjectTypeString));
-      Value *ArgFormat = FB.CreateSelect(CompResult,
-                                         CastToCStr(GStrArgFormat, FB),
-                                         CastToCStr(GIntArgFormat, FB),
-                                         "printf.format.arg");
-      Value* Params[] = { FormatPtr, ArgFormat };
-      FB.CreateCall(StrcatF, Params);
-      
-      Value *DataPtr = FB.CreateStructGEP(getObjTy(C), Arg, ObjectFieldData);
-      printfParams.push_back(FB.CreateLoad(DataPtr));
+      Value *Word = LoadObjWord(Arg, FB);
+      Words.push_back(Word);
+      
+      BasicBlock *IntBB = BasicBlock::Create(C, "Length.IntegerBlock", PrintF);
+      BasicBlock *StrBB = BasicBlock::Create(C, "Length.StringBlock", PrintF);
+      BasicBlock *DoneBB = BasicBlock::Create(C, "Length.DoneBlock", PrintF);
+      FB.CreateCondBr(WordIsInteger(Word, FB), IntBB, StrBB);
+      
+      IRBuilder<> IntB(IntBB);
+      Value *IntLength = IntB.CreateAdd(RuntimeIntLength(WordToInt64(Word, IntB), M, IntB), IntB.getInt64(1));
+      IntB.CreateBr(DoneBB);
+      
+      // Big integers are printed from their decimal digits, like integers (without quotes)
+      IRBuilder<> StrB(StrBB);
+      Value *Extra = StrB.CreateSelect(WordIsBigInt(Word, M, StrB), StrB.getInt64(1), StrB.getInt64(3));
+      Value *StrLength = StrB.CreateAdd(StrWordLength(Word, M, StrB), Extra);
+      StrB.CreateBr(DoneBB);
+      
+      FB.SetInsertPoint(DoneBB);
+      PHINode *ArgLength = FB.CreatePHI(Type::getInt64Ty(C), 2);
+      ArgLength->addIncoming(IntLength, IntBB);
+      ArgLength->addIncoming(StrLength, StrBB);
+      Length = FB.CreateAdd(Length, ArgLength);
     }
     
-    /* Add "\n" at the end of |FormatPtr| */
-    Value* StrcatParams[] = { FormatPtr, CastToCStr(GLBArgFormat, FB) };
-    FB.CreateCall(StrcatF, StrcatParams);
+    /* Buffer Block: on the stack, unless the line is too long */
+    BasicBlock *HeapBB = BasicBlock::Create(C, "HeapBlock", PrintF);
+    BasicBlock *BufferBB = BasicBlock::Create(C, "BufferBlock", PrintF);
+    BasicBlock *LengthDoneBB = FB.GetInsertBlock();
+    Value *OnStack = FB.CreateICmpULE(Length, FB.getInt64(kPrintBufferSize));
+    FB.CreateCondBr(OnStack, BufferBB, HeapBB, LikelyBranchWeights(C));
+    
+    // i8* @malloc(i64)
+    FunctionType *MallocTy = FunctionType::get(Type::getInt8PtrTy(C),
+                                               ArrayRef<Type *>{ Type::getInt64Ty(C) }, false);
+    Function *MallocF = cast<Function>(M->getOrInsertFunction("malloc", MallocTy));
+    
+    IRBuilder<> HeapB(HeapBB);
+    Value *HeapBuffer = HeapB.CreateCall(MallocF, Length);
+    HeapB.CreateBr(BufferBB);
+    
+    FB.SetInsertPoint(BufferBB);
+    PHINode *Buffer = FB.CreatePHI(Type::getInt8PtrTy(C), 2, "buffer");
+    Buffer->addIncoming(StackBuffer, LengthDoneBB);
+    Buffer->addIncoming(HeapBuffer, HeapBB);
+    
+    /* Write Blocks */
+    Value *Ptr = Buffer;
+    for (size_t i = 0; i < Words.size(); i++) {
+      
+      Value *Word = Words[i];
+      BasicBlock *IntBB = BasicBlock::Create(C, "Write.IntegerBlock", PrintF);
+      BasicBlock *StrBB = BasicBlock::Create(C, "Write.StringBlock", PrintF);
+      BasicBlock *DoneBB = BasicBlock::Create(C, "Write.DoneBlock", PrintF);
+      FB.CreateCondBr(WordIsInteger(Word, FB), IntBB, StrBB);
+      
+      IRBuilder<> IntB(IntBB);
+      Value *IntPtr = IntB.CreateGEP(Ptr, RuntimeIntToBuffer(WordToInt64(Word, IntB), Ptr, M, IntB));
+      IntB.CreateStore(IntB.getInt8(' '), IntPtr);
+      IntPtr = IntB.CreateGEP(IntPtr, IntB.getInt64(1));
+      IntB.CreateBr(DoneBB);
+      
+      // Quotes written unconditionally, then skipped (overwritten) for big integers
+      IRBuilder<> StrB(StrBB);
+      Value *Quote = StrB.CreateZExt(StrB.CreateNot(WordIsBigInt(Word, M, StrB)), Type::getInt64Ty(C));
+      StrB.CreateStore(StrB.getInt8('"'), Ptr);
+      Value *StrPtr = StrB.CreateGEP(Ptr, Quote);
+      Value *StrLength = StrWordLength(Word, M, StrB);
+      MemCpy(StrPtr, WordToStr(Word, StrB), StrLength, M, StrB, 1);
+      StrPtr = StrB.CreateGEP(StrPtr, StrLength);
+      StrB.CreateStore(StrB.getInt8('"'), StrPtr);
+      StrPtr = StrB.CreateGEP(StrPtr, Quote);
+      StrB.CreateStore(StrB.getInt8(' '), StrPtr);
+      StrPtr = StrB.CreateGEP(StrPtr, StrB.getInt64(1));
+      StrB.CreateBr(DoneBB);
+      
+      FB.SetInsertPoint(DoneBB);
+      PHINode *NextPtr = FB.CreatePHI(Type::getInt8PtrTy(C), 2);
+      NextPtr->addIncoming(IntPtr, IntBB);
+      NextPtr->addIncoming(StrPtr, StrBB);
+      Ptr = NextPtr;
+    }
+    FB.CreateStore(FB.getInt8('\n'), Ptr);
+    RuntimeWrite(Buffer, Length, M, FB);
     
-    printfParams.insert(printfParams.begin(), FormatPtr);
-    ArrayRef<Value *> PrintfParamsRef = ArrayRef<Value *>(printfParams);
-    FB.CreateCall(PrintfF, PrintfParamsRef);
+    /* Free Block */
+    BasicBlock *FreeBB = BasicBlock::Create(C, "FreeBlock", PrintF);
+    BasicBlock *RetBB = BasicBlock::Create(C, "ReturnBlock", PrintF);
+    FB.CreateCondBr(OnStack, RetBB, FreeBB, LikelyBranchWeights(C));
     
-    FB.CreateRetVoid();
+    // void @free(i8*)
+    FunctionType *FreeTy = FunctionType::get(Type::getVoidTy(C),
+                                             ArrayRef<Type *>{ Type::getInt8PtrTy(C) }, false);
+    Function *FreeF = cast<Function>(M->getOrInsertFunction("free", FreeTy));
+    
+    IRBuilder<> FreeB(FreeBB);
+    FreeB.CreateCall(FreeF, Buffer);
+    FreeB.CreateBr(RetBB);
+    
+    IRBuilder<> RetB(RetBB);
+    RetB.CreateRetVoid();
   }
   
   /* Call the function "print()" */
@@ -669,6 +1323,9 @@ Value * PrintExpr::CodeGen(Module *M, IRBuilder<> &B)
   ArrayRef<Value *> PrintParamsRef = ArrayRef<Value *>(printParams);
   B.CreateCall(PrintF, PrintParamsRef);
   
+  for (size_t i = 0; i < output.size(); i++)
+    ReleaseTemporary(output[i], printParams[i], M, B);
+  
   return NULL;
 }
 
@@ -677,37 +1334,44 @@ Value * HelloPrintExpr::CodeGen(Module *M, IRBuilder<> &B)
 {
   LLVMContext &C = M->getContext();
   
-  // i32 @printf(i8*, ...)
-  Type* Args[] = { Type::getInt8PtrTy(C) };
-  FunctionType *Type = FunctionType::get(Type::getInt32Ty(C), Args, true);
-  Function *PrintfF = cast<Function>(M->getOrInsertFunction("printf", Type));
+  static Value *GHelloPrefix = NULL;
+  if (!GHelloPrefix) GHelloPrefix = B.CreateGlobalString("Hello, ", "hello.prefix");
+  static Value *GHelloSuffix = NULL;
+  if (!GHelloSuffix) GHelloSuffix = B.CreateGlobalString("!\n", "hello.suffix");
   
-  static Value *GIntArgHelloFormat = NULL;
-  if (!GIntArgHelloFormat) GIntArgHelloFormat = B.CreateGlobalString("Hello, %lld!\n", "hello.format.arg.integer");
-  static Value *GStrArgHelloFormat = NULL;
-  if (!GStrArgHelloFormat) GStrArgHelloFormat = B.CreateGlobalString("Hello, %s!\n", "hello.format.arg.string");
+  RuntimeWrite(CastToCStr(GHelloPrefix, B), B.getInt64(strlen("Hello, ")), M, B);
   
   Value *Input = InputAtIndex(0, M, B);
   if (Input) {
     
-    Value *FieldPtr = B.CreateStructGEP(getObjTy(C), Input, ObjectFieldType);
-    Value *CompResult = B.CreateICmpEQ(B.CreateLoad(FieldPtr),
-                                       B.getInt1(ObjectTypeString));
-    Value *ArgFormat = B.CreateSelect(CompResult,
-                                      CastToCStr(GStrArgHelloFormat, B),
-                                      CastToCStr(GIntArgHelloFormat, B),
-                                      "printf.format.arg");
-    Value* PrintfParams[] = { ArgFormat, B.CreateLoad(Input) };
-    B.CreateCall(PrintfF, PrintfParams);
+    Value *Word = LoadObjWord(Input, B);
+    Function *F = B.GetInsertBlock()->getParent();
+    BasicBlock *IntBB = BasicBlock::Create(C, "Hello.IntegerBlock", F);
+    BasicBlock *StrBB = BasicBlock::Create(C, "Hello.StringBlock", F);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "Hello.DoneBlock", F);
+    B.CreateCondBr(WordIsInteger(Word, B), IntBB, StrBB);
+    
+    IRBuilder<> IntB(IntBB);
+    IRBuilder<> EntryB(&F->getEntryBlock(), F->getEntryBlock().begin());
+    Value *Buffer = EntryB.CreateAlloca(Type::getInt8Ty(C), EntryB.getInt64(20 /* = log10(2^64) */), "hello.buffer");
+    RuntimeWrite(Buffer, RuntimeIntToBuffer(WordToInt64(Word, IntB), Buffer, M, IntB), M, IntB);
+    IntB.CreateBr(DoneBB);
+    
+    IRBuilder<> StrB(StrBB);
+    RuntimeWrite(WordToStr(Word, StrB), StrWordLength(Word, M, StrB), M, StrB);
+    StrB.CreateBr(DoneBB);
+    
+    B.SetInsertPoint(DoneBB);
     
   } else {
     static Value *GHelloWorld = NULL;
     if (!GHelloWorld) GHelloWorld = B.CreateGlobalString("world", "hello.world");
-	  
-    Value* PrintfParams[] = { CastToCStr(GStrArgHelloFormat, B), CastToCStr(GHelloWorld, B) };
-    B.CreateCall(PrintfF, PrintfParams);
+    
+    RuntimeWrite(CastToCStr(GHelloWorld, B), B.getInt64(strlen("world")), M, B);
   }
   
+  RuntimeWrite(CastToCStr(GHelloSuffix, B), B.getInt64(strlen("!\n")), M, B);
+  
   return NULL;
 }
 
@@ -729,39 +1393,56 @@ Value * ExitExpr::CodeGen(Module *M, IRBuilder<> &B)
   Function *ExitF = cast<Function>(M->getOrInsertFunction("exit", Type::getVoidTy(C),
                                                           Type::getInt32Ty(C),
                                                           (Type *)0));
+  // The buffered output is written before (see "Runtime.h")
+  RuntimeOutputClose(M, B);
   Value *Zero = B.getInt32(code);
   return B.CreateCall(ExitF, Zero);
 }
 
 /*** Global Stack Variables ***/
-static Value *__Stack = NULL; // Ptr to a stack of ptr to obj (cast as i64), i.e. i64**
+static Value *__Stack = NULL; // Ptr to a stack of tagged words (values, not variables), i.e. i64**
 static Value *__StackIdx = NULL;
 static Value *__StackSize = NULL;
+#define kDefaultStackSize 16 // Initial number of words of the stack
+
+/* Create the stack into the entry block of the current function, once: the first stack expression
+ * can be into a loop (or a branch), and be a "pop" or a "clear" (generated before any "push") */
+static void CreateStack(Module *M, IRBuilder<> &B)
+{
+  if (__Stack != NULL)
+    return;
+  
+  LLVMContext &C = M->getContext();
+  
+  BasicBlock &EntryBB = B.GetInsertBlock()->getParent()->getEntryBlock();
+  IRBuilder<> EntryB(&EntryBB, EntryBB.begin());
+  
+  // i8* @malloc(i64)
+  FunctionType *MallocTy = FunctionType::get(Type::getInt8PtrTy(C),
+                                             ArrayRef<Type *>{ Type::getInt64Ty(C) }, false);
+  Function *MallocF = cast<Function>(M->getOrInsertFunction("malloc", MallocTy));
+  
+  // On the heap, to be resized without growing the native stack
+  __Stack = EntryB.CreateAlloca(Type::getInt64Ty(C)->getPointerTo());
+  __Stack->setName("stack");
+  Value *Stack = EntryB.CreateCall(MallocF, EntryB.getInt64(kDefaultStackSize * 8));
+  EntryB.CreateStore(EntryB.CreatePointerCast(Stack, Type::getInt64Ty(C)->getPointerTo()), __Stack);
+  
+  __StackSize = EntryB.CreateAlloca(Type::getInt64Ty(C));
+  __StackSize->setName("stack.size");
+  EntryB.CreateStore(EntryB.getInt64(kDefaultStackSize), __StackSize);
+  
+  __StackIdx = EntryB.CreateAlloca(Type::getInt64Ty(C));
+  __StackIdx->setName("stack.index");
+  EntryB.CreateStore(EntryB.getInt64(0), __StackIdx);
+}
 
 /*** Push (to global stack) Expression ***/
 Value * PushExpr::CodeGen(Module *M, IRBuilder<> &B)
 {
   LLVMContext &C = M->getContext();
   
-  if (__Stack == NULL) {
-#define kDefaultStackSize 16
-    
-    __Stack = B.CreateAlloca(Type::getInt64Ty(C)->getPointerTo());
-    __Stack->setName("stack");
-    Value *Stack = B.CreateAlloca(Type::getInt64Ty(C),
-                                  B.getInt64(kDefaultStackSize));
-    B.CreateStore(Stack, __Stack);
-    
-    __StackSize = B.CreateAlloca(Type::getInt64Ty(C));
-    __StackSize->setName("stack.size");
-    B.CreateStore(B.getInt64(kDefaultStackSize), __StackSize);
-  }
-  
-  if (__StackIdx == NULL) {
-    __StackIdx = B.CreateAlloca(Type::getInt64Ty(C));
-    __StackIdx->setName("stack.index");
-    B.CreateStore(B.getInt64(0), __StackIdx);
-  }
+  CreateStack(M, B);
   
   Value *Idx = B.CreateLoad(__StackIdx);
   
@@ -775,18 +1456,18 @@ Value * PushExpr::CodeGen(Module *M, IRBuilder<> &B)
   B.SetInsertPoint(RSBB);
   IRBuilder<> RSB(RSBB);
   
-  // Add |kDefaultStackSize| to the stack size
-  Value *NewSize = RSB.CreateAdd(Idx, RSB.getInt64(kDefaultStackSize));
+  // Double the stack size
+  Value *NewSize = RSB.CreateMul(RSB.CreateLoad(__StackSize), RSB.getInt64(2));
   
-#undef kDefaultStackSize
+  // i8* @realloc(i8*, i64)
+  Type* ReallocArgs[] = { Type::getInt8PtrTy(C), Type::getInt64Ty(C) };
+  FunctionType *ReallocTy = FunctionType::get(Type::getInt8PtrTy(C), ReallocArgs, false);
+  Function *ReallocF = cast<Function>(M->getOrInsertFunction("realloc", ReallocTy));
   
-  // Alloc a new stack and copy from the old stack
-  Value *NewStack = RSB.CreateAlloca(Type::getInt64Ty(C),
-                                     NewSize);
-  MemCpy(NewStack, RSB.CreateLoad(__Stack),
-         RSB.CreateMul(RSB.CreateLoad(__StackSize), B.getInt64(8)), // Copy |__StackSize| * 8 bytes of memory
-         M, RSB);
-  RSB.CreateStore(NewStack, __Stack);
+  Value* ReallocParams[] = { RSB.CreatePointerCast(RSB.CreateLoad(__Stack), Type::getInt8PtrTy(C)),
+                             RSB.CreateMul(NewSize, RSB.getInt64(8)) };
+  Value *NewStack = RSB.CreateCall(ReallocF, ReallocParams);
+  RSB.CreateStore(RSB.CreatePointerCast(NewStack, Type::getInt64Ty(C)->getPointerTo()), __Stack);
   
   RSB.CreateStore(NewSize, __StackSize);
   
@@ -800,9 +1481,14 @@ Value * PushExpr::CodeGen(Module *M, IRBuilder<> &B)
   Value *FinalPtr = B.CreateIntToPtr(Addr,
                                      Type::getInt64Ty(C)->getPointerTo());
   
+  // The stack owns its words (moved from a temporary, else retained)
+  __TemporaryEscapes = IsTemporary(_expr);
   Value *V = _expr->CodeGen(M, B);
-  B.CreateStore(B.CreatePtrToInt(V, Type::getInt64Ty(C)),
-                FinalPtr);
+  __TemporaryEscapes = false;
+  Value *Word = LoadObjWord(V, B);
+  B.CreateStore(Word, FinalPtr);
+  if (!IsTemporary(_expr))
+    ObjRetain(Word, M, B);
   
   // Increment |__StackIdx|
   Value *NewIdx = B.CreateAdd(Idx, B.getInt64(1));
@@ -814,6 +1500,8 @@ Value * PushExpr::CodeGen(Module *M, IRBuilder<> &B)
 /*** Pop (from global stack) Expression ***/
 Value * PopExpr::CodeGen(Module *M, IRBuilder<> &B)
 {
+  CreateStack(M, B);
+  
   Value *Idx = B.CreateLoad(__StackIdx);
   Value *NewIdx = B.CreateSub(Idx, B.getInt64(1));
   B.CreateStore(NewIdx, __StackIdx);
@@ -827,12 +1515,14 @@ Value * PopExpr::CodeGen(Module *M, IRBuilder<> &B)
   Value *FinalPtr = B.CreateIntToPtr(Addr,
                                      Type::getInt64Ty(C)->getPointerTo());
   
-  Value *V = B.CreateIntToPtr(B.CreateLoad(FinalPtr),
-                              getObjPtrTy(C));
+  Value *Word = B.CreateLoad(FinalPtr);
   
+  // The word is moved from the stack to the variable
   string name = (cast<VarExpr>(_expr))->getName();
-  InsertOrUpdate(CxxStrToVal(name, M, B),
-                 V, M, B);
+  Value *V = VariableNamed(name, M, B);
+  Value *OldWord = LoadObjWord(V, B);
+  StoreObjWord(Word, V, B);
+  ObjRelease(OldWord, M, B);
   
   return V;
 }
@@ -840,11 +1530,214 @@ Value * PopExpr::CodeGen(Module *M, IRBuilder<> &B)
 /*** Clear Global Stack Expression ***/
 Value * ClearExpr::CodeGen(Module *M, IRBuilder<> &B)
 {
+  LLVMContext &C = M->getContext();
+  
+  CreateStack(M, B);
+  
+  /*
+   * Release the words of the stack (from the top):
+   *
+   * ClearBlock (i = phi [idx, current], [i - 1, ClearBlock]) -> [ClearBlock | DoneBlock]
+   */
+  Function *F = B.GetInsertBlock()->getParent();
+  BasicBlock *CurrentBB = B.GetInsertBlock();
+  BasicBlock *ClearBB = BasicBlock::Create(C, "ClearBlock", F);
+  BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", F);
+  
+  Value *Idx = B.CreateLoad(__StackIdx);
+  Value *Stack = B.CreateLoad(__Stack);
+  B.CreateCondBr(B.CreateICmpSGT(Idx, B.getInt64(0)), ClearBB, DoneBB);
+  
+  /* Clear Block */
+  IRBuilder<> ClearB(ClearBB);
+  PHINode *Index = ClearB.CreatePHI(Type::getInt64Ty(C), 2, "index");
+  Index->addIncoming(Idx, CurrentBB);
+  Value *NextIndex = ClearB.CreateSub(Index, ClearB.getInt64(1));
+  ObjRelease(ClearB.CreateLoad(ClearB.CreateGEP(Stack, NextIndex)), M, ClearB);
+  Index->addIncoming(NextIndex, ClearBB);
+  ClearB.CreateCondBr(ClearB.CreateICmpSGT(NextIndex, ClearB.getInt64(0)), ClearBB, DoneBB);
+  
+  /* Done Block */
+  B.SetInsertPoint(DoneBB);
   B.CreateStore(B.getInt64(0), __StackIdx);
-  // @TODO: Free stack (?)
   return NULL;
 }
 
+/*** Loop analysis helpers ***/
+/* Name of the variable read by |expr| (variable or input), empty for other expressions */
+static string StaticName(Expr *expr)
+{
+  if (isa<VarExpr>(expr))
+    return cast<VarExpr>(expr)->getName();
+  if (isa<InputExpr>(expr))
+    return InputName(cast<InputExpr>(expr)->getIndex());
+  return "";
+}
+
+/* Append sub-expressions of |expr| to |children| */
+static void Children(Expr *expr, vector<Expr *> &children)
+{
+  if (isa<InitExpr>(expr)) {
+    children.push_back(cast<InitExpr>(expr)->getLHS());
+    children.push_back(cast<InitExpr>(expr)->getRHS());
+  } else if (isa<PopExpr>(expr)) {
+    children.push_back(cast<PopExpr>(expr)->getExpr());
+  } else if (isa<BinOpExpr>(expr)) {
+    children.push_back(cast<BinOpExpr>(expr)->getLHS());
+    children.push_back(cast<BinOpExpr>(expr)->getRHS());
+  } else if (isa<NamedVarExpr>(expr)) {
+    children.push_back(cast<NamedVarExpr>(expr)->getExpr());
+  } else if (isa<PushExpr>(expr)) {
+    children.push_back(cast<PushExpr>(expr)->getExpr());
+  } else if (isa<LengthFuncExpr>(expr)) {
+    children.push_back(cast<LengthFuncExpr>(expr)->getExpr());
+  } else if (isa<PrintExpr>(expr)) {
+    vector<Expr *> &output = cast<PrintExpr>(expr)->getOutput();
+    children.insert(children.end(), output.begin(), output.end());
+  } else if (isa<LoopExpr>(expr)) {
+    LoopExpr *loop = cast<LoopExpr>(expr);
+    children.push_back(loop->getCondition());
+    children.insert(children.end(), loop->getThenExprs().begin(), loop->getThenExprs().end());
+    children.insert(children.end(), loop->getThelseExprs().begin(), loop->getThelseExprs().end());
+  }
+}
+
+/* Count assignments (init and pop) of each variable into |expr|,
+ * return false if a variable with a dynamic name (named variable) can be assigned */
+static bool CountAssignments(Expr *expr, map<string, int> &counts)
+{
+  if (isa<InitExpr>(expr) || isa<PopExpr>(expr)) {
+    Expr *dest = (isa<InitExpr>(expr)) ? cast<InitExpr>(expr)->getLHS() : cast<PopExpr>(expr)->getExpr();
+    string name = StaticName(dest);
+    if (name.empty())
+      return false;
+    counts[name]++;
+  }
+  
+  vector<Expr *> children;
+  Children(expr, children);
+  for (vector<Expr *>::iterator it = children.begin(); it != children.end(); it++) {
+    if (*it && !CountAssignments(*it, counts))
+      return false;
+  }
+  return true;
+}
+
+/* Collect the names of variables (and inputs) and the named variables used into |expr| */
+static void CollectVariables(Expr *expr, set<string> &names, vector<NamedVarExpr *> &namedVars)
+{
+  string name = StaticName(expr);
+  if (!name.empty())
+    names.insert(name);
+  if (isa<NamedVarExpr>(expr))
+    namedVars.push_back(cast<NamedVarExpr>(expr));
+  
+  vector<Expr *> children;
+  Children(expr, children);
+  for (vector<Expr *>::iterator it = children.begin(); it != children.end(); it++) {
+    if (*it)
+      CollectVariables(*it, names, namedVars);
+  }
+}
+
+/* Counted loop:
+ *   8| X |) ... V =; V :# S ... 8) 8}      or      8| X :> Y |) ... V =; V :> S ... 8) 8}
+ * where the induction variable |V| is |X| or |Y|, assigned only once (at the top-level of the loop),
+ * the step |S| is a variable not assigned into the loop and the other condition variable is invariant.
+ * With |D| = X (or X - Y), the loop runs while D > 0 and D moves by a constant each iteration.
+ */
+struct CountedLoopInfo {
+  Expr *X, *Y; // Condition variables (|Y| is NULL for "8| X |)")
+  Expr *Step; // |S|
+  bool UpdatesX; // |V| is |X| (else |Y|)
+  bool Increments; // V = V + S (else V = V - S)
+  InitExpr *Update; // The assignment of |V|
+};
+
+/* True if |expr| is (or contains) a loop */
+static bool ContainsLoop(Expr *expr)
+{
+  if (isa<LoopExpr>(expr))
+    return true;
+  
+  vector<Expr *> children;
+  Children(expr, children);
+  for (vector<Expr *>::iterator it = children.begin(); it != children.end(); it++) {
+    if (*it && ContainsLoop(*it))
+      return true;
+  }
+  return false;
+}
+
+static bool MatchCountedLoop(Expr *condition, vector<Expr *> &thenExprs, CountedLoopInfo &info)
+{
+  if (!condition)
+    return false;
+  
+  info.X = condition;
+  info.Y = NULL;
+  if (isa<BinOpExpr>(condition)) {
+    BinOpExpr *binop = cast<BinOpExpr>(condition);
+    if (binop->getOp() != tok_sub)
+      return false;
+    info.X = binop->getLHS();
+    info.Y = binop->getRHS();
+  }
+  
+  string XName = StaticName(info.X);
+  string YName = (info.Y) ? StaticName(info.Y) : "";
+  if (XName.empty() || (info.Y && (YName.empty() || YName == XName)))
+    return false;
+  
+  map<string, int> counts;
+  for (vector<Expr *>::iterator it = thenExprs.begin(); it != thenExprs.end(); it++) {
+    if (!CountAssignments(*it, counts))
+      return false;
+  }
+  
+  /* Find the (top-level) update of the induction variable */
+  InitExpr *update = NULL;
+  for (vector<Expr *>::iterator it = thenExprs.begin(); it != thenExprs.end(); it++) {
+    if (!isa<InitExpr>(*it))
+      continue;
+    
+    InitExpr *init = cast<InitExpr>(*it);
+    string name = StaticName(init->getLHS());
+    if (name == XName || (info.Y && name == YName)) {
+      update = init;
+      info.UpdatesX = (name == XName);
+      break;
+    }
+  }
+  if (!update || !isa<VarExpr>(update->getLHS()) || cast<VarExpr>(update->getLHS())->getInversed()
+      || !isa<BinOpExpr>(update->getRHS()))
+    return false;
+  
+  string VName = StaticName(update->getLHS());
+  info.Update = update;
+  BinOpExpr *step = cast<BinOpExpr>(update->getRHS());
+  string LHSName = StaticName(step->getLHS()), RHSName = StaticName(step->getRHS());
+  
+  if (step->getOp() == tok_add && LHSName == VName) { // V = V + S
+    info.Step = step->getRHS();
+    info.Increments = true;
+  } else if (step->getOp() == tok_add && RHSName == VName) { // V = S + V
+    info.Step = step->getLHS();
+    info.Increments = true;
+  } else if (step->getOp() == tok_sub && LHSName == VName) { // V = V - S
+    info.Step = step->getRHS();
+    info.Increments = false;
+  } else {
+    return false;
+  }
+  
+  string SName = StaticName(info.Step);
+  string OtherName = (info.UpdatesX) ? YName : XName;
+  return (!SName.empty() && SName != VName
+          && counts[VName] == 1 && counts[SName] == 0
+          && (OtherName.empty() || counts[OtherName] == 0));
+}
+
 /*** Loop Expression ***/
 Value * LoopExpr::CodeGen(Module *M, IRBuilder<> &B)
 {
@@ -852,21 +1745,186 @@ Value * LoopExpr::CodeGen(Module *M, IRBuilder<> &B)
   
   Function *F = B.GetInsertBlock()->getParent();
   
-  /* Condition Block */
-  BasicBlock *ConditionBB = BasicBlock::Create(C, "ConditionBlock", F);
-  B.CreateBr(ConditionBB);
-  IRBuilder<> ConditionB(ConditionBB);
-  
-  BasicBlock *ThenBB = BasicBlock::Create(C, "ThenBlock", F);
   BasicBlock *ThelseBB = BasicBlock::Create(C, "ThelseBlock", F);
   BasicBlock *EndBB = BasicBlock::Create(C, "EndBlock", F);
   
+  /*
+   * Hoisting: variables used by the condition and the body are looked up once, into the preheader.
+   * A named variable is looked up there too when its name comes from a variable that is not
+   * assigned into the loop (and no variable with a dynamic name is assigned).
+   */
+  set<string> names;
+  vector<NamedVarExpr *> namedVars;
+  map<string, int> counts;
+  bool staticAssignments = true;
+  
+  vector<Expr *> loopExprs(_thenExprs);
+  loopExprs.push_back(_conditionExpr);
+  for (vector<Expr *>::iterator it = loopExprs.begin(); it != loopExprs.end(); it++) {
+    if (!(*it))
+      continue;
+    CollectVariables(*it, names, namedVars);
+    staticAssignments &= CountAssignments(*it, counts);
+  }
+  
+  map<string, Value *> hoisted;
+  for (set<string>::iterator it = names.begin(); it != names.end(); it++) {
+    string name = *it;
+    hoisted[name] = VariableNamed(name, M, B); // Returns the outer loop's lookup if already hoisted
+  }
+  __HoistedVariables.push_back(hoisted);
+  
+  vector<NamedVarExpr *> hoistedNamedVars;
+  for (vector<NamedVarExpr *>::iterator it = namedVars.begin(); it != namedVars.end(); it++) {
+    string name = StaticName((*it)->getExpr());
+    if (staticAssignments && !name.empty() && counts[name] == 0
+        && __HoistedNamedVariables.find(*it) == __HoistedNamedVariables.end()) {
+      __HoistedNamedVariables[*it] = (*it)->CodeGen(M, B);
+      hoistedNamedVars.push_back(*it);
+    }
+  }
+  
+  // Temporaries of an iteration are given back at its end
+  Value *RegionMarkV = RegionMark(M, B);
+  RegionMarkV->setName("regionMark");
+  
+  /* Only innermost loops are versioned (the body is generated twice, not once per enclosing loop),
+   * named variables can read |V| by a dynamic name and are left to the generic loop */
+  bool innermost = true;
+  for (vector<Expr *>::iterator it = _thenExprs.begin(); it != _thenExprs.end(); it++)
+    innermost &= !ContainsLoop(*it);
+  
+  CountedLoopInfo info;
+  if (innermost && namedVars.empty() && MatchCountedLoop(_conditionExpr, _thenExprs, info)) {
+    /*
+     * The counted version runs only if all variables are integers, |D| decreases and the last value
+     * of |V| is an integer word, else fallback to the generic loop (the condition is evaluated each iteration).
+     *
+     *   D = X (or X - Y), step = (V is X) == (V = V + S) ? -S : S
+     *   trip = (D > 0) ? (D - 1) / step + 1 : 0
+     *   end = V + trip * S (or V - trip * S)
+     *
+     * CountedLoop.CheckBlock -> [CountedLoop.RangeBlock | ThelseBlock]
+     * CountedLoop.RangeBlock -> [CountedLoop.BodyBlock | GenericLoopBlock]
+     * CountedLoop.BodyBlock (V = phi [V, V +/- S]) -> [CountedLoop.BodyBlock | CountedLoop.ExitBlock]
+     * CountedLoop.ExitBlock (stores |end| into V) -> [EndBlock]
+     */
+    BasicBlock *CheckBB = BasicBlock::Create(C, "CountedLoop.CheckBlock", F);
+    BasicBlock *RangeBB = BasicBlock::Create(C, "CountedLoop.RangeBlock", F);
+    BasicBlock *BodyBB = BasicBlock::Create(C, "CountedLoop.BodyBlock", F);
+    BasicBlock *CountedExitBB = BasicBlock::Create(C, "CountedLoop.ExitBlock", F);
+    BasicBlock *GenericBB = BasicBlock::Create(C, "GenericLoopBlock", F);
+    
+    Value *XPtr = info.X->CodeGen(M, B);
+    Value *YPtr = (info.Y) ? info.Y->CodeGen(M, B) : NULL;
+    Value *SPtr = info.Step->CodeGen(M, B);
+    Value *VPtr = (info.UpdatesX) ? XPtr : YPtr;
+    
+    Value *SWord = LoadObjWord(SPtr, B);
+    Value *AllInts = B.CreateAnd(WordIsInteger(LoadObjWord(XPtr, B), B),
+                                 WordIsInteger(SWord, B));
+    if (YPtr) {
+      AllInts = B.CreateAnd(AllInts, WordIsInteger(LoadObjWord(YPtr, B), B));
+    }
+    
+    Value *SV = WordToInt64(SWord, B);
+    Value *StepV = (info.UpdatesX == info.Increments) ? B.CreateNeg(SV) : SV;
+    StepV->setName("step");
+    Value *Decreases = B.CreateICmpSGT(StepV, B.getInt64(0));
+    B.CreateCondBr(B.CreateAnd(AllInts, Decreases), CheckBB, GenericBB);
+    
+    /* Check Block */
+    IRBuilder<> CheckB(CheckBB);
+    Value *StartWord = LoadObjWord(VPtr, CheckB);
+    Value *D = WordToInt64(LoadObjWord(XPtr, CheckB), CheckB);
+    if (YPtr) {
+      D = CheckB.CreateSub(D, WordToInt64(LoadObjWord(YPtr, CheckB), CheckB));
+    }
+    D->setName("distance");
+    CheckB.CreateCondBr(CheckB.CreateICmpSGT(D, CheckB.getInt64(0)), RangeBB, ThelseBB);
+    
+    /* Range Block: |end| is computed on words (as "a = a + b"), overflows go to the generic loop (that promotes V) */
+    IRBuilder<> RangeB(RangeBB);
+    Value *TripCount = RangeB.CreateAdd(RangeB.CreateSDiv(RangeB.CreateSub(D, RangeB.getInt64(1)), StepV),
+                                        RangeB.getInt64(1), "tripCount");
+    Function *MulF = Intrinsic::getDeclaration(M, Intrinsic::smul_with_overflow, Type::getInt64Ty(C));
+    Value *DeltaPair = RangeB.CreateCall(MulF, ArrayRef<Value *>{ TripCount, SWord });
+    Intrinsic::ID ID = (info.Increments) ? Intrinsic::sadd_with_overflow : Intrinsic::ssub_with_overflow;
+    Function *EndF = Intrinsic::getDeclaration(M, ID, Type::getInt64Ty(C));
+    Value *EndPair = RangeB.CreateCall(EndF, ArrayRef<Value *>{ StartWord, RangeB.CreateExtractValue(DeltaPair, 0) });
+    Value *EndWord = RangeB.CreateExtractValue(EndPair, 0, "end");
+    Value *Overflow = RangeB.CreateOr(RangeB.CreateExtractValue(DeltaPair, 1), RangeB.CreateExtractValue(EndPair, 1));
+    RangeB.CreateCondBr(Overflow, GenericBB, BodyBB, UnlikelyBranchWeights(C));
+    
+    /* Body Block: |V| is a phi, the body reads it from an object of the function (not from its variable)
+     * and its update is not generated (V stays an integer between |start| and |end|, no overflow check) */
+    IRBuilder<> BodyB(BodyBB);
+    PHINode *IndVar = BodyB.CreatePHI(Type::getInt64Ty(C), 2, "indvar");
+    IndVar->addIncoming(StartWord, RangeBB);
+    Value *IndVarObj = EntryObject(BodyB);
+    StoreObjWord(IndVar, IndVarObj, BodyB);
+    
+    string VName = StaticName(info.Update->getLHS());
+    Value *VariablePtr = __HoistedVariables.back()[VName];
+    __HoistedVariables.back()[VName] = IndVarObj;
+    
+    Value *NextIndVar = NULL;
+    for (vector<Expr *>::iterator it = _thenExprs.begin(); it != _thenExprs.end(); it++) {
+      Expr *expr = (*it);
+      if (expr == info.Update) {
+        NextIndVar = (info.Increments) ? BodyB.CreateAdd(IndVar, SWord) : BodyB.CreateSub(IndVar, SWord);
+        NextIndVar->setName("indvar.next");
+        StoreObjWord(NextIndVar, IndVarObj, BodyB);
+      } else if (canGen(expr)) {
+        out() << "Generating code into counted loop block for: " << expr->DebugString() << "\n";
+        expr->CodeGen(M, BodyB);
+      }
+    }
+    __HoistedVariables.back()[VName] = VariablePtr;
+    
+    RegionReset(RegionMarkV, M, BodyB);
+    IndVar->addIncoming(NextIndVar, BodyB.GetInsertBlock());
+    BodyB.CreateCondBr(BodyB.CreateICmpNE(NextIndVar, EndWord), BodyBB, CountedExitBB);
+    
+    /* Exit Block: V held an integer, nothing to release */
+    IRBuilder<> CountedExitB(CountedExitBB);
+    StoreObjWord(EndWord, VPtr, CountedExitB);
+    CountedExitB.CreateBr(EndBB);
+    
+    B.SetInsertPoint(GenericBB);
+  }
+  
+  /*
+   * Generic loop, the condition is generated once, into the header:
+   *
+   * HeaderBlock (first = phi [true, preheader], [false, ThenBlock]) -> [ThenBlock | ExitBlock]
+   * ThenBlock -> [HeaderBlock]
+   * ExitBlock -> [ThelseBlock (if first) | EndBlock]
+   */
+  BasicBlock *PreheaderBB = B.GetInsertBlock();
+  BasicBlock *HeaderBB = BasicBlock::Create(C, "HeaderBlock", F);
+  BasicBlock *ThenBB = BasicBlock::Create(C, "ThenBlock", F);
+  BasicBlock *ExitBB = BasicBlock::Create(C, "ExitBlock", F);
+  B.CreateBr(HeaderBB);
+  
+  /* Header Block */
+  IRBuilder<> HeaderB(HeaderBB);
+  PHINode *FirstIteration = HeaderB.CreatePHI(Type::getInt1Ty(C), 2, "firstIteration");
+  FirstIteration->addIncoming(HeaderB.getTrue(), PreheaderBB);
+  
   // @TODO: Compare with |CreateFCmp[O|U]GT()|
-  Value *ICond = ObjToInt64(_conditionExpr->CodeGen(M, ConditionB), M, ConditionB);
+  Value *CondObj = _conditionExpr->CodeGen(M, HeaderB);
+  Value *ICond = ObjToInt64(CondObj, M, HeaderB);
   ICond->setName("ICond");
-  Value *CompResult = ConditionB.CreateICmpSGT(ICond, ConditionB.getInt64(0)); // Signed Int Comp Greater Than
+  ReleaseTemporary(_conditionExpr, CondObj, M, HeaderB);
+  Value *CompResult = HeaderB.CreateICmpSGT(ICond, HeaderB.getInt64(0)); // Signed Int Comp Greater Than
   CompResult->setName("CompResult");
-  ConditionB.CreateCondBr(CompResult, ThenBB, ThelseBB);
+  HeaderB.CreateCondBr(CompResult, ThenBB, ExitBB);
+  
+  /* Exit Block: the thelse block runs only if the condition was false from the start */
+  IRBuilder<> ExitB(ExitBB);
+  RegionReset(RegionMarkV, M, ExitB);
+  ExitB.CreateCondBr(FirstIteration, ThelseBB, EndBB);
   
   /* Then Block */
   B.SetInsertPoint(ThenBB);
@@ -878,11 +1936,15 @@ Value * LoopExpr::CodeGen(Module *M, IRBuilder<> &B)
       expr->CodeGen(M, ThenB);
     }
   }
-  Value *ThenICond = ObjToInt64(_conditionExpr->CodeGen(M, ThenB), M, ThenB);
-  ThenICond->setName("ThenICond");
-  Value *ThenCompResult = ThenB.CreateICmpSGT(ThenICond, ThenB.getInt64(0)); // Signed Int Comp Greater Than
-  ThenCompResult->setName("ThenCompResult");
-  ThenB.CreateCondBr(ThenCompResult, ThenBB, EndBB);
+  RegionReset(RegionMarkV, M, ThenB);
+  FirstIteration->addIncoming(ThenB.getFalse(), ThenB.GetInsertBlock());
+  ThenB.CreateBr(HeaderBB);
+  
+  /* Lookups hoisted for this loop belong to its body (the names it uses, and named variables checked
+   * against its assignments only), the thelse block does its own lookups (the preheader dominates it) */
+  __HoistedVariables.pop_back();
+  for (vector<NamedVarExpr *>::iterator it = hoistedNamedVars.begin(); it != hoistedNamedVars.end(); it++)
+    __HoistedNamedVariables.erase(*it);
   
   /* Thelse Block */
   B.SetInsertPoint(ThelseBB);
@@ -906,13 +1968,34 @@ Value * LengthFuncExpr::CodeGen(Module *M, IRBuilder<> &B)
   LLVMContext &C = M->getContext();
   
   Value *V = _expr->CodeGen(M, B);
-  Value *Str = ObjToStr(V, M, B);
+  Value *Word = LoadObjWord(V, B);
+  
+  Function *F = B.GetInsertBlock()->getParent();
+  BasicBlock *IntBB = BasicBlock::Create(C, "Length.IntegerBlock", F);
+  BasicBlock *StrBB = BasicBlock::Create(C, "Length.StringBlock", F);
+  BasicBlock *DoneBB = BasicBlock::Create(C, "Length.DoneBlock", F);
+  B.CreateCondBr(WordIsInteger(Word, B), IntBB, StrBB);
+  
+  /* Integer Block: length of the decimal form, without conversion */
+  IRBuilder<> IntB(IntBB);
+  Value *IntLength = RuntimeIntLength(WordToInt64(Word, IntB), M, IntB);
+  IntB.CreateBr(DoneBB);
+  
+  /* String Block */
+  IRBuilder<> StrB(StrBB);
+  Value *StrLength = StrWordLength(Word, M, StrB);
+  StrB.CreateBr(DoneBB);
+  
+  B.SetInsertPoint(DoneBB);
+  PHINode *Length = B.CreatePHI(Type::getInt64Ty(C), 2);
+  Length->addIncoming(IntLength, IntBB);
+  Length->addIncoming(StrLength, StrBB);
+  
+  if (IsTemporary(_expr))
+    ObjRelease(Word, M, B);
   
-  Value *NewPtr = B.CreateAlloca(getObjTy(C));
-  B.CreateStore(Strlen(Str, M, B),
-                B.CreateStructGEP(getObjTy(C), NewPtr, ObjectFieldData));
-  B.CreateStore(B.getInt1(ObjectTypeInteger),
-                B.CreateStructGEP(getObjTy(C), NewPtr, ObjectFieldType));
+  Value *NewPtr = EntryObject(B);
+  StoreObjWord(Int64ToWord(Length, B), NewPtr, B);
   return NewPtr;
 }
 
@@ -1,6 +1,9 @@
 #ifndef SMIL_CODE_GEN_H
 #define SMIL_CODE_GEN_H
 
+#include <map>
+#include <set>
+
 #include "llvm/Transforms/Utils/BuildLibCalls.h"
 #include "llvm/IR/Intrinsics.h" // For nop expr
 #include "llvm/IR/IRBuilder.h"
@@ -8,12 +11,22 @@
 #include "llvm/IR/Value.h"
 
 #include "ObjectType.h"
+#include "StringType.h"
+#include "RefCount.h"
+#include "Region.h"
+#include "BigInt.h"
 #include "Expr.h"
 #include "Utilities.h"
 #include "HashTable.h"
+#include "Runtime.h"
+
+#define kPrintBufferSize 256 // Stack buffer of the print functions (longer lines are allocated)
 
 Value * InputAtIndex(int index /* >= 0 */, Module *M, IRBuilder<> &B);
 
+/* Return the %obj* of the variable |name| (from the integer table for names like "42") */
+Value * VariableNamed(string &name, Module *M, IRBuilder<> &B);
+
 bool canGen(Expr *expr);
 
 #endif // SMIL_CODE_GEN_H
\ No newline at end of file
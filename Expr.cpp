@@ -41,6 +41,9 @@ string InputExpr::DebugString()
 }
 
 /*** Variable Expression ***/
+
+set<string> VarExpr::_names;
+
 string VarExpr::DebugString()
 {
   string s = ((_inversed) ? "inversed " : "");
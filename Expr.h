@@ -2,6 +2,7 @@
 #define SMIL_EXPR_H
 
 #include <string>
+#include <set>
 #include <sstream>
 #include <iostream>
 #include <fstream>
@@ -111,6 +112,7 @@ protected:
   int _index;
 public:
   static int getIndexesCount() { return InputExpr::_indexesCount; }
+  int getIndex() const { return _index; }
   
   InputExpr(int index, int line = -1, int col = -1)
   : Expr(line, col), _index(index)
@@ -147,11 +149,16 @@ public:
 /*** Variable Expression ***/
 class VarExpr : public AssignableExpr {
 protected:
+  static set<string> _names;
   string _name;
   bool _inversed;
 public:
+  /* Number of distinct names of variables parsed (to presize the table of variables) */
+  static size_t getNamesCount() { return VarExpr::_names.size(); }
+  
   VarExpr(string &name, bool inversed = false, int line = -1, int col = -1)
-  : AssignableExpr(line, col), _name(name), _inversed(inversed) { }
+  : AssignableExpr(line, col), _name(name), _inversed(inversed)
+  { VarExpr::_names.insert(name); }
   
   REGISTER_CLASSNAME(ExprKindVar)
   
@@ -177,6 +184,8 @@ public:
   
   Value * CodeGen(Module *M, IRBuilder<> &B);
   
+  Expr * getExpr() { return _expr; }
+  
   string getName() const { return NULL; }
   bool getInversed() const { return false; }
   
@@ -197,6 +206,9 @@ public:
   
   Value * CodeGen(Module *M, IRBuilder<> &B);
   
+  Expr * getLHS() { return _LHS; }
+  Expr * getRHS() { return _RHS; }
+  
   string DebugString();
   
   ~InitExpr() {};
@@ -215,6 +227,10 @@ public:
   
   Value * CodeGen(Module *M, IRBuilder<> &B);
   
+  Expr * getLHS() { return _LHS; }
+  Expr * getRHS() { return _RHS; }
+  Token getOp() { return _op; }
+  
   string DebugString();
   
   ~BinOpExpr() {};
@@ -232,6 +248,8 @@ public:
   
   Value * CodeGen(Module *M, IRBuilder<> &B);
   
+  vector<Expr *> &getOutput() { return output; }
+  
   string DebugString();
   
   ~PrintExpr() {};
@@ -295,6 +313,8 @@ public:
   
   Value * CodeGen(Module *M, IRBuilder<> &B);
   
+  Expr * getExpr() { return _expr; }
+  
   string DebugString();
   
   ~PushExpr() {};
@@ -312,6 +332,8 @@ public:
   
   Value * CodeGen(Module *M, IRBuilder<> &B);
   
+  Expr * getExpr() { return _expr; }
+  
   string DebugString();
   
   ~PopExpr() {};
@@ -346,6 +368,10 @@ public:
   
   Value * CodeGen(Module *M, IRBuilder<> &B);
   
+  Expr * getCondition() { return _conditionExpr; }
+  vector<Expr *> &getThenExprs() { return _thenExprs; }
+  vector<Expr *> &getThelseExprs() { return _thelseExprs; }
+  
   string DebugString();
   
   ~LoopExpr() {};
@@ -363,6 +389,8 @@ public:
   
   Value * CodeGen(Module *M, IRBuilder<> &B);
   
+  Expr * getExpr() { return _expr; }
+  
   string DebugString();
   
   ~LengthFuncExpr() {};
@@ -1,19 +1,19 @@
 #include "HashTable.h"
+#include "StringType.h"
+#include "RefCount.h"
+#include "Intern.h"
+#include "Utilities.h"
 
 // i32 @hash(i8* %str)
 Value *Hash(Value *Str, Module *M, IRBuilder<> &B)
 {
-  /* unsigned long hash(const char * s) {
-   *   unsigned long hash = 0;
-   *   char c;
-   *   while (c = *s++) {
-   *     hash = c + (hash << 6) + (hash << 16) - hash;
-   *   }
-   *   return hash % kBucketSize;
+  /* unsigned hash(const char * s) {
+   *   return strhash(s);
    * }
    */
   
-  /* This uses the SDBM hash (http://www.cse.yorku.ca/~oz/hash.html#sdbm) */
+  /* Keys are strings with a header, their hash is computed once (see "StrHash()"),
+   * its low 7 bits are the control byte of the key, the other bits select its first group */
   
   LLVMContext &C = M->getContext();
   Function *HashF = cast<Function>(M->getOrInsertFunction("hash", Type::getInt32Ty(C),
@@ -28,210 +28,451 @@ Value *Hash(Value *Str, Module *M, IRBuilder<> &B)
     IRBuilder<> HashB(HashBB);
     HashB.SetInsertPoint(HashBB);
     
-    Value *HPtr = HashB.CreateAlloca(Type::getInt32Ty(C));
-    HPtr->setName("hashPtr");
-    HashB.CreateStore(HashB.getInt32(0), HPtr);
-    
-    Value *IPtr = HashB.CreateAlloca(Type::getInt32Ty(C));
-    IPtr->setName("indexPtr");
-    HashB.CreateStore(HashB.getInt32(0), IPtr);
-    
-    BasicBlock *LoopBB = BasicBlock::Create(C, "Loop", HashF);
-    HashB.CreateBr(LoopBB);
-    
-    IRBuilder<> LoopB(LoopBB);
-    HashB.SetInsertPoint(LoopBB);
-    
-    BasicBlock *DoneBB = BasicBlock::Create(C, "Done", HashF);
-    
-    Value *Index = LoopB.CreateLoad(IPtr);
-    Value *Char = LoopB.CreateLoad(LoopB.CreateGEP(StrArg, Index));
-    
-    Value *Hash = LoopB.CreateLoad(HPtr);
-    Value *Char32 = LoopB.CreateIntCast(Char, Type::getInt32Ty(C), false);
-    /* hash = c + (hash << 6) + (hash << 16) - hash; */
-    Value *Add1 = LoopB.CreateAdd(Char32,
-                                  LoopB.CreateShl(Hash, 6));
-    Value *Add2 = LoopB.CreateAdd(Add1,
-                                  LoopB.CreateShl(Hash, 16));
-    LoopB.CreateStore(LoopB.CreateSub(Add2, Hash),
-                      HPtr);
-    
-    // Increment Index (string pointer offset)
-    Value *Add = LoopB.CreateAdd(Index,
-                                 LoopB.getInt32(1));
-    LoopB.CreateStore(Add, IPtr);
-    
-    // Loop until |Char| equals to zero
-    Value *Res = LoopB.CreateICmpEQ(Char, LoopB.getInt8(0));
-    LoopB.CreateCondBr(Res, DoneBB, LoopBB);
-    
-    IRBuilder<> DoneB(DoneBB);
-    HashB.SetInsertPoint(DoneBB);
-    
-    // Apply modulus (|Hash| % kBucketCount)
-    Value *FinalHash = DoneB.CreateURem(DoneB.CreateLoad(HPtr),
-                                        DoneB.getInt32(kBucketCount));
-    DoneB.CreateRet(FinalHash);
+    HashB.CreateRet(StrHash(StrArg, M, HashB));
   }
   
   // Call hash function
   return B.CreateCall(HashF, CastToCStr(Str, B));
 }
 
-StructType * BucketType(LLVMContext &C)
+StructType * InlineCacheEntryType(LLVMContext &C)
 {
-  static StructType *BucketType = NULL;
-  if (!BucketType) {
-    // struct bucket { i8 ** keys; %obj ** values; i32 size; i32 max_size; };
-    BucketType = StructType::create("bucket",
-                                    Type::getInt8PtrTy(C)->getPointerTo(),
-                                    getObjPtrTy(C)->getPointerTo(),
-                                    Type::getInt32Ty(C),
-                                    Type::getInt32Ty(C), NULL);
+  static StructType *EntryType = NULL;
+  if (!EntryType) {
+    // struct icentry { i32 generation; i64 word; i8* key; %obj* value; };
+    EntryType = StructType::create("icentry",
+                                   Type::getInt32Ty(C),
+                                   Type::getInt64Ty(C),
+                                   Type::getInt8PtrTy(C),
+                                   getObjPtrTy(C), NULL);
   }
-  return BucketType;
+  return EntryType;
 }
 
-static GlobalVariable *__Map = NULL;
+StructType * InlineCacheType(LLVMContext &C)
+{
+  static StructType *CacheType = NULL;
+  if (!CacheType) {
+    // struct icache { i32 next; struct icentry entries[kInlineCacheSize]; };
+    CacheType = StructType::create("icache",
+                                   Type::getInt32Ty(C),
+                                   ArrayType::get(InlineCacheEntryType(C), kInlineCacheSize), NULL);
+  }
+  return CacheType;
+}
+
+/* Variable table: i8 ctrl[cap], i32 hashes[cap], i8* keys[cap], %obj* values[cap] (see "HashTable.h") */
+static GlobalVariable *__MapCtrl = NULL;
+static GlobalVariable *__MapHashes = NULL;
+static GlobalVariable *__MapKeys = NULL;
+static GlobalVariable *__MapValues = NULL;
+static GlobalVariable *__MapCap = NULL;
+static GlobalVariable *__MapCount = NULL;
+static GlobalVariable *__MapGeneration = NULL;
+
+/* Previous table while growing (its entries are moved a few at a time, see "MigrateStep()"),
+ * and index of its next slot to move */
+static GlobalVariable *__MapOldCtrl = NULL;
+static GlobalVariable *__MapOldHashes = NULL;
+static GlobalVariable *__MapOldKeys = NULL;
+static GlobalVariable *__MapOldValues = NULL;
+static GlobalVariable *__MapOldCap = NULL;
+static GlobalVariable *__MapMigrated = NULL;
+
+/* Capacity of the first allocation of the table (presized, see "InitVarTable()") */
+static uint64_t __MapInitialSize = kMapMinSize;
 
-GlobalVariable * InitVarTable(Module *M)
+/* Integer table, dense part: %obj* dense[densecap] */
+static GlobalVariable *__IntMapDense = NULL;
+static GlobalVariable *__IntMapDenseCap = NULL;
+
+/* Integer table, sparse part: i64 keys[cap], %obj* values[cap] (NULL value for empty slots) */
+static GlobalVariable *__IntMapKeys = NULL;
+static GlobalVariable *__IntMapValues = NULL;
+static GlobalVariable *__IntMapCap = NULL;
+static GlobalVariable *__IntMapCount = NULL;
+
+/* Slab of variables: %obj* next, %obj* end (cells left into the current block) */
+static GlobalVariable *__SlabNext = NULL;
+static GlobalVariable *__SlabEnd = NULL;
+
+GlobalVariable * InitVarTable(Module *M, uint64_t namesCount)
 {
   LLVMContext &C = M->getContext();
-  ArrayType * Ty = ArrayType::get(BucketType(C), kBucketCount);
-  vector<Constant *> constants;
-  for (int i = 0; i < kBucketCount; i++) {
-    Constant *Zero = ConstantInt::get(Type::getInt32Ty(C), 0);
-    Constant *NullPtr = ConstantPointerNull::get(Type::getInt8PtrTy(C)->getPointerTo()); // %i8**
-    Constant *NullObjPtr = ConstantPointerNull::get(getObjPtrTy(C)->getPointerTo()); // %obj**
-    constants.push_back(ConstantStruct::get(BucketType(C),
-                                            ArrayRef<Constant *>{ NullPtr, NullObjPtr, Zero, Zero }));
+  
+  // Smallest capacity holding |namesCount| keys without growing
+  __MapInitialSize = kMapMinSize;
+  while (__MapInitialSize * kMapMaxLoad < namesCount * 8)
+    __MapInitialSize *= 2;
+  
+  /* Variable table (empty, allocated on first insert) */
+  Constant *NullObjPtr = ConstantPointerNull::get(getObjPtrTy(C)->getPointerTo()); // %obj**
+  Constant *Zero64 = ConstantInt::get(Type::getInt64Ty(C), 0);
+  
+  __MapCtrl = new GlobalVariable(*M, Type::getInt8PtrTy(C), false /* non-constant */,
+                                 GlobalValue::WeakAnyLinkage, // Keep one copy of named function when linking (weak)
+                                 ConstantPointerNull::get(Type::getInt8PtrTy(C)), "_map.ctrl");
+  __MapHashes = new GlobalVariable(*M, Type::getInt32PtrTy(C), false,
+                                   GlobalValue::WeakAnyLinkage,
+                                   ConstantPointerNull::get(Type::getInt32PtrTy(C)), "_map.hashes");
+  __MapKeys = new GlobalVariable(*M, Type::getInt8PtrTy(C)->getPointerTo(), false,
+                                 GlobalValue::WeakAnyLinkage,
+                                 ConstantPointerNull::get(Type::getInt8PtrTy(C)->getPointerTo()), "_map.keys");
+  __MapValues = new GlobalVariable(*M, getObjPtrTy(C)->getPointerTo(), false,
+                                   GlobalValue::WeakAnyLinkage, NullObjPtr, "_map.values");
+  __MapCap = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                GlobalValue::WeakAnyLinkage, Zero64, "_map.cap");
+  __MapCount = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                  GlobalValue::WeakAnyLinkage, Zero64, "_map.count");
+  
+  /* No growth in progress */
+  __MapOldCtrl = new GlobalVariable(*M, Type::getInt8PtrTy(C), false,
+                                    GlobalValue::WeakAnyLinkage,
+                                    ConstantPointerNull::get(Type::getInt8PtrTy(C)), "_map.old.ctrl");
+  __MapOldHashes = new GlobalVariable(*M, Type::getInt32PtrTy(C), false,
+                                      GlobalValue::WeakAnyLinkage,
+                                      ConstantPointerNull::get(Type::getInt32PtrTy(C)), "_map.old.hashes");
+  __MapOldKeys = new GlobalVariable(*M, Type::getInt8PtrTy(C)->getPointerTo(), false,
+                                    GlobalValue::WeakAnyLinkage,
+                                    ConstantPointerNull::get(Type::getInt8PtrTy(C)->getPointerTo()), "_map.old.keys");
+  __MapOldValues = new GlobalVariable(*M, getObjPtrTy(C)->getPointerTo(), false,
+                                      GlobalValue::WeakAnyLinkage, NullObjPtr, "_map.old.values");
+  __MapOldCap = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                   GlobalValue::WeakAnyLinkage, Zero64, "_map.old.cap");
+  __MapMigrated = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                     GlobalValue::WeakAnyLinkage, Zero64, "_map.migrated");
+  
+  /* Inline caches only trust entries filled during the current generation (0 is kept for empty entries),
+   * to increment if a cached (word -> cell) mapping can change: cells are never moved nor removed
+   * (see "NewVariable()"), so the growth of the table keeps them */
+  __MapGeneration = new GlobalVariable(*M, Type::getInt32Ty(C), false /* non-constant */,
+                                       GlobalValue::WeakAnyLinkage,
+                                       ConstantInt::get(Type::getInt32Ty(C), 1), "_map.generation");
+  
+  /* Integer table (empty) */
+  Constant *NullKeysPtr = ConstantPointerNull::get(Type::getInt64PtrTy(C)); // i64*
+  
+  __IntMapDense = new GlobalVariable(*M, getObjPtrTy(C)->getPointerTo(), false,
+                                     GlobalValue::WeakAnyLinkage, NullObjPtr, "_intmap.dense");
+  __IntMapDenseCap = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                        GlobalValue::WeakAnyLinkage, Zero64, "_intmap.densecap");
+  __IntMapKeys = new GlobalVariable(*M, Type::getInt64PtrTy(C), false,
+                                    GlobalValue::WeakAnyLinkage, NullKeysPtr, "_intmap.keys");
+  __IntMapValues = new GlobalVariable(*M, getObjPtrTy(C)->getPointerTo(), false,
+                                      GlobalValue::WeakAnyLinkage, NullObjPtr, "_intmap.values");
+  __IntMapCap = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                   GlobalValue::WeakAnyLinkage, Zero64, "_intmap.cap");
+  __IntMapCount = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                     GlobalValue::WeakAnyLinkage, Zero64, "_intmap.count");
+  
+  /* Slab of variables (no block yet) */
+  Constant *NullCellPtr = ConstantPointerNull::get(getObjPtrTy(C)); // %obj*
+  __SlabNext = new GlobalVariable(*M, getObjPtrTy(C), false,
+                                  GlobalValue::WeakAnyLinkage, NullCellPtr, "_slab.next");
+  __SlabEnd = new GlobalVariable(*M, getObjPtrTy(C), false,
+                                 GlobalValue::WeakAnyLinkage, NullCellPtr, "_slab.end");
+  return __MapCtrl;
+}
+
+/* Control byte of a key of hash |Hash| (its low 7 bits, never kMapCtrlEmpty) */
+static Value * HashCtrl(Value *Hash, IRBuilder<> &B)
+{
+  return B.CreateTrunc(B.CreateAnd(Hash, B.getInt32(0x7F)), B.getInt8Ty());
+}
+
+/* First group to probe for a key of hash |Hash| (its other bits) */
+static Value * HashGroup(Value *Hash, Value *GroupMask, IRBuilder<> &B)
+{
+  return B.CreateAnd(B.CreateZExt(B.CreateLShr(Hash, 7), B.getInt64Ty()), GroupMask);
+}
+
+/* Mask of the slots of the group |Group| whose control byte is |Byte| (bit i for the slot i),
+ * the kMapGroupSize control bytes are compared at once (vector) */
+static Value * GroupMatch(Value *Ctrl, Value *Group, Value *Byte, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  Type *GroupTy = VectorType::get(Type::getInt8Ty(C), kMapGroupSize);
+  Value *GroupPtr = B.CreatePointerCast(B.CreateGEP(Ctrl, B.CreateMul(Group, B.getInt64(kMapGroupSize))),
+                                        GroupTy->getPointerTo());
+  Value *Bytes = B.CreateAlignedLoad(GroupPtr, 1);
+  Value *Matches = B.CreateICmpEQ(Bytes, B.CreateVectorSplat(kMapGroupSize, Byte)); // <16 x i1>
+  return B.CreateBitCast(Matches, Type::getIntNTy(C, kMapGroupSize));
+}
+
+/* Index into the table of the first slot of |Mask| (not zero) of the group |Group| */
+static Value * GroupSlot(Value *Group, Value *Mask, Module *M, IRBuilder<> &B)
+{
+  Function *CttzF = Intrinsic::getDeclaration(M, Intrinsic::cttz, Mask->getType());
+  Value *Bit = B.CreateCall(CttzF, ArrayRef<Value *>{ Mask, B.getTrue() /* not zero */ });
+  return B.CreateAdd(B.CreateMul(Group, B.getInt64(kMapGroupSize)),
+                     B.CreateZExt(Bit, B.getInt64Ty()));
+}
+
+/* Index of the first empty slot for a key of hash |Hash| into the table |Ctrl| of |Cap| slots
+ * (there is always one, see kMapMaxLoad), |B| continues after the probing */
+static Value * FindEmptySlot(Value *Hash, Value *Ctrl, Value *Cap, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  Function *F = B.GetInsertBlock()->getParent();
+  
+  BasicBlock *PreBB = B.GetInsertBlock();
+  BasicBlock *ProbeBB = BasicBlock::Create(C, "FindEmptyBlock", F);
+  BasicBlock *FoundBB = BasicBlock::Create(C, "FoundEmptyBlock", F);
+  
+  Value *GroupMask = B.CreateSub(B.CreateUDiv(Cap, B.getInt64(kMapGroupSize)), B.getInt64(1));
+  Value *FirstGroup = HashGroup(Hash, GroupMask, B);
+  B.CreateBr(ProbeBB);
+  
+  /* Find Empty Block: triangular probing (visits all groups, their count is a power of two) */
+  IRBuilder<> PB(ProbeBB);
+  PHINode *Group = PB.CreatePHI(Type::getInt64Ty(C), 2, "group");
+  PHINode *Step = PB.CreatePHI(Type::getInt64Ty(C), 2, "step");
+  Group->addIncoming(FirstGroup, PreBB);
+  Step->addIncoming(PB.getInt64(1), PreBB);
+  Value *EmptyMask = GroupMatch(Ctrl, Group, PB.getInt8(kMapCtrlEmpty), PB);
+  Group->addIncoming(PB.CreateAnd(PB.CreateAdd(Group, Step), GroupMask), ProbeBB);
+  Step->addIncoming(PB.CreateAdd(Step, PB.getInt64(1)), ProbeBB);
+  PB.CreateCondBr(PB.CreateIsNotNull(EmptyMask), FoundBB, ProbeBB);
+  
+  B.SetInsertPoint(FoundBB);
+  return GroupSlot(Group, EmptyMask, M, B);
+}
+
+// void @migratestep()
+static void MigrateStep(Module *M, IRBuilder<> &B)
+{
+  /* void migratestep() {
+   *   long i = _map.migrated;
+   *   long end = min(i + kMapMigrateStep, _map.old.cap);
+   *   for (; i < end; i++) {
+   *     if (_map.old.ctrl[i] == kMapCtrlEmpty) continue;
+   *     long j = findempty(_map.ctrl, _map.cap, _map.old.hashes[i]); // Not into the new table yet
+   *     _map.ctrl[j] = _map.old.ctrl[i]; _map.hashes[j] = _map.old.hashes[i];
+   *     _map.keys[j] = _map.old.keys[i]; _map.values[j] = _map.old.values[i];
+   *   }
+   *   _map.migrated = end;
+   *
+   *   if (end == _map.old.cap) { // Drained
+   *     free(_map.old.ctrl); free(_map.old.hashes); free(_map.old.keys); free(_map.old.values);
+   *     _map.old.cap = 0;
+   *   }
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *MigrateF = cast<Function>(M->getOrInsertFunction("migratestep", Type::getVoidTy(C),
+                                                             (Type *)0));
+  if (MigrateF->empty()) {
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", MigrateF);
+    IRBuilder<> EB(EntryBB);
+    
+    Value *OldCap = EB.CreateLoad(__MapOldCap);
+    Value *OldCtrl = EB.CreateLoad(__MapOldCtrl);
+    Value *OldHashes = EB.CreateLoad(__MapOldHashes);
+    Value *OldKeys = EB.CreateLoad(__MapOldKeys);
+    Value *OldValues = EB.CreateLoad(__MapOldValues);
+    Value *Start = EB.CreateLoad(__MapMigrated);
+    Value *StepEnd = EB.CreateAdd(Start, EB.getInt64(kMapMigrateStep));
+    Value *End = EB.CreateSelect(EB.CreateICmpULT(StepEnd, OldCap), StepEnd, OldCap, "end");
+    
+    BasicBlock *LoopBB = BasicBlock::Create(C, "Loop", MigrateF);
+    BasicBlock *MoveBB = BasicBlock::Create(C, "MoveBlock", MigrateF);
+    BasicBlock *ReinsertBB = BasicBlock::Create(C, "ReinsertBlock", MigrateF);
+    BasicBlock *NextBB = BasicBlock::Create(C, "NextBlock", MigrateF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", MigrateF);
+    BasicBlock *DrainedBB = BasicBlock::Create(C, "DrainedBlock", MigrateF);
+    BasicBlock *RetBB = BasicBlock::Create(C, "RetBlock", MigrateF);
+    EB.CreateBr(LoopBB);
+    
+    /* Loop block: for (; i < end; i++) */
+    IRBuilder<> LoopB(LoopBB);
+    PHINode *Counter = LoopB.CreatePHI(Type::getInt64Ty(C), 2, "counter");
+    Counter->addIncoming(Start, EntryBB);
+    LoopB.CreateCondBr(LoopB.CreateICmpULT(Counter, End), MoveBB, DoneBB);
+    
+    /* Move block: skip empty slots */
+    IRBuilder<> MoveB(MoveBB);
+    Value *CtrlByte = MoveB.CreateLoad(MoveB.CreateGEP(OldCtrl, Counter));
+    MoveB.CreateCondBr(MoveB.CreateICmpEQ(CtrlByte, MoveB.getInt8(kMapCtrlEmpty)), NextBB, ReinsertBB);
+    
+    /* Reinsert block: with the stored hash (keys are not read) */
+    IRBuilder<> RB(ReinsertBB);
+    Value *KeyHash = RB.CreateLoad(RB.CreateGEP(OldHashes, Counter));
+    Value *Ctrl = RB.CreateLoad(__MapCtrl);
+    Value *Slot = FindEmptySlot(KeyHash, Ctrl, RB.CreateLoad(__MapCap), M, RB);
+    RB.CreateStore(CtrlByte, RB.CreateGEP(Ctrl, Slot));
+    RB.CreateStore(KeyHash, RB.CreateGEP(RB.CreateLoad(__MapHashes), Slot));
+    RB.CreateStore(RB.CreateLoad(RB.CreateGEP(OldKeys, Counter)),
+                   RB.CreateGEP(RB.CreateLoad(__MapKeys), Slot));
+    RB.CreateStore(RB.CreateLoad(RB.CreateGEP(OldValues, Counter)),
+                   RB.CreateGEP(RB.CreateLoad(__MapValues), Slot));
+    RB.CreateBr(NextBB);
+    
+    /* Next block */
+    IRBuilder<> NextB(NextBB);
+    Counter->addIncoming(NextB.CreateAdd(Counter, NextB.getInt64(1)), NextBB);
+    NextB.CreateBr(LoopBB);
+    
+    /* Done block */
+    IRBuilder<> DoneB(DoneBB);
+    DoneB.CreateStore(End, __MapMigrated);
+    DoneB.CreateCondBr(DoneB.CreateICmpEQ(End, OldCap), DrainedBB, RetBB);
+    
+    /* Drained block */
+    IRBuilder<> DB(DrainedBB);
+    
+    // void @free(i8*)
+    FunctionType *FreeTy = FunctionType::get(Type::getVoidTy(C),
+                                             ArrayRef<Type *>{ Type::getInt8PtrTy(C) }, false);
+    Function *FreeF = cast<Function>(M->getOrInsertFunction("free", FreeTy));
+    
+    DB.CreateCall(FreeF, OldCtrl);
+    DB.CreateCall(FreeF, DB.CreatePointerCast(OldHashes, Type::getInt8PtrTy(C)));
+    DB.CreateCall(FreeF, DB.CreatePointerCast(OldKeys, Type::getInt8PtrTy(C)));
+    DB.CreateCall(FreeF, DB.CreatePointerCast(OldValues, Type::getInt8PtrTy(C)));
+    DB.CreateStore(DB.getInt64(0), __MapOldCap);
+    DB.CreateBr(RetBB);
+    
+    IRBuilder<> RetB(RetBB);
+    RetB.CreateRetVoid();
   }
-  ArrayRef<Constant *> Constants = ArrayRef<Constant *>(constants);
-  Constant *InitPtr = ConstantArray::get(Ty, Constants);
   
-  __Map = new GlobalVariable(*M, Ty, false /* non-constant */,
-                             GlobalValue::WeakAnyLinkage, // Keep one copy of named function when linking (weak)
-                             InitPtr, "_map");
-  return __Map;
+  // Call "migratestep" function
+  B.CreateCall(MigrateF, ArrayRef<Value *>{});
+}
+
+/* Emit a call to "@migratestep" if a growth of the table is not drained yet, |B| continues after */
+static void MigrateStepIfNeeded(Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  Function *F = B.GetInsertBlock()->getParent();
+  
+  BasicBlock *MigrateBB = BasicBlock::Create(C, "MigrateBlock", F);
+  BasicBlock *MigratedBB = BasicBlock::Create(C, "MigratedBlock", F);
+  B.CreateCondBr(B.CreateICmpNE(B.CreateLoad(__MapOldCap), B.getInt64(0)), MigrateBB, MigratedBB);
+  
+  IRBuilder<> MB(MigrateBB);
+  MigrateStep(M, MB);
+  MB.CreateBr(MigratedBB);
+  
+  B.SetInsertPoint(MigratedBB);
 }
 
-// void @upsize(%bucket* %b)
-void Upsize(Value *BucketPtr, Module *M, IRBuilder<> &B)
+// void @upsize()
+void Upsize(Module *M, IRBuilder<> &B)
 {
-  /* void upsize(struct str_array * arr) {
-   *   arr->max_size += kArrayBaseSize;
-   
-   *   int size = arr->size * sizeof(char *);
-   *   int new_size = arr->max_size * sizeof(char *);
-   
-   *   char ** new_keys = (char **)malloc(new_size);
-   *   memcpy(new_keys, arr->keys, size);
-   *   arr->keys = new_keys;
-   
-   *   char ** new_values = (char **)malloc(new_size);
-   *   memcpy(new_values, arr->values, size);
-   *   arr->values = new_values;
+  /* void upsize() {
+   *   while (_map.old.cap) // The previous growth is not drained yet (rare)
+   *     migratestep();
+   *
+   *   // Entries are moved by "migratestep()", from each following lookup or insert
+   *   _map.old.ctrl = _map.ctrl; _map.old.hashes = _map.hashes;
+   *   _map.old.keys = _map.keys; _map.old.values = _map.values;
+   *   _map.old.cap = _map.cap;
+   *   _map.migrated = 0;
+   *
+   *   long cap = (_map.cap) ? _map.cap * 2 : kMapInitialSize;
+   *   _map.ctrl = (char *)malloc(cap);
+   *   memset(_map.ctrl, kMapCtrlEmpty, cap);
+   *   _map.hashes = (unsigned *)malloc(cap * sizeof(unsigned));
+   *   _map.keys = (char **)malloc(cap * sizeof(char *));
+   *   _map.values = (obj **)malloc(cap * sizeof(obj *));
+   *   _map.cap = cap; // Inline caches are kept (cells are not moved)
    * }
    */
   
   LLVMContext &C = M->getContext();
   
-  // void @upsize(%bucket* %b)
+  // void @upsize()
   Function *UpsizeF = cast<Function>(M->getOrInsertFunction("upsize", Type::getVoidTy(C),
-                                                            BucketType(C)->getPointerTo(),
                                                             (Type *)0));
   if (UpsizeF->empty()) {
-    Argument *BArg = UpsizeF->arg_begin();
-    BArg->setName("b");
-    
     BasicBlock *UpBB = BasicBlock::Create(C, "EntryBlock", UpsizeF);
+    BasicBlock *DrainBB = BasicBlock::Create(C, "DrainBlock", UpsizeF);
+    BasicBlock *GrowBB = BasicBlock::Create(C, "GrowBlock", UpsizeF);
     IRBuilder<> UpB(UpBB);
-    UpB.SetInsertPoint(UpBB);
-    
-    // arr->max_size += kArrayBaseSize;
-    Value *MaxSizePtr = UpB.CreateStructGEP(BucketType(C), BArg, BucketFieldMaxSize);
-    Value *Add = UpB.CreateAdd(UpB.CreateLoad(MaxSizePtr),
-                               UpB.getInt32(kBucketDefaultSize));
-    UpB.CreateStore(Add, MaxSizePtr);
-    
-    // int new_size = arr->max_size * sizeof(char *);
-    Value *NewSize = UpB.CreateMul(Add,
-                                   UpB.getInt32(kBucketDefaultSize));
-    
-    // i8* @realloc(i8*, i64)
-    Type* ReallocArgs[] = { Type::getInt8PtrTy(C), Type::getInt64Ty(C) };
-    FunctionType *ReallocTy = FunctionType::get(Type::getInt8PtrTy(C), ReallocArgs, false);
-    Function *ReallocF = cast<Function>(M->getOrInsertFunction("realloc", ReallocTy));
+    UpB.CreateBr(DrainBB);
+    
+    /* Drain block */
+    IRBuilder<> DB(DrainBB);
+    BasicBlock *DrainStepBB = BasicBlock::Create(C, "DrainStepBlock", UpsizeF);
+    DB.CreateCondBr(DB.CreateICmpNE(DB.CreateLoad(__MapOldCap), DB.getInt64(0)), DrainStepBB, GrowBB);
+    
+    IRBuilder<> DSB(DrainStepBB);
+    MigrateStep(M, DSB);
+    DSB.CreateBr(DrainBB);
+    
+    /* Grow block: the current table becomes the old one */
+    IRBuilder<> GB(GrowBB);
+    Value *OldCap = GB.CreateLoad(__MapCap);
+    GB.CreateStore(GB.CreateLoad(__MapCtrl), __MapOldCtrl);
+    GB.CreateStore(GB.CreateLoad(__MapHashes), __MapOldHashes);
+    GB.CreateStore(GB.CreateLoad(__MapKeys), __MapOldKeys);
+    GB.CreateStore(GB.CreateLoad(__MapValues), __MapOldValues);
+    GB.CreateStore(OldCap, __MapOldCap);
+    GB.CreateStore(GB.getInt64(0), __MapMigrated);
+    
+    Value *NewCap = GB.CreateSelect(GB.CreateICmpEQ(OldCap, GB.getInt64(0)),
+                                    GB.getInt64(__MapInitialSize),
+                                    GB.CreateMul(OldCap, GB.getInt64(2)), "newCap");
     
-    // char ** new_keys = (char **)malloc(new_size);
-    // memcpy(new_keys, arr->keys, size);
-    // arr->keys = new_keys;
-    Value * AllocSize = UpB.CreateMul(UpB.getInt64(8 /* sizeof(char *) */),
-                                      UpB.CreateIntCast(NewSize, Type::getInt64Ty(C), false));
-    Value *KeysPtr = UpB.CreateStructGEP(BucketType(C), BArg, BucketFieldKeys); // |KeysPtr| : i8***
-    
-    {
-      // |NewKeysPtr| : [|NewSize| x i8*] = i8**
-      Value* ReallocArgs[] = {
-        UpB.CreatePointerCast(UpB.CreateLoad(KeysPtr), Type::getInt8PtrTy(C)), AllocSize };
-      
-      Value * NewKeysPtr = UpB.CreateCall(ReallocF, ReallocArgs);
-      UpB.CreateStore(UpB.CreatePointerCast(NewKeysPtr, Type::getInt8PtrTy(C)->getPointerTo()),
-                      KeysPtr);
-    }
-    
-    // obj * new_values = (obj *)malloc(new_size);
-    // memcpy(new_values, arr->values, size);
-    // arr->values = new_values;
-    Value *ValuesPtr = UpB.CreateStructGEP(BucketType(C), BArg, BucketFieldValues); // |ValuesPtr| : %obj***
+    // i8* @malloc(i64)
+    FunctionType *MallocTy = FunctionType::get(Type::getInt8PtrTy(C),
+                                               ArrayRef<Type *>{ Type::getInt64Ty(C) }, false);
+    Function *MallocF = cast<Function>(M->getOrInsertFunction("malloc", MallocTy));
     
-    {
-      // |NewKeysPtr| : [|NewSize| x %obj*] = %obj**
-      Value* ReallocArgs[] = {
-        UpB.CreatePointerCast(UpB.CreateLoad(ValuesPtr), Type::getInt8PtrTy(C)), AllocSize };
-      Value * NewValuesPtr = UpB.CreateCall(ReallocF, ReallocArgs);
-      
-      UpB.CreateStore(UpB.CreatePointerCast(NewValuesPtr, getObjPtrTy(C)->getPointerTo()),
-                      ValuesPtr);
-    }
-  
-    UpB.CreateRetVoid();
+    // All slots are empty
+    Value *NewCtrl = GB.CreateCall(MallocF, NewCap); // |NewCtrl| : i8*
+    GB.CreateMemSet(NewCtrl, GB.getInt8(kMapCtrlEmpty), NewCap, 1);
+    
+    Value *NewHashes = GB.CreatePointerCast(GB.CreateCall(MallocF, GB.CreateMul(NewCap, GB.getInt64(4 /* sizeof(unsigned) */))),
+                                            Type::getInt32PtrTy(C)); // |NewHashes| : i32*
+    Value *ArraySize = GB.CreateMul(NewCap, GB.getInt64(8 /* sizeof(char *) */));
+    Value *NewKeys = GB.CreatePointerCast(GB.CreateCall(MallocF, ArraySize),
+                                          Type::getInt8PtrTy(C)->getPointerTo()); // |NewKeys| : i8**
+    Value *NewValues = GB.CreatePointerCast(GB.CreateCall(MallocF, ArraySize),
+                                            getObjPtrTy(C)->getPointerTo()); // |NewValues| : %obj**
+    
+    GB.CreateStore(NewCtrl, __MapCtrl);
+    GB.CreateStore(NewHashes, __MapHashes);
+    GB.CreateStore(NewKeys, __MapKeys);
+    GB.CreateStore(NewValues, __MapValues);
+    GB.CreateStore(NewCap, __MapCap);
+    
+    GB.CreateRetVoid();
   }
   
   // Call upsize function
-  B.CreateCall(UpsizeF, BucketPtr);
+  B.CreateCall(UpsizeF, ArrayRef<Value *>{});
 }
 
-// void @insert(i8* %key, %obj* %value)
-void Insert(Value *Key, Value *Val, Module *M, IRBuilder<> &B)
+// void @inserthashed(i8* %key, i32 %hash, %obj* %value)
+void InsertHashed(Value *Key, Value *HashV, Value *Val, Module *M, IRBuilder<> &B)
 {
   /*
-   * void insert(const char * key, const char * value) {
-   *   int h = hash(key);
-   *   struct str_array * arr = &_map[h];
-   *
-   *   if (arr->size > arr->max_size || arr->max_size == 0) {
-   *     upsize(arr);
-   *   }
-   *
-   *   int size = strlen(key) + 1;
-   *   arr->keys[arr->size] = (char *)malloc(size);
-   *   memcpy(arr->keys[arr->size], key, size);
+   * void inserthashed(const char * key, unsigned h, obj * value) {
+   *   if (_map.old.cap)
+   *     migratestep();
    *
-   *   size = strlen(value) + 1;
-   *   arr->values[arr->size] = (char *)malloc(size);
-   *   memcpy(arr->values[arr->size], value, size);
+   *   if ((_map.count + 1) * 8 > _map.cap * kMapMaxLoad) // |count| includes the entries not moved yet
+   *     upsize();
    *
-   *   arr->size++;
+   *   long i = findempty(_map.ctrl, _map.cap, h); // |key| is not into the table yet
+   *   _map.ctrl[i] = h & 0x7F;
+   *   _map.hashes[i] = h;
+   *   _map.keys[i] = key;
+   *   _map.values[i] = value;
+   *   _map.count++;
    * }
    */
   
   LLVMContext &C = M->getContext();
   
-  // void @insert(i8* %key, obj* %value)
-  Function *InsertF = cast<Function>(M->getOrInsertFunction("insert", Type::getVoidTy(C),
+  // void @inserthashed(i8* %key, i32 %hash, obj* %value)
+  Function *InsertF = cast<Function>(M->getOrInsertFunction("inserthashed", Type::getVoidTy(C),
                                                             Type::getInt8PtrTy(C),
+                                                            Type::getInt32Ty(C),
                                                             getObjPtrTy(C),
                                                             (Type *)0));
   if (InsertF->empty()) {
@@ -239,6 +480,9 @@ void Insert(Value *Key, Value *Val, Module *M, IRBuilder<> &B)
     Argument *KArg = it;
     KArg->setName("key");
     
+    Argument *HArg = ++it;
+    HArg->setName("hash");
+    
     Argument *VArg = ++it;
     VArg->setName("value");
     
@@ -246,204 +490,263 @@ void Insert(Value *Key, Value *Val, Module *M, IRBuilder<> &B)
     IRBuilder<> IB(IBB);
     IB.SetInsertPoint(IBB);
     
-    // int h = hash(key);
-    Value *HashV = Hash(KArg, M, IB);
-    HashV->setName("hash");
-    
-    // struct str_array * arr = &_map[h];
-    Value *MapPtr = IB.CreatePointerCast(__Map,
-                                         BucketType(C)->getPointerTo()); // Cast "[11 x %bucket]" to "%bucket*" to compute a correct offset with GEP
-    Value *BucketPtr = IB.CreateGEP(MapPtr, HashV);
+    MigrateStepIfNeeded(M, IB);
     
-    // if (arr->size > arr->max_size || arr->max_size == 0) {
-    //   upsize(arr);
-    // }
-    Value *SizePtr = IB.CreateStructGEP(BucketType(C), BucketPtr, BucketFieldSize);
-    Value *MaxSizePtr = IB.CreateStructGEP(BucketType(C), BucketPtr, BucketFieldMaxSize);
-    
-    Value *Cond1 = IB.CreateICmpSGT(IB.CreateLoad(SizePtr), IB.CreateLoad(MaxSizePtr));
-    Value *Cond2 = IB.CreateICmpEQ(IB.CreateLoad(MaxSizePtr), IB.getInt32(0));
+    // if ((_map.count + 1) * 8 > _map.cap * kMapMaxLoad)
+    //   upsize();
+    Value *NewCount = IB.CreateAdd(IB.CreateLoad(__MapCount), IB.getInt64(1));
+    Value *NeedsGrow = IB.CreateICmpUGT(IB.CreateMul(NewCount, IB.getInt64(8)),
+                                        IB.CreateMul(IB.CreateLoad(__MapCap), IB.getInt64(kMapMaxLoad)));
     
     BasicBlock *UpBB = BasicBlock::Create(C, "UpsizeBlock", InsertF);
-    BasicBlock *MCBB = BasicBlock::Create(C, "MemCpyBlock", InsertF);
-    IB.CreateCondBr(IB.CreateOr(Cond1, Cond2), UpBB, MCBB);
+    BasicBlock *StoreBB = BasicBlock::Create(C, "StoreBlock", InsertF);
+    IB.CreateCondBr(NeedsGrow, UpBB, StoreBB);
     
     /* Upsize block*/
     IRBuilder<> UpB(UpBB);
-    IB.SetInsertPoint(UpBB);
-    
-    Upsize(BucketPtr, M, UpB);
-    UpB.CreateBr(MCBB);
+    Upsize(M, UpB);
+    UpB.CreateBr(StoreBB);
     
-    /* Memcpy block */
-    IRBuilder<> MCB(MCBB);
-    IB.SetInsertPoint(MCBB);
+    /* Store block */
+    IRBuilder<> SB(StoreBB);
     
-    Value *Size = MCB.CreateLoad(SizePtr);
+    Value *Slot = FindEmptySlot(HArg, SB.CreateLoad(__MapCtrl), SB.CreateLoad(__MapCap), M, SB);
+    SB.CreateStore(HashCtrl(HArg, SB), SB.CreateGEP(SB.CreateLoad(__MapCtrl), Slot));
+    SB.CreateStore(HArg, SB.CreateGEP(SB.CreateLoad(__MapHashes), Slot));
+    SB.CreateStore(KArg, SB.CreateGEP(SB.CreateLoad(__MapKeys), Slot));
+    StrRetain(KArg, M, SB); // The table owns its keys
+    SB.CreateStore(VArg, SB.CreateGEP(SB.CreateLoad(__MapValues), Slot));
     
-    // int size = strlen(key) + 1;
-    // arr->keys[arr->size] = (char *)malloc(size);
-    // memcpy(arr->keys[arr->size], key, size);
-    Value *KeysPtr = MCB.CreateStructGEP(BucketType(C), BucketPtr, BucketFieldKeys); // |KeysPtr| : i8***
-    Value *KeyPtr = MCB.CreateGEP(MCB.CreateLoad(KeysPtr), Size); // |KeyPtr| : i8**
-    MCB.CreateStore(KArg, KeyPtr);
+    // _map.count++;
+    SB.CreateStore(NewCount, __MapCount);
     
-    // size = strlen(value) + 1;
-    // arr->values[arr->size] = (%obj *)malloc(size);
-    // memcpy(arr->values[arr->size], value, size);
-    Value *ValuesPtr = MCB.CreateStructGEP(BucketType(C), BucketPtr, BucketFieldValues); // |ValuesPtr| : %obj***
-    Value *ValuePtr = MCB.CreateGEP(MCB.CreateLoad(ValuesPtr), Size); // |ValuePtr| : %obj**
-    MCB.CreateStore(VArg, ValuePtr);
-    
-    // arr->size++;
-    MCB.CreateStore(MCB.CreateAdd(Size, MCB.getInt32(1)),
-                    SizePtr);
-    
-    MCB.CreateRetVoid();
+    SB.CreateRetVoid();
   }
   
   // Call insert function
-  B.CreateCall(InsertF, ArrayRef<Value *>{ Key, Val });
+  B.CreateCall(InsertF, ArrayRef<Value *>{ Key, HashV, Val });
 }
 
-// %obj* @getptr(i8* %key)
-Value * GetPtr(Value *Key, Module *M, IRBuilder<> &B)
+void Insert(Value *Key, Value *Val, Module *M, IRBuilder<> &B)
+{
+  InsertHashed(Key, Hash(Key, M, B), Val, M, B);
+}
+
+// %obj* @lookup(i8* %ctrl, i8** %keys, %obj** %values, i64 %cap, i8* %key, i32 %hash)
+static Value * Lookup(Value *Ctrl, Value *Keys, Value *Values, Value *Cap, Value *Key, Value *HashV,
+                      Module *M, IRBuilder<> &B)
 {
   /*
-   * char ** get(const char * key)
+   * obj * lookup(char * ctrl, char ** keys, obj ** values, long cap, const char * key, unsigned h)
    * {
-   *   int h = hash(key);
-   *   struct str_array * arr = &_map[h];
-   *   int i = 0;
-   *   while(1) {
-   *     if (i>= arr->size)
-   *       break;
+   *   if (cap == 0)
+   *     return NULL;
    *
-   *     char * s = arr->keys[i];
-   *     if (strcmp(s, key) == 0)
-   *       return &arr->values[i];
-   *     i++;
+   *   long group_mask = cap / kMapGroupSize - 1;
+   *   long g = (h >> 7) & group_mask;
+   *   for (long step = 1; ; g = (g + step++) & group_mask) {
+   *     for (unsigned m = match(&ctrl[g * kMapGroupSize], h & 0x7F); m; m &= m - 1) {
+   *       long i = g * kMapGroupSize + ctz(m);
+   *       if (keys[i] == key) // Interned keys
+   *         return values[i];
+   *     }
+   *     if (match(&ctrl[g * kMapGroupSize], kMapCtrlEmpty)) // Inserted into the first empty slot
+   *       return NULL;
    *   }
-   *   return NULL;
    * }
    */
   
   LLVMContext &C = M->getContext();
   
-  // %obj* @getptr(i8* %key)
-  Function *GetF = cast<Function>(M->getOrInsertFunction("getptr", getObjPtrTy(C),
-                                                         Type::getInt8PtrTy(C),
-                                                         (Type *)0));
-  if (GetF->empty()) {
-    Argument *KArg = GetF->arg_begin();
-    KArg->setName("key");
-    
-    BasicBlock *GetBB = BasicBlock::Create(C, "EntryBlock", GetF);
-    IRBuilder<> GetB(GetBB);
-    GetB.SetInsertPoint(GetBB);
-    
-    // int h = hash(key);
-    Value *HashV = Hash(KArg, M, GetB);
-    HashV->setName("hash");
+  Function *LookupF = cast<Function>(M->getOrInsertFunction("lookup", getObjPtrTy(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            Type::getInt8PtrTy(C)->getPointerTo(),
+                                                            getObjPtrTy(C)->getPointerTo(),
+                                                            Type::getInt64Ty(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            Type::getInt32Ty(C),
+                                                            (Type *)0));
+  if (LookupF->empty()) {
+    Function::arg_iterator it = LookupF->arg_begin();
+    Argument *CtrlArg = it;
+    CtrlArg->setName("ctrl");
     
-    // struct str_array * arr = &_map[h];
-    Value *MapPtr = GetB.CreatePointerCast(__Map,
-                                           BucketType(C)->getPointerTo());
-    Value *BucketPtr = GetB.CreateGEP(MapPtr, HashV);
-    Value *SizePtr = GetB.CreateStructGEP(BucketType(C), BucketPtr, BucketFieldSize);
+    Argument *KeysArg = ++it;
+    KeysArg->setName("keys");
     
-    Value *CounterPtr = GetB.CreateAlloca(Type::getInt32Ty(C));
-    CounterPtr->setName("counterPtr");
-    GetB.CreateStore(GetB.getInt32(0), CounterPtr);
+    Argument *ValuesArg = ++it;
+    ValuesArg->setName("values");
     
+    Argument *CapArg = ++it;
+    CapArg->setName("cap");
     
-    BasicBlock *LoopBB = BasicBlock::Create(C, "Loop", GetF);
-    GetB.CreateBr(LoopBB);
+    Argument *KArg = ++it;
+    KArg->setName("key");
     
-    BasicBlock *Loop2BB = BasicBlock::Create(C, "Loop2", GetF);
-    BasicBlock *Loop3BB = BasicBlock::Create(C, "Loop3", GetF);
+    Argument *HArg = ++it;
+    HArg->setName("hash");
     
-    BasicBlock *RetValueBB = BasicBlock::Create(C, "RetValue", GetF);
-    BasicBlock *RetNullBB = BasicBlock::Create(C, "RetNull", GetF);
+    BasicBlock *GetBB = BasicBlock::Create(C, "EntryBlock", LookupF);
+    BasicBlock *HashBB = BasicBlock::Create(C, "HashBlock", LookupF);
+    BasicBlock *GroupBB = BasicBlock::Create(C, "GroupBlock", LookupF);
+    BasicBlock *MatchBB = BasicBlock::Create(C, "MatchBlock", LookupF);
+    BasicBlock *CompareBB = BasicBlock::Create(C, "CompareBlock", LookupF);
+    BasicBlock *NextMatchBB = BasicBlock::Create(C, "NextMatchBlock", LookupF);
+    BasicBlock *EmptyBB = BasicBlock::Create(C, "EmptyBlock", LookupF);
+    BasicBlock *NextGroupBB = BasicBlock::Create(C, "NextGroupBlock", LookupF);
+    BasicBlock *RetValueBB = BasicBlock::Create(C, "RetValue", LookupF);
+    BasicBlock *RetNullBB = BasicBlock::Create(C, "RetNull", LookupF);
     
     /*
-     * Loop:
-     *   br (counter >= size), RetNull, Loop2
+     * GroupBlock:
+     *   br MatchBlock
      *
-     * Loop2:
-     *   br (strcmp(s, key), 0), RetValue, Loop3
+     * MatchBlock: (slots of the group with the same control byte)
+     *   br (m == 0), EmptyBlock, CompareBlock
      *
-     * Loop3:
-     *   counter++
-     *   br Loop
+     * CompareBlock:
+     *   br (s == key), RetValue, NextMatchBlock
      *
-     * RetValue:
-     *   ret value
+     * NextMatchBlock:
+     *   m &= m - 1
+     *   br MatchBlock
+     *
+     * EmptyBlock:
+     *   br (group has an empty slot), RetNull, NextGroupBlock
      *
-     * RetNull:
-     *   ret void
+     * NextGroupBlock:
+     *   g = (g + step++) & group_mask
+     *   br GroupBlock
      */
     
-    /* Loop Block */
-    IRBuilder<> LoopB(LoopBB);
-    GetB.SetInsertPoint(LoopBB);
-    
-    // if (i >= arr->size)
-    //   break;
-    
-    Value *Counter = LoopB.CreateLoad(CounterPtr);
-    Value *Cmp = LoopB.CreateICmpSGE(Counter,
-                                     LoopB.CreateLoad(SizePtr));
-    LoopB.CreateCondBr(Cmp, RetNullBB, Loop2BB);
-    
-    /* Loop2 Block */
-    IRBuilder<> Loop2B(Loop2BB);
-    GetB.SetInsertPoint(Loop2BB);
-    
-    // char * s = arr->keys[i];
-    // if (strcmp(s, key) == 0)
-    //   return arr->values[i];
-    
-    Value *KeysPtr = Loop2B.CreateStructGEP(BucketType(C), BucketPtr, BucketFieldKeys); // |KeysPtr| : i8***
-    Value *KeyPtr = Loop2B.CreateGEP(Loop2B.CreateLoad(KeysPtr),
-                                     Counter); // |KeyPtr| : i8**
-    
-    // i32 @strcmp(i8*, i8*)
-    Type* StrcmpArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-    FunctionType *StrcmpTy = FunctionType::get(Type::getInt32Ty(C), StrcmpArgs, false);
-    Function *StrcmpF = cast<Function>(M->getOrInsertFunction("strcmp", StrcmpTy));
-    
-    Value *Ret = Loop2B.CreateCall(StrcmpF, ArrayRef<Value *>{ Loop2B.CreateLoad(KeyPtr), KArg });
-    Value *Res = Loop2B.CreateICmpEQ(Ret, Loop2B.getInt32(0));
-    Loop2B.CreateCondBr(Res, RetValueBB, Loop3BB);
-    
-    /* Loop3 Block */
-    IRBuilder<> Loop3B(Loop3BB);
-    GetB.SetInsertPoint(Loop3BB);
-    
-    // i++;
-    Value *NewCounter = Loop3B.CreateAdd(Counter,
-                                         Loop3B.getInt32(1));
-    Loop3B.CreateStore(NewCounter, CounterPtr);
-    Loop3B.CreateBr(LoopBB);
-    
-    // return &arr->values[i];
+    IRBuilder<> GetB(GetBB);
+    GetB.CreateCondBr(GetB.CreateICmpEQ(CapArg, GetB.getInt64(0)), RetNullBB, HashBB);
+    
+    /* Hash Block */
+    IRBuilder<> HB(HashBB);
+    Value *CtrlByte = HashCtrl(HArg, HB);
+    Value *GroupMask = HB.CreateSub(HB.CreateUDiv(CapArg, HB.getInt64(kMapGroupSize)), HB.getInt64(1));
+    Value *FirstGroup = HashGroup(HArg, GroupMask, HB);
+    HB.CreateBr(GroupBB);
+    
+    /* Group Block */
+    IRBuilder<> GB(GroupBB);
+    PHINode *Group = GB.CreatePHI(Type::getInt64Ty(C), 2, "group");
+    PHINode *Step = GB.CreatePHI(Type::getInt64Ty(C), 2, "step");
+    Group->addIncoming(FirstGroup, HashBB);
+    Step->addIncoming(GB.getInt64(1), HashBB);
+    Value *Matches = GroupMatch(CtrlArg, Group, CtrlByte, GB);
+    GB.CreateBr(MatchBB);
+    
+    /* Match Block */
+    IRBuilder<> MB(MatchBB);
+    PHINode *Mask = MB.CreatePHI(Matches->getType(), 2, "mask");
+    Mask->addIncoming(Matches, GroupBB);
+    MB.CreateCondBr(MB.CreateIsNull(Mask), EmptyBB, CompareBB);
+    
+    /* Compare Block */
+    IRBuilder<> CB(CompareBB);
+    Value *Slot = GroupSlot(Group, Mask, M, CB);
+    
+    // Keys are interned, same name means same pointer
+    Value *SlotKey = CB.CreateLoad(CB.CreateGEP(KeysArg, Slot));
+    CB.CreateCondBr(CB.CreateICmpEQ(SlotKey, KArg), RetValueBB, NextMatchBB);
+    
+    /* Next Match Block */
+    IRBuilder<> NMB(NextMatchBB);
+    Mask->addIncoming(NMB.CreateAnd(Mask, NMB.CreateSub(Mask, ConstantInt::get(Mask->getType(), 1))),
+                      NextMatchBB);
+    NMB.CreateBr(MatchBB);
+    
+    /* Empty Block */
+    IRBuilder<> EB(EmptyBB);
+    Value *EmptyMask = GroupMatch(CtrlArg, Group, EB.getInt8(kMapCtrlEmpty), EB);
+    EB.CreateCondBr(EB.CreateIsNotNull(EmptyMask), RetNullBB, NextGroupBB);
+    
+    /* Next Group Block */
+    IRBuilder<> NGB(NextGroupBB);
+    Group->addIncoming(NGB.CreateAnd(NGB.CreateAdd(Group, Step), GroupMask), NextGroupBB);
+    Step->addIncoming(NGB.CreateAdd(Step, NGB.getInt64(1)), NextGroupBB);
+    NGB.CreateBr(GroupBB);
+    
+    // return values[i];
     IRBuilder<> RVB(RetValueBB);
-    GetB.SetInsertPoint(RetValueBB);
-    
-    Value *ValuesPtr = RVB.CreateStructGEP(BucketType(C), BucketPtr, BucketFieldValues); // |ValuesPtr| : %obj***
-    Value *ValuePtr = RVB.CreateGEP(RVB.CreateLoad(ValuesPtr),
-                                    Counter); // |ValuePtr| : %obj**
-    RVB.CreateRet(RVB.CreateLoad(ValuePtr));
+    RVB.CreateRet(RVB.CreateLoad(RVB.CreateGEP(ValuesArg, Slot)));
     
     // return (%obj *)NULL;
     IRBuilder<> RNB(RetNullBB);
-    GetB.SetInsertPoint(RetNullBB);
     RNB.CreateRet(ConstantPointerNull::get(getObjPtrTy(C)));
   }
   
+  // Call "lookup" function
+  return B.CreateCall(LookupF, ArrayRef<Value *>{ Ctrl, Keys, Values, Cap, Key, HashV });
+}
+
+// %obj* @getptrhashed(i8* %key, i32 %hash)
+Value * GetPtrHashed(Value *Key, Value *HashV, Module *M, IRBuilder<> &B)
+{
+  /*
+   * obj * getptrhashed(const char * key, unsigned h)
+   * {
+   *   if (_map.old.cap)
+   *     migratestep();
+   *
+   *   obj * value = lookup(_map.ctrl, _map.keys, _map.values, _map.cap, key, h);
+   *   if (!value && _map.old.cap) // Not moved yet
+   *     value = lookup(_map.old.ctrl, _map.old.keys, _map.old.values, _map.old.cap, key, h);
+   *   return value;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  // %obj* @getptrhashed(i8* %key, i32 %hash)
+  Function *GetF = cast<Function>(M->getOrInsertFunction("getptrhashed", getObjPtrTy(C),
+                                                         Type::getInt8PtrTy(C),
+                                                         Type::getInt32Ty(C),
+                                                         (Type *)0));
+  if (GetF->empty()) {
+    Function::arg_iterator it = GetF->arg_begin();
+    Argument *KArg = it;
+    KArg->setName("key");
+    
+    Argument *HArg = ++it;
+    HArg->setName("hash");
+    
+    BasicBlock *GetBB = BasicBlock::Create(C, "EntryBlock", GetF);
+    BasicBlock *OldBB = BasicBlock::Create(C, "OldTableBlock", GetF);
+    BasicBlock *RetBB = BasicBlock::Create(C, "RetValue", GetF);
+    
+    IRBuilder<> GetB(GetBB);
+    MigrateStepIfNeeded(M, GetB);
+    
+    Value *ValPtr = Lookup(GetB.CreateLoad(__MapCtrl), GetB.CreateLoad(__MapKeys), GetB.CreateLoad(__MapValues),
+                           GetB.CreateLoad(__MapCap), KArg, HArg, M, GetB);
+    Value *OldCap = GetB.CreateLoad(__MapOldCap);
+    GetB.CreateCondBr(GetB.CreateAnd(GetB.CreateIsNull(ValPtr), GetB.CreateICmpNE(OldCap, GetB.getInt64(0))),
+                      OldBB, RetBB);
+    BasicBlock *FoundBB = GetB.GetInsertBlock();
+    
+    /* Old Table Block: not moved yet */
+    IRBuilder<> OB(OldBB);
+    Value *OldValPtr = Lookup(OB.CreateLoad(__MapOldCtrl), OB.CreateLoad(__MapOldKeys), OB.CreateLoad(__MapOldValues),
+                              OldCap, KArg, HArg, M, OB);
+    OB.CreateBr(RetBB);
+    
+    IRBuilder<> RB(RetBB);
+    PHINode *RetPtr = RB.CreatePHI(getObjPtrTy(C), 2);
+    RetPtr->addIncoming(ValPtr, FoundBB);
+    RetPtr->addIncoming(OldValPtr, OldBB);
+    RB.CreateRet(RetPtr);
+  }
+  
   // Call getptr function
-  return B.CreateCall(GetF, Key);
+  return B.CreateCall(GetF, ArrayRef<Value *>{ Key, HashV });
+}
+
+Value * GetPtr(Value *Key, Module *M, IRBuilder<> &B)
+{
+  return GetPtrHashed(Key, Hash(Key, M, B), M, B);
 }
 
 // void @update(i8* %key, %obj* val)
@@ -474,7 +777,8 @@ void InsertOrUpdate(Value *Key, Value *Val, Module *M, IRBuilder<> &B)
     IRBuilder<> IUB(IUBB);
     IUB.SetInsertPoint(IUBB);
     
-    Value *ValPtr = GetPtr(KArg, M, IUB); // |ValPtr| : %obj*
+    Value *HashV = Hash(KArg, M, IUB); // Once for both
+    Value *ValPtr = GetPtrHashed(KArg, HashV, M, IUB); // |ValPtr| : %obj*
     
     BasicBlock *InsertBB = BasicBlock::Create(C, "InsertBlock", InsOrUpF);
     BasicBlock *UpdateBB = BasicBlock::Create(C, "UpdateBlock", InsOrUpF);
@@ -488,7 +792,7 @@ void InsertOrUpdate(Value *Key, Value *Val, Module *M, IRBuilder<> &B)
     IRBuilder<> IB(InsertBB);
     IUB.SetInsertPoint(InsertBB);
     
-    Insert(KArg, VArg, M, IB);
+    InsertHashed(KArg, HashV, VArg, M, IB);
     IB.CreateBr(DoneBB);
     
     /* Update block */
@@ -510,23 +814,85 @@ void InsertOrUpdate(Value *Key, Value *Val, Module *M, IRBuilder<> &B)
   B.CreateCall(InsOrUpF, ArrayRef<Value *>{ Key, Val });
 }
 
-// %obj* @getptrorinsert(i8* %key)
-Value * GetPtrOrInsert(Value *Key, Module *M, IRBuilder<> &B)
+/* Allocate a new variable, initialized to zero, from the slab: variables are never freed,
+ * so cells are handed out in first-use order from contiguous blocks (no free list) */
+// %obj* @newvariable()
+static Value * NewVariable(Module *M, IRBuilder<> &B)
 {
+  /*
+   * obj * newvariable() {
+   *   if (_slab.next == _slab.end) {
+   *     _slab.next = (obj *)malloc(kSlabCellCount * sizeof(obj));
+   *     _slab.end = _slab.next + kSlabCellCount;
+   *   }
+   *   obj * cell = _slab.next++;
+   *   cell->word = 0;
+   *   return cell;
+   * }
+   */
+  
   LLVMContext &C = M->getContext();
   
-  Function *GetOrCrF = cast<Function>(M->getOrInsertFunction("getptrorinsert", getObjPtrTy(C),
+  Function *NewVarF = cast<Function>(M->getOrInsertFunction("newvariable", getObjPtrTy(C),
+                                                            (Type *)0));
+  if (NewVarF->empty()) {
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", NewVarF);
+    BasicBlock *RefillBB = BasicBlock::Create(C, "RefillBlock", NewVarF);
+    BasicBlock *CellBB = BasicBlock::Create(C, "CellBlock", NewVarF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *IsFull = EB.CreateICmpEQ(EB.CreateLoad(__SlabNext), EB.CreateLoad(__SlabEnd));
+    EB.CreateCondBr(IsFull, RefillBB, CellBB);
+    
+    /* Refill Block: new block of cells (the previous one is full, its cells stay in use) */
+    IRBuilder<> RB(RefillBB);
+    // i8* @malloc(i64)
+    FunctionType *MallocTy = FunctionType::get(Type::getInt8PtrTy(C),
+                                               ArrayRef<Type *>{ Type::getInt64Ty(C) }, false);
+    Function *MallocF = cast<Function>(M->getOrInsertFunction("malloc", MallocTy));
+    Value *AllocPtr = RB.CreateCall(MallocF,
+                                    RB.getInt64(kSlabCellCount * ObjectTypeSize(C))); // |AllocPtr| : i8*
+    Value *BlockPtr = RB.CreatePointerCast(AllocPtr, getObjPtrTy(C)); // |BlockPtr| : %obj*
+    RB.CreateStore(BlockPtr, __SlabNext);
+    RB.CreateStore(RB.CreateGEP(BlockPtr, RB.getInt64(kSlabCellCount)), __SlabEnd);
+    RB.CreateBr(CellBB);
+    
+    /* Cell Block */
+    IRBuilder<> CB(CellBB);
+    Value *NewPtr = CB.CreateLoad(__SlabNext); // |NewPtr| : %obj*
+    CB.CreateStore(CB.CreateGEP(NewPtr, CB.getInt64(1)), __SlabNext);
+    
+    // Init variable to zero
+    StoreObjWord(Int64ToWord(CB.getInt64(0), CB), NewPtr, CB);
+    CB.CreateRet(NewPtr);
+  }
+  
+  // Call "newvariable" function
+  return B.CreateCall(NewVarF, ArrayRef<Value *>{});
+}
+
+// %obj* @getptrorinserthashed(i8* %key, i32 %hash)
+Value * GetPtrOrInsertHashed(Value *Key, Value *HashV, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *GetOrCrF = cast<Function>(M->getOrInsertFunction("getptrorinserthashed", getObjPtrTy(C),
                                                              Type::getInt8PtrTy(C),
+                                                             Type::getInt32Ty(C),
                                                              (Type *)0));
   if (GetOrCrF->empty()) {
-    Argument *KArg = GetOrCrF->arg_begin();
+    Function::arg_iterator it = GetOrCrF->arg_begin();
+    Argument *KArg = it;
     KArg->setName("key");
     
+    Argument *HArg = ++it;
+    HArg->setName("hash");
+    
     BasicBlock *GCBB = BasicBlock::Create(C, "EntryBlock", GetOrCrF);
     IRBuilder<> GCB(GCBB);
     GCB.SetInsertPoint(GCBB);
     
-    Value *ValPtr = GetPtr(KArg, M, GCB); // |ValPtr| : %obj*
+    Value *ValPtr = GetPtrHashed(KArg, HArg, M, GCB); // |ValPtr| : %obj*
     
     BasicBlock *GetPtrBB = BasicBlock::Create(C, "GetPtrBlock", GetOrCrF);
     BasicBlock *InsertBB = BasicBlock::Create(C, "InsertBlock", GetOrCrF);
@@ -545,26 +911,499 @@ Value * GetPtrOrInsert(Value *Key, Module *M, IRBuilder<> &B)
     IRBuilder<> InsB(InsertBB);
     InsB.SetInsertPoint(InsertBB);
     
+    Value *NewPtr = NewVariable(M, InsB); // |NewPtr| : %obj*
+    InsertHashed(KArg, HArg, NewPtr, M, InsB);
+    
+    InsB.CreateRet(NewPtr);
+    
+    // @TODO: Use a "phi" for |ValPtr|/|NewPtr|
+  }
+  
+  // Call "getptrorcreate" function
+  return B.CreateCall(GetOrCrF, ArrayRef<Value *>{ Key, HashV });
+}
+
+Value * GetPtrOrInsert(Value *Key, Module *M, IRBuilder<> &B)
+{
+  return GetPtrOrInsertHashed(Key, Hash(Key, M, B), M, B);
+}
+
+/* Slot of |Key| into the sparse part of the integer table (Fibonacci hashing) */
+static Value * IntSlot(Value *Key, Value *Mask, IRBuilder<> &B)
+{
+  Value *Mul = B.CreateMul(Key, B.getInt64(0x9E3779B97F4A7C15ULL));
+  return B.CreateAnd(B.CreateLShr(Mul, 29), Mask);
+}
+
+// void @intmapgrow()
+static void IntMapGrow(Module *M, IRBuilder<> &B)
+{
+  /*
+   * void intmapgrow() {
+   *   long cap = (_intmap_cap) ? _intmap_cap * 2 : kIntMapSparseMinSize;
+   *   long * keys = (long *)malloc(cap * sizeof(long));
+   *   obj ** values = (obj **)calloc(cap, sizeof(obj *));
+   *   for (long i = 0; i < _intmap_cap; i++) {
+   *     if (!_intmap_values[i]) continue;
+   *     long j = slot(_intmap_keys[i], cap - 1);
+   *     while (values[j]) j = (j + 1) & (cap - 1);
+   *     keys[j] = _intmap_keys[i]; values[j] = _intmap_values[i];
+   *   }
+   *   free(_intmap_keys); free(_intmap_values);
+   *   _intmap_keys = keys; _intmap_values = values; _intmap_cap = cap;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *GrowF = cast<Function>(M->getOrInsertFunction("intmapgrow", Type::getVoidTy(C),
+                                                          (Type *)0));
+  if (GrowF->empty()) {
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", GrowF);
+    IRBuilder<> EB(EntryBB);
+    
+    Value *OldCap = EB.CreateLoad(__IntMapCap);
+    Value *OldKeys = EB.CreateLoad(__IntMapKeys);
+    Value *OldValues = EB.CreateLoad(__IntMapValues);
+    Value *IsEmpty = EB.CreateICmpEQ(OldCap, EB.getInt64(0));
+    Value *NewCap = EB.CreateSelect(IsEmpty,
+                                    EB.getInt64(kIntMapSparseMinSize),
+                                    EB.CreateMul(OldCap, EB.getInt64(2)), "newCap");
+    Value *NewMask = EB.CreateSub(NewCap, EB.getInt64(1));
+    
     // i8* @malloc(i64)
     FunctionType *MallocTy = FunctionType::get(Type::getInt8PtrTy(C),
                                                ArrayRef<Type *>{ Type::getInt64Ty(C) }, false);
     Function *MallocF = cast<Function>(M->getOrInsertFunction("malloc", MallocTy));
-    Value *AllocPtr = InsB.CreateCall(MallocF,
-                                      InsB.getInt64(ObjectTypeSize(C))); // |AllocPtr| : i8*
-    Value *NewPtr = InsB.CreatePointerCast(AllocPtr, getObjPtrTy(C)); // |NewPtr| : %obj*
     
-    // Init variable to zero
-    InsB.CreateStore(InsB.getInt64(0),
-                     InsB.CreateStructGEP(getObjTy(C), NewPtr, ObjectFieldData));
-    InsB.CreateStore(InsB.getInt1(ObjectTypeInteger),
-                     InsB.CreateStructGEP(getObjTy(C), NewPtr, ObjectFieldType));
-    Insert(KArg, NewPtr, M, InsB);
+    // i8* @calloc(i64, i64)
+    Type* CallocArgs[] = { Type::getInt64Ty(C), Type::getInt64Ty(C) };
+    FunctionType *CallocTy = FunctionType::get(Type::getInt8PtrTy(C), CallocArgs, false);
+    Function *CallocF = cast<Function>(M->getOrInsertFunction("calloc", CallocTy));
+    
+    // void @free(i8*)
+    FunctionType *FreeTy = FunctionType::get(Type::getVoidTy(C),
+                                             ArrayRef<Type *>{ Type::getInt8PtrTy(C) }, false);
+    Function *FreeF = cast<Function>(M->getOrInsertFunction("free", FreeTy));
+    
+    Value *NewKeys = EB.CreatePointerCast(EB.CreateCall(MallocF, EB.CreateMul(NewCap, EB.getInt64(8 /* sizeof(long) */))),
+                                          Type::getInt64PtrTy(C));
+    Value *NewValues = EB.CreatePointerCast(EB.CreateCall(CallocF, ArrayRef<Value *>{ NewCap, EB.getInt64(8 /* sizeof(obj *) */) }),
+                                            getObjPtrTy(C)->getPointerTo());
+    
+    BasicBlock *LoopBB = BasicBlock::Create(C, "Loop", GrowF);
+    BasicBlock *MoveBB = BasicBlock::Create(C, "MoveBlock", GrowF);
+    BasicBlock *ProbeBB = BasicBlock::Create(C, "ProbeBlock", GrowF);
+    BasicBlock *StoreBB = BasicBlock::Create(C, "StoreBlock", GrowF);
+    BasicBlock *NextBB = BasicBlock::Create(C, "NextBlock", GrowF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", GrowF);
+    EB.CreateBr(LoopBB);
+    
+    /* Loop block: for (i = 0; i < old_cap; i++) */
+    IRBuilder<> LoopB(LoopBB);
+    PHINode *Counter = LoopB.CreatePHI(Type::getInt64Ty(C), 2, "counter");
+    Counter->addIncoming(LoopB.getInt64(0), EntryBB);
+    LoopB.CreateCondBr(LoopB.CreateICmpULT(Counter, OldCap), MoveBB, DoneBB);
+    
+    /* Move block: skip empty slots */
+    IRBuilder<> MoveB(MoveBB);
+    Value *Val = MoveB.CreateLoad(MoveB.CreateGEP(OldValues, Counter));
+    Value *Key = MoveB.CreateLoad(MoveB.CreateGEP(OldKeys, Counter));
+    Value *FirstSlot = IntSlot(Key, NewMask, MoveB);
+    MoveB.CreateCondBr(MoveB.CreateIsNull(Val), NextBB, ProbeBB);
+    
+    /* Probe block: linear probing for an empty slot */
+    IRBuilder<> ProbeB(ProbeBB);
+    PHINode *Slot = ProbeB.CreatePHI(Type::getInt64Ty(C), 2, "slot");
+    Slot->addIncoming(FirstSlot, MoveBB);
+    Value *SlotValPtr = ProbeB.CreateGEP(NewValues, Slot);
+    Value *NextSlot = ProbeB.CreateAnd(ProbeB.CreateAdd(Slot, ProbeB.getInt64(1)), NewMask);
+    Slot->addIncoming(NextSlot, ProbeBB);
+    ProbeB.CreateCondBr(ProbeB.CreateIsNull(ProbeB.CreateLoad(SlotValPtr)), StoreBB, ProbeBB);
+    
+    /* Store block */
+    IRBuilder<> StoreB(StoreBB);
+    StoreB.CreateStore(Key, StoreB.CreateGEP(NewKeys, Slot));
+    StoreB.CreateStore(Val, SlotValPtr);
+    StoreB.CreateBr(NextBB);
+    
+    /* Next block */
+    IRBuilder<> NextB(NextBB);
+    Value *NextCounter = NextB.CreateAdd(Counter, NextB.getInt64(1));
+    Counter->addIncoming(NextCounter, NextBB);
+    NextB.CreateBr(LoopBB);
     
-    InsB.CreateRet(NewPtr);
+    /* Done block */
+    IRBuilder<> DoneB(DoneBB);
+    DoneB.CreateCall(FreeF, DoneB.CreatePointerCast(OldKeys, Type::getInt8PtrTy(C)));
+    DoneB.CreateCall(FreeF, DoneB.CreatePointerCast(OldValues, Type::getInt8PtrTy(C)));
+    DoneB.CreateStore(NewKeys, __IntMapKeys);
+    DoneB.CreateStore(NewValues, __IntMapValues);
+    DoneB.CreateStore(NewCap, __IntMapCap);
+    DoneB.CreateRetVoid();
+  }
+  
+  // Call "intmapgrow" function
+  B.CreateCall(GrowF, ArrayRef<Value *>{});
+}
+
+// %obj* @getptrorinsertint(i64 %key)
+Value * GetPtrOrInsertInt(Value *Key, Module *M, IRBuilder<> &B)
+{
+  /*
+   * obj * getptrorinsertint(long key) {
+   *   if ((unsigned long)key < _intmap_densecap && _intmap_dense[key])
+   *     return _intmap_dense[key];
+   *
+   *   long mask = _intmap_cap - 1;
+   *   for (long i = slot(key, mask); _intmap_cap && _intmap_values[i]; i = (i + 1) & mask) {
+   *     if (_intmap_keys[i] == key)
+   *       return _intmap_values[i];
+   *   }
+   *
+   *   obj * value = newvariable();
+   *   if ((unsigned long)key < _intmap_densecap) {
+   *     _intmap_dense[key] = value;
+   *   } else if ((unsigned long)key < min(_intmap_densecap * 2 + kIntMapDenseMinSize, kIntMapDenseMaxSize)) {
+   *     long cap = _intmap_densecap * 2 + kIntMapDenseMinSize;
+   *     _intmap_dense = realloc(_intmap_dense, cap * sizeof(obj *));
+   *     memset(_intmap_dense + _intmap_densecap, 0, (cap - _intmap_densecap) * sizeof(obj *));
+   *     _intmap_densecap = cap;
+   *     _intmap_dense[key] = value;
+   *   } else {
+   *     if ((_intmap_count + 1) * 2 > _intmap_cap) intmapgrow();
+   *     long i = slot(key, _intmap_cap - 1);
+   *     while (_intmap_values[i]) i = (i + 1) & (_intmap_cap - 1);
+   *     _intmap_keys[i] = key; _intmap_values[i] = value;
+   *     _intmap_count++;
+   *   }
+   *   return value;
+   * }
+   *
+   * Note: a key into the dense range can still be found into the sparse part
+   *   (inserted before the dense part grew), so both parts are checked before inserting.
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *GetIntF = cast<Function>(M->getOrInsertFunction("getptrorinsertint", getObjPtrTy(C),
+                                                            Type::getInt64Ty(C),
+                                                            (Type *)0));
+  if (GetIntF->empty()) {
+    Argument *KArg = GetIntF->arg_begin();
+    KArg->setName("key");
     
-    // @TODO: Use a "phi" for |ValPtr|/|NewPtr|
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", GetIntF);
+    BasicBlock *DenseBB = BasicBlock::Create(C, "DenseBlock", GetIntF);
+    BasicBlock *RetDenseBB = BasicBlock::Create(C, "RetDense", GetIntF);
+    BasicBlock *SparseBB = BasicBlock::Create(C, "SparseBlock", GetIntF);
+    BasicBlock *ProbeBB = BasicBlock::Create(C, "ProbeBlock", GetIntF);
+    BasicBlock *CompareBB = BasicBlock::Create(C, "CompareBlock", GetIntF);
+    BasicBlock *RetSparseBB = BasicBlock::Create(C, "RetSparse", GetIntF);
+    BasicBlock *InsertBB = BasicBlock::Create(C, "InsertBlock", GetIntF);
+    BasicBlock *InsertDenseBB = BasicBlock::Create(C, "InsertDenseBlock", GetIntF);
+    BasicBlock *CheckGrowBB = BasicBlock::Create(C, "CheckGrowBlock", GetIntF);
+    BasicBlock *GrowDenseBB = BasicBlock::Create(C, "GrowDenseBlock", GetIntF);
+    BasicBlock *InsertSparseBB = BasicBlock::Create(C, "InsertSparseBlock", GetIntF);
+    BasicBlock *GrowSparseBB = BasicBlock::Create(C, "GrowSparseBlock", GetIntF);
+    BasicBlock *FindSlotBB = BasicBlock::Create(C, "FindSlotBlock", GetIntF);
+    BasicBlock *SlotProbeBB = BasicBlock::Create(C, "SlotProbeBlock", GetIntF);
+    BasicBlock *SlotStoreBB = BasicBlock::Create(C, "SlotStoreBlock", GetIntF);
+    
+    /* Entry block */
+    IRBuilder<> EB(EntryBB);
+    Value *DenseCap = EB.CreateLoad(__IntMapDenseCap);
+    Value *InDense = EB.CreateICmpULT(KArg, DenseCap); // Negative keys are never dense
+    EB.CreateCondBr(InDense, DenseBB, SparseBB);
+    
+    /* Dense block */
+    IRBuilder<> DB(DenseBB);
+    Value *DenseVal = DB.CreateLoad(DB.CreateGEP(DB.CreateLoad(__IntMapDense), KArg));
+    DB.CreateCondBr(DB.CreateIsNotNull(DenseVal), RetDenseBB, SparseBB);
+    
+    IRBuilder<> RDB(RetDenseBB);
+    RDB.CreateRet(DenseVal);
+    
+    /* Sparse block */
+    IRBuilder<> SB(SparseBB);
+    Value *Cap = SB.CreateLoad(__IntMapCap);
+    Value *Mask = SB.CreateSub(Cap, SB.getInt64(1));
+    Value *Keys = SB.CreateLoad(__IntMapKeys);
+    Value *Values = SB.CreateLoad(__IntMapValues);
+    Value *FirstSlot = IntSlot(KArg, Mask, SB);
+    SB.CreateCondBr(SB.CreateICmpEQ(Cap, SB.getInt64(0)), InsertBB, ProbeBB);
+    
+    /* Probe block: stop on the first empty slot */
+    IRBuilder<> PB(ProbeBB);
+    PHINode *Slot = PB.CreatePHI(Type::getInt64Ty(C), 2, "slot");
+    Slot->addIncoming(FirstSlot, SparseBB);
+    Value *SlotVal = PB.CreateLoad(PB.CreateGEP(Values, Slot));
+    PB.CreateCondBr(PB.CreateIsNull(SlotVal), InsertBB, CompareBB);
+    
+    /* Compare block */
+    IRBuilder<> CB(CompareBB);
+    Value *SlotKey = CB.CreateLoad(CB.CreateGEP(Keys, Slot));
+    Slot->addIncoming(CB.CreateAnd(CB.CreateAdd(Slot, CB.getInt64(1)), Mask), CompareBB);
+    CB.CreateCondBr(CB.CreateICmpEQ(SlotKey, KArg), RetSparseBB, ProbeBB);
+    
+    IRBuilder<> RSB(RetSparseBB);
+    RSB.CreateRet(SlotVal);
+    
+    /* Insert block */
+    IRBuilder<> IB(InsertBB);
+    IB.SetInsertPoint(InsertBB);
+    Value *NewPtr = NewVariable(M, IB);
+    IB.CreateCondBr(InDense, InsertDenseBB, CheckGrowBB);
+    
+    IRBuilder<> IDB(InsertDenseBB);
+    IDB.CreateStore(NewPtr, IDB.CreateGEP(IDB.CreateLoad(__IntMapDense), KArg));
+    IDB.CreateRet(NewPtr);
+    
+    /* Check grow block: grow the dense part if |key| is close to its end */
+    IRBuilder<> CGB(CheckGrowBB);
+    Value *NewDenseCap = CGB.CreateAdd(CGB.CreateMul(DenseCap, CGB.getInt64(2)),
+                                       CGB.getInt64(kIntMapDenseMinSize), "newDenseCap");
+    Value *CanGrow = CGB.CreateAnd(CGB.CreateICmpULT(KArg, NewDenseCap),
+                                   CGB.CreateICmpULT(KArg, CGB.getInt64(kIntMapDenseMaxSize)));
+    CGB.CreateCondBr(CanGrow, GrowDenseBB, InsertSparseBB);
+    
+    /* Grow dense block */
+    IRBuilder<> GDB(GrowDenseBB);
+    
+    // i8* @realloc(i8*, i64)
+    Type* ReallocArgs[] = { Type::getInt8PtrTy(C), Type::getInt64Ty(C) };
+    FunctionType *ReallocTy = FunctionType::get(Type::getInt8PtrTy(C), ReallocArgs, false);
+    Function *ReallocF = cast<Function>(M->getOrInsertFunction("realloc", ReallocTy));
+    
+    Value* ReallocParams[] = {
+      GDB.CreatePointerCast(GDB.CreateLoad(__IntMapDense), Type::getInt8PtrTy(C)),
+      GDB.CreateMul(NewDenseCap, GDB.getInt64(8 /* sizeof(obj *) */)) };
+    Value *NewDense = GDB.CreateCall(ReallocF, ReallocParams); // |NewDense| : i8*
+    
+    // Clear the new part (empty slots)
+    Value *NewPart = GDB.CreateGEP(NewDense, GDB.CreateMul(DenseCap, GDB.getInt64(8)));
+    GDB.CreateMemSet(NewPart, GDB.getInt8(0),
+                     GDB.CreateMul(GDB.CreateSub(NewDenseCap, DenseCap), GDB.getInt64(8)), 8);
+    
+    Value *NewDensePtr = GDB.CreatePointerCast(NewDense, getObjPtrTy(C)->getPointerTo());
+    GDB.CreateStore(NewDensePtr, __IntMapDense);
+    GDB.CreateStore(NewDenseCap, __IntMapDenseCap);
+    GDB.CreateStore(NewPtr, GDB.CreateGEP(NewDensePtr, KArg));
+    GDB.CreateRet(NewPtr);
+    
+    /* Insert sparse block: keep the load factor under 1/2 */
+    IRBuilder<> ISB(InsertSparseBB);
+    Value *Count = ISB.CreateLoad(__IntMapCount);
+    Value *NewCount = ISB.CreateAdd(Count, ISB.getInt64(1));
+    Value *NeedsGrow = ISB.CreateICmpUGT(ISB.CreateMul(NewCount, ISB.getInt64(2)),
+                                         ISB.CreateLoad(__IntMapCap));
+    ISB.CreateCondBr(NeedsGrow, GrowSparseBB, FindSlotBB);
+    
+    IRBuilder<> GSB(GrowSparseBB);
+    GSB.SetInsertPoint(GrowSparseBB);
+    IntMapGrow(M, GSB);
+    GSB.CreateBr(FindSlotBB);
+    
+    /* Find slot block */
+    IRBuilder<> FSB(FindSlotBB);
+    Value *CurMask = FSB.CreateSub(FSB.CreateLoad(__IntMapCap), FSB.getInt64(1));
+    Value *CurValues = FSB.CreateLoad(__IntMapValues);
+    Value *InsertSlot = IntSlot(KArg, CurMask, FSB);
+    FSB.CreateBr(SlotProbeBB);
+    
+    IRBuilder<> SPB(SlotProbeBB);
+    PHINode *FreeSlot = SPB.CreatePHI(Type::getInt64Ty(C), 2, "freeSlot");
+    FreeSlot->addIncoming(InsertSlot, FindSlotBB);
+    Value *FreeSlotValPtr = SPB.CreateGEP(CurValues, FreeSlot);
+    FreeSlot->addIncoming(SPB.CreateAnd(SPB.CreateAdd(FreeSlot, SPB.getInt64(1)), CurMask), SlotProbeBB);
+    SPB.CreateCondBr(SPB.CreateIsNull(SPB.CreateLoad(FreeSlotValPtr)), SlotStoreBB, SlotProbeBB);
+    
+    IRBuilder<> SSB(SlotStoreBB);
+    SSB.CreateStore(KArg, SSB.CreateGEP(SSB.CreateLoad(__IntMapKeys), FreeSlot));
+    SSB.CreateStore(NewPtr, FreeSlotValPtr);
+    SSB.CreateStore(NewCount, __IntMapCount);
+    SSB.CreateRet(NewPtr);
   }
   
-  // Call "getptrorcreate" function
-  return B.CreateCall(GetOrCrF, Key);
+  // Call "getptrorinsertint" function
+  return B.CreateCall(GetIntF, Key);
+}
+
+// %obj* @getptrorinsertcached(%obj* %name, %icache* %cache)
+Value * GetPtrOrInsertCached(Value *NameObj, Module *M, IRBuilder<> &B)
+{
+  /*
+   * obj * getptrorinsertcached(obj * name, struct icache * cache) {
+   *   for (int i = 0; i < kInlineCacheSize; i++) {
+   *     struct icentry * e = &cache->entries[i];
+   *     if (e->generation == _map_generation) {
+   *       if (e->word == name->word) // Same integer (or same string pointer)
+   *         return e->value;
+   *       if (is_string(e->word) && is_string(name->word) && strcmp(e->key, str(name->word)) == 0)
+   *         return e->value;
+   *     }
+   *   }
+   *
+   *   char * str = otos(name);
+   *   char * key = intern(str); // Never freed, kept by the entry
+   *   strrelease(str);
+   *   long i;
+   *   obj * value = (strtointkey(key, &i)) ? getptrorinsertint(i) : getptrorinsert(key);
+   *
+   *   struct icentry * e = &cache->entries[cache->next];
+   *   e->generation = _map_generation;
+   *   e->word = is_heap_string(name->word) ? word(key) : name->word; // |key| can be a copy (see "intern")
+   *   e->key = key; e->value = value;
+   *   cache->next = (cache->next + 1) & (kInlineCacheSize - 1);
+   *   return value;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *GetCachedF = cast<Function>(M->getOrInsertFunction("getptrorinsertcached", getObjPtrTy(C),
+                                                               getObjPtrTy(C),
+                                                               InlineCacheType(C)->getPointerTo(),
+                                                               (Type *)0));
+  if (GetCachedF->empty()) {
+    Function::arg_iterator it = GetCachedF->arg_begin();
+    Argument *NArg = it;
+    NArg->setName("name");
+    
+    Argument *CArg = ++it;
+    CArg->setName("cache");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", GetCachedF);
+    IRBuilder<> EB(EntryBB);
+    EB.SetInsertPoint(EntryBB);
+    
+    Value *WordV = LoadObjWord(NArg, EB);
+    Value *IsStr = WordIsString(WordV, EB);
+    Value *Generation = EB.CreateLoad(__MapGeneration);
+    Generation->setName("generation");
+    
+    Value *EntriesPtr = EB.CreateStructGEP(InlineCacheType(C), CArg, InlineCacheFieldEntries);
+    Type *EntriesTy = ArrayType::get(InlineCacheEntryType(C), kInlineCacheSize);
+    
+    // i32 @strcmp(i8*, i8*)
+    Type* StrcmpArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
+    FunctionType *StrcmpTy = FunctionType::get(Type::getInt32Ty(C), StrcmpArgs, false);
+    Function *StrcmpF = cast<Function>(M->getOrInsertFunction("strcmp", StrcmpTy));
+    
+    BasicBlock *MissBB = BasicBlock::Create(C, "MissBlock", GetCachedF);
+    BasicBlock *ProbeBB = BasicBlock::Create(C, "ProbeBlock", GetCachedF);
+    EB.CreateBr(ProbeBB);
+    
+    /*
+     * ProbeBlock (for each entry, unrolled):
+     *   br (generation match), CompareBlock, [next ProbeBlock | MissBlock]
+     *
+     * CompareBlock:
+     *   br (same word), HitBlock, CompareStringBlock
+     *
+     * CompareStringBlock:
+     *   br (both strings and same key), HitBlock, [next ProbeBlock | MissBlock]
+     *
+     * HitBlock:
+     *   ret value
+     */
+    for (int i = 0; i < kInlineCacheSize; i++) {
+      BasicBlock *NextBB = (i + 1 < kInlineCacheSize) ? BasicBlock::Create(C, "ProbeBlock", GetCachedF) : MissBB;
+      BasicBlock *CompareBB = BasicBlock::Create(C, "CompareBlock", GetCachedF);
+      BasicBlock *CompareStrBB = BasicBlock::Create(C, "CompareStringBlock", GetCachedF);
+      BasicBlock *HitBB = BasicBlock::Create(C, "HitBlock", GetCachedF);
+      
+      /* Probe block */
+      IRBuilder<> PB(ProbeBB);
+      
+      Value *EntryPtr = PB.CreateConstGEP2_32(EntriesTy, EntriesPtr, 0, i);
+      Value *EntryGen = PB.CreateLoad(PB.CreateStructGEP(InlineCacheEntryType(C), EntryPtr, ICEntryFieldGeneration));
+      PB.CreateCondBr(PB.CreateICmpEQ(EntryGen, Generation), CompareBB, NextBB);
+      
+      /* Compare block */
+      IRBuilder<> CB(CompareBB);
+      Value *EntryWord = CB.CreateLoad(CB.CreateStructGEP(InlineCacheEntryType(C), EntryPtr, ICEntryFieldWord));
+      CB.CreateCondBr(CB.CreateICmpEQ(EntryWord, WordV), HitBB, CompareStrBB);
+      
+      /* Compare string block */
+      IRBuilder<> CSB(CompareStrBB);
+      BasicBlock *StrcmpBB = BasicBlock::Create(C, "StrcmpBlock", GetCachedF);
+      CSB.CreateCondBr(CSB.CreateAnd(IsStr, WordIsString(EntryWord, CSB)), StrcmpBB, NextBB);
+      
+      CSB.SetInsertPoint(StrcmpBB);
+      Value *EntryKey = CSB.CreateLoad(CSB.CreateStructGEP(InlineCacheEntryType(C), EntryPtr, ICEntryFieldKey));
+      Value *Ret = CSB.CreateCall(StrcmpF, ArrayRef<Value *>{ EntryKey, WordToStr(WordV, CSB) });
+      CSB.CreateCondBr(CSB.CreateICmpEQ(Ret, CSB.getInt32(0)), HitBB, NextBB);
+      
+      /* Hit block */
+      IRBuilder<> HB(HitBB);
+      HB.CreateRet(HB.CreateLoad(HB.CreateStructGEP(InlineCacheEntryType(C), EntryPtr, ICEntryFieldValue)));
+      
+      ProbeBB = NextBB;
+    }
+    
+    /* Miss block */
+    IRBuilder<> MB(MissBB);
+    MB.SetInsertPoint(MissBB);
+    
+    // char * str = otos(name);
+    // char * key = intern(str);
+    // long i;
+    // obj * value = (strtointkey(key, &i)) ? getptrorinsertint(i) : getptrorinsert(key);
+    Value *StrV = ObjToStr(NArg, M, MB);
+    Value *KeyV = Intern(StrV, M, MB);
+    StrRelease(StrV, M, MB); // Nothing if taken by the intern table
+    Value *IntKeyPtr = MB.CreateAlloca(Type::getInt64Ty(C));
+    IntKeyPtr->setName("intKeyPtr");
+    Value *IsIntKey = StrToIntKey(KeyV, IntKeyPtr, M, MB);
+    
+    BasicBlock *IntKeyBB = BasicBlock::Create(C, "IntegerKeyBlock", GetCachedF);
+    BasicBlock *StrKeyBB = BasicBlock::Create(C, "StringKeyBlock", GetCachedF);
+    BasicBlock *FillBB = BasicBlock::Create(C, "FillBlock", GetCachedF);
+    MB.CreateCondBr(IsIntKey, IntKeyBB, StrKeyBB);
+    
+    IRBuilder<> IKB(IntKeyBB);
+    Value *IntValPtr = GetPtrOrInsertInt(IKB.CreateLoad(IntKeyPtr), M, IKB);
+    IKB.CreateBr(FillBB);
+    
+    IRBuilder<> SKB(StrKeyBB);
+    Value *StrValPtr = GetPtrOrInsert(KeyV, M, SKB);
+    SKB.CreateBr(FillBB);
+    
+    MB.SetInsertPoint(FillBB);
+    PHINode *ValPtr = MB.CreatePHI(getObjPtrTy(C), 2); // |ValPtr| : %obj*
+    ValPtr->addIncoming(IntValPtr, IntKeyBB);
+    ValPtr->addIncoming(StrValPtr, StrKeyBB);
+    
+    // struct icentry * e = &cache->entries[cache->next];
+    Value *NextPtr = MB.CreateStructGEP(InlineCacheType(C), CArg, InlineCacheFieldNext);
+    Value *Slot = MB.CreateLoad(NextPtr);
+    Value *EntryPtr = MB.CreateGEP(EntriesPtr, ArrayRef<Value *>{ MB.getInt32(0), Slot });
+    
+    Value *EntryKeyPtr = MB.CreateStructGEP(InlineCacheEntryType(C), EntryPtr, ICEntryFieldKey);
+    MB.CreateStore(Generation,
+                   MB.CreateStructGEP(InlineCacheEntryType(C), EntryPtr, ICEntryFieldGeneration));
+    Value *IsHeapStr = MB.CreateAnd(IsStr, MB.CreateNot(WordIsInlineStr(WordV, MB)));
+    MB.CreateStore(MB.CreateSelect(IsHeapStr, StrToWord(KeyV, MB), WordV),
+                   MB.CreateStructGEP(InlineCacheEntryType(C), EntryPtr, ICEntryFieldWord));
+    MB.CreateStore(KeyV, EntryKeyPtr);
+    MB.CreateStore(ValPtr,
+                   MB.CreateStructGEP(InlineCacheEntryType(C), EntryPtr, ICEntryFieldValue));
+    
+    // cache->next = (cache->next + 1) & (kInlineCacheSize - 1);
+    MB.CreateStore(MB.CreateAnd(MB.CreateAdd(Slot, MB.getInt32(1)),
+                                MB.getInt32(kInlineCacheSize - 1)),
+                   NextPtr);
+    
+    MB.CreateRet(ValPtr);
+  }
+  
+  // One cache per call site (zero-initialized: all entries are empty)
+  GlobalVariable *CacheV = new GlobalVariable(*M, InlineCacheType(C), false /* non-constant */,
+                                              GlobalValue::InternalLinkage,
+                                              ConstantAggregateZero::get(InlineCacheType(C)),
+                                              "namedvar.cache");
+  
+  // Call "getptrorinsertcached" function
+  return B.CreateCall(GetCachedF, ArrayRef<Value *>{ NameObj, CacheV });
 }
@@ -2,6 +2,7 @@
 #define SMIL_HASH_H
 
 #include "llvm/Transforms/Utils/BuildLibCalls.h"
+#include "llvm/IR/Intrinsics.h" // For cttz
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
@@ -12,26 +13,60 @@
 using namespace std;
 using namespace llvm;
 
-#define kBucketCount       11
-#define kBucketDefaultSize 10
+/*
+ * Variables named by strings live into an open-addressed table (power of two capacity, by groups
+ * of kMapGroupSize slots). Each slot has a control byte, kMapCtrlEmpty or the low 7 bits of the
+ * hash of its key, the control bytes of a group are compared at once with the key's one (vector)
+ * so keys are only compared for these candidates. Keys are never removed (no tombstone).
+ * The full hash of each key is kept (rehashed on growth without reading the keys).
+ *   i8 ctrl[cap]; unsigned hashes[cap]; char * keys[cap]; obj * values[cap]; long cap; long count;
+ * On growth the previous arrays are kept, and kMapMigrateStep of their slots are moved into the
+ * new ones by each following lookup or insert (missing keys are also looked up there until drained).
+ */
+#define kMapGroupSize 16 // Slots probed at once (SIMD compare of their control bytes)
+#define kMapMinSize 16 // Minimum capacity (power of two, at least kMapGroupSize)
+#define kMapMaxLoad 7 // Maximum load factor, in eighths (grows by doubling above)
+#define kMapCtrlEmpty 0x80 // Control byte of an empty slot
+#define kMapMigrateStep 32 // Slots of the previous table moved by each lookup or insert while growing
 
-enum BucketField {
-  BucketFieldKeys = 0, // Array of string (char *)
-  BucketFieldValues, // Array of obj*
-  BucketFieldSize, // Number of item in array (integer)
-  BucketFieldMaxSize // Allocated size for array (integer)
+#define kInlineCacheSize   4 // Entries per named variable site (must be a power of two)
+
+#define kIntMapDenseMinSize 64 // Minimum growth of the dense part of the integer table
+#define kIntMapDenseMaxSize (1 << 20) // Keys above go to the sparse part
+#define kIntMapSparseMinSize 16 // Initial capacity of the sparse part (power of two)
+
+#define kSlabCellCount 1024 // Variables allocated at once (contiguous block of %obj)
+
+enum InlineCacheEntryField {
+  ICEntryFieldGeneration = 0, // Value of "_map.generation" when filled (integer, 0 for empty)
+  ICEntryFieldWord, // Tagged word of the name object (integer or string ptr)
+  ICEntryFieldKey, // Key used into the table (char *)
+  ICEntryFieldValue // Variable found for the key (obj*)
+};
+
+enum InlineCacheField {
+  InlineCacheFieldNext = 0, // Index of the next entry to replace (integer)
+  InlineCacheFieldEntries // Array of kInlineCacheSize icentry
 };
 
-StructType * BucketType(LLVMContext &C);
+StructType * InlineCacheEntryType(LLVMContext &C);
+StructType * InlineCacheType(LLVMContext &C);
 
-//void InitVarTable(Module *M);
-GlobalVariable * InitVarTable(Module *M);
+/* Keys are interned strings (see "Intern.h"), stored and compared by pointer */
 
-// void @insert(i8* %key, %obj* %value)
+/* Create the table (empty), presized for |namesCount| keys (distinct names seen by the parser) */
+GlobalVariable * InitVarTable(Module *M, uint64_t namesCount);
+
+/* Functions of the table take the hash of the key, known at compile time for names from
+ * the source (see "HostStrHash()"), variants without are computing it at run time ("@hash") */
+
+// void @inserthashed(i8* %key, i32 %hash, %obj* %value)
+void InsertHashed(Value *Key, Value *HashV, Value *Val, Module *M, IRBuilder<> &B);
 void Insert(Value *Key, Value *Val, Module *M, IRBuilder<> &B);
 
 /// Private
-// %obj* @getptr(i8* %key)
+// %obj* @getptrhashed(i8* %key, i32 %hash)
+Value * GetPtrHashed(Value *Key, Value *HashV, Module *M, IRBuilder<> &B);
 Value * GetPtr(Value *Key, Module *M, IRBuilder<> &B);
 
 // void @update(i8* %key, %obj* val)
@@ -40,7 +75,18 @@ void Update(Value *Key, Value *Val, Module *M, IRBuilder<> &B);
 // void @insertorupdate(i8* %key, %obj* val)
 void InsertOrUpdate(Value *Key, Value *Val, Module *M, IRBuilder<> &B);
 
-// %obj* @getptrorinsert(i8* %key)
+// %obj* @getptrorinserthashed(i8* %key, i32 %hash)
+Value * GetPtrOrInsertHashed(Value *Key, Value *HashV, Module *M, IRBuilder<> &B);
 Value * GetPtrOrInsert(Value *Key, Module *M, IRBuilder<> &B);
 
+/* Variables named by integers (or canonical decimal strings, like "42") live into a
+ * dedicated table: a dense array for keys in [0, N[ and an open-addressed table else */
+// %obj* @getptrorinsertint(i64 %key)
+Value * GetPtrOrInsertInt(Value *Key, Module *M, IRBuilder<> &B);
+
+/* Look up the variable named by the value of |NameObj| through a new inline cache
+ * (one per call site), the name is converted and searched into the table only on miss */
+// %obj* @getptrorinsertcached(%obj* %name, %icache* %cache)
+Value * GetPtrOrInsertCached(Value *NameObj, Module *M, IRBuilder<> &B);
+
 #endif // SMIL_HASH_H
\ No newline at end of file
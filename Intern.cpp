@@ -0,0 +1,305 @@
+#include "Intern.h"
+#include "StringType.h"
+#include "Utilities.h"
+
+/* Intern table: slots (i8**), capacity and number of strings */
+static GlobalVariable *__InternSlots = NULL;
+static GlobalVariable *__InternCap = NULL;
+static GlobalVariable *__InternCount = NULL;
+
+static void InitInternTable(Module *M)
+{
+  if (__InternSlots)
+    return;
+  
+  LLVMContext &C = M->getContext();
+  Constant *Zero64 = ConstantInt::get(Type::getInt64Ty(C), 0);
+  __InternSlots = new GlobalVariable(*M, Type::getInt8PtrTy(C)->getPointerTo(), false,
+                                     GlobalValue::WeakAnyLinkage,
+                                     ConstantPointerNull::get(Type::getInt8PtrTy(C)->getPointerTo()),
+                                     "_intern.slots");
+  __InternCap = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                   GlobalValue::WeakAnyLinkage, Zero64, "_intern.cap");
+  __InternCount = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                     GlobalValue::WeakAnyLinkage, Zero64, "_intern.count");
+}
+
+/* Cached hash of the string |Str| (already computed for strings into the table) */
+static Value * HeaderHash(Value *Str, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  return B.CreateLoad(B.CreateStructGEP(getStrHdrTy(C), StrHeader(Str, B), StrHdrFieldHash));
+}
+
+// void @interngrow()
+static void InternGrow(Module *M, IRBuilder<> &B)
+{
+  /*
+   * void interngrow() {
+   *   long cap = (_intern.cap) ? _intern.cap * 2 : kInternMinSize;
+   *   char ** slots = (char **)calloc(cap, sizeof(char *));
+   *   for (long i = 0; i < _intern.cap; i++) {
+   *     char * s = _intern.slots[i];
+   *     if (!s) continue;
+   *     long j = header(s)->hash & (cap - 1);
+   *     while (slots[j]) j = (j + 1) & (cap - 1);
+   *     slots[j] = s;
+   *   }
+   *   free(_intern.slots);
+   *   _intern.slots = slots; _intern.cap = cap;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *GrowF = cast<Function>(M->getOrInsertFunction("interngrow", Type::getVoidTy(C),
+                                                          (Type *)0));
+  if (GrowF->empty()) {
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", GrowF);
+    IRBuilder<> EB(EntryBB);
+    
+    Value *OldCap = EB.CreateLoad(__InternCap);
+    Value *OldSlots = EB.CreateLoad(__InternSlots);
+    Value *NewCap = EB.CreateSelect(EB.CreateICmpEQ(OldCap, EB.getInt64(0)),
+                                    EB.getInt64(kInternMinSize),
+                                    EB.CreateMul(OldCap, EB.getInt64(2)), "newCap");
+    Value *NewMask = EB.CreateSub(NewCap, EB.getInt64(1));
+    
+    // i8* @calloc(i64, i64)
+    Type* CallocArgs[] = { Type::getInt64Ty(C), Type::getInt64Ty(C) };
+    FunctionType *CallocTy = FunctionType::get(Type::getInt8PtrTy(C), CallocArgs, false);
+    Function *CallocF = cast<Function>(M->getOrInsertFunction("calloc", CallocTy));
+    
+    // void @free(i8*)
+    FunctionType *FreeTy = FunctionType::get(Type::getVoidTy(C),
+                                             ArrayRef<Type *>{ Type::getInt8PtrTy(C) }, false);
+    Function *FreeF = cast<Function>(M->getOrInsertFunction("free", FreeTy));
+    
+    Value *NewSlots = EB.CreatePointerCast(EB.CreateCall(CallocF, ArrayRef<Value *>{ NewCap, EB.getInt64(8 /* sizeof(char *) */) }),
+                                           Type::getInt8PtrTy(C)->getPointerTo());
+    
+    BasicBlock *LoopBB = BasicBlock::Create(C, "Loop", GrowF);
+    BasicBlock *MoveBB = BasicBlock::Create(C, "MoveBlock", GrowF);
+    BasicBlock *ProbeBB = BasicBlock::Create(C, "ProbeBlock", GrowF);
+    BasicBlock *StoreBB = BasicBlock::Create(C, "StoreBlock", GrowF);
+    BasicBlock *NextBB = BasicBlock::Create(C, "NextBlock", GrowF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", GrowF);
+    EB.CreateBr(LoopBB);
+    
+    /* Loop block: for (i = 0; i < old_cap; i++) */
+    IRBuilder<> LoopB(LoopBB);
+    PHINode *Counter = LoopB.CreatePHI(Type::getInt64Ty(C), 2, "counter");
+    Counter->addIncoming(LoopB.getInt64(0), EntryBB);
+    LoopB.CreateCondBr(LoopB.CreateICmpULT(Counter, OldCap), MoveBB, DoneBB);
+    
+    /* Move block: skip empty slots */
+    IRBuilder<> MoveB(MoveBB);
+    Value *Str = MoveB.CreateLoad(MoveB.CreateGEP(OldSlots, Counter));
+    MoveB.CreateCondBr(MoveB.CreateIsNull(Str), NextBB, ProbeBB);
+    
+    /* Probe block: linear probing for an empty slot */
+    IRBuilder<> ProbeB(ProbeBB);
+    PHINode *Slot = ProbeB.CreatePHI(Type::getInt64Ty(C), 2, "slot");
+    Slot->addIncoming(MoveB.CreateAnd(MoveB.CreateZExt(HeaderHash(Str, MoveB), Type::getInt64Ty(C)), NewMask),
+                      MoveBB);
+    Value *SlotPtr = ProbeB.CreateGEP(NewSlots, Slot);
+    Slot->addIncoming(ProbeB.CreateAnd(ProbeB.CreateAdd(Slot, ProbeB.getInt64(1)), NewMask), ProbeBB);
+    ProbeB.CreateCondBr(ProbeB.CreateIsNull(ProbeB.CreateLoad(SlotPtr)), StoreBB, ProbeBB);
+    
+    /* Store block */
+    IRBuilder<> StoreB(StoreBB);
+    StoreB.CreateStore(Str, SlotPtr);
+    StoreB.CreateBr(NextBB);
+    
+    /* Next block */
+    IRBuilder<> NextB(NextBB);
+    Counter->addIncoming(NextB.CreateAdd(Counter, NextB.getInt64(1)), NextBB);
+    NextB.CreateBr(LoopBB);
+    
+    /* Done block */
+    IRBuilder<> DoneB(DoneBB);
+    DoneB.CreateCall(FreeF, DoneB.CreatePointerCast(OldSlots, Type::getInt8PtrTy(C)));
+    DoneB.CreateStore(NewSlots, __InternSlots);
+    DoneB.CreateStore(NewCap, __InternCap);
+    DoneB.CreateRetVoid();
+  }
+  
+  // Call "interngrow" function
+  B.CreateCall(GrowF, ArrayRef<Value *>{});
+}
+
+// i8* @intern(i8* %str)
+Value * Intern(Value *Str, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * intern(char * s) {
+   *   struct strhdr * hdr = header(s);
+   *   if (hdr->flags & StringFlagInterned)
+   *     return s;
+   *
+   *   if ((_intern.count + 1) * 2 > _intern.cap) interngrow();
+   *   unsigned h = strhash(s);
+   *   long mask = _intern.cap - 1, i = h & mask;
+   *   for (; _intern.slots[i]; i = (i + 1) & mask) {
+   *     char * e = _intern.slots[i];
+   *     if (e == s || (header(e)->hash == h && header(e)->length == hdr->length
+   *                    && memcmp(e, s, hdr->length) == 0))
+   *       return e;
+   *   }
+   *
+   *   // First string with this content
+   *   if (!(hdr->flags & StringFlagConstant)) {
+   *     if ((hdr->flags & StringFlagRegion) || hdr->refcount != 1) { // Not only owned by the caller
+   *       char * copy = newstr(hdr->length);
+   *       memcpy(copy, s, hdr->length + 1);
+   *       header(copy)->length = hdr->length;
+   *       header(copy)->hash = h;
+   *       s = copy; hdr = header(copy);
+   *     }
+   *     hdr->flags |= StringFlagHashed | StringFlagInterned;
+   *   }
+   *   _intern.slots[i] = s;
+   *   _intern.count++;
+   *   return s;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  InitInternTable(M);
+  
+  Function *InternF = cast<Function>(M->getOrInsertFunction("intern", Type::getInt8PtrTy(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            (Type *)0));
+  if (InternF->empty()) {
+    Argument *SArg = InternF->arg_begin();
+    SArg->setName("str");
+    
+    StructType *HdrTy = getStrHdrTy(C);
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", InternF);
+    BasicBlock *RetSelfBB = BasicBlock::Create(C, "RetSelf", InternF);
+    BasicBlock *CheckGrowBB = BasicBlock::Create(C, "CheckGrowBlock", InternF);
+    BasicBlock *GrowBB = BasicBlock::Create(C, "GrowBlock", InternF);
+    BasicBlock *LookupBB = BasicBlock::Create(C, "LookupBlock", InternF);
+    BasicBlock *ProbeBB = BasicBlock::Create(C, "ProbeBlock", InternF);
+    BasicBlock *CompareBB = BasicBlock::Create(C, "CompareBlock", InternF);
+    BasicBlock *MemcmpBB = BasicBlock::Create(C, "MemcmpBlock", InternF);
+    BasicBlock *NextBB = BasicBlock::Create(C, "NextBlock", InternF);
+    BasicBlock *RetFoundBB = BasicBlock::Create(C, "RetFound", InternF);
+    BasicBlock *AddBB = BasicBlock::Create(C, "AddBlock", InternF);
+    BasicBlock *AdoptBB = BasicBlock::Create(C, "AdoptBlock", InternF);
+    BasicBlock *CopyBB = BasicBlock::Create(C, "CopyBlock", InternF);
+    BasicBlock *FlagBB = BasicBlock::Create(C, "FlagBlock", InternF);
+    BasicBlock *StoreBB = BasicBlock::Create(C, "StoreBlock", InternF);
+    
+    /* Entry block: already canonical */
+    IRBuilder<> EB(EntryBB);
+    Value *HdrPtr = StrHeader(SArg, EB);
+    Value *FlagsPtr = EB.CreateStructGEP(HdrTy, HdrPtr, StrHdrFieldFlags);
+    Value *Flags = EB.CreateLoad(FlagsPtr);
+    Value *Length = EB.CreateLoad(EB.CreateStructGEP(HdrTy, HdrPtr, StrHdrFieldLength));
+    Value *IsInterned = EB.CreateICmpNE(EB.CreateAnd(Flags, EB.getInt32(StringFlagInterned)), EB.getInt32(0));
+    EB.CreateCondBr(IsInterned, RetSelfBB, CheckGrowBB);
+    
+    IRBuilder<> RSB(RetSelfBB);
+    RSB.CreateRet(SArg);
+    
+    /* Check grow block: keep the load factor under 1/2 */
+    IRBuilder<> CGB(CheckGrowBB);
+    Value *NewCount = CGB.CreateAdd(CGB.CreateLoad(__InternCount), CGB.getInt64(1));
+    Value *NeedsGrow = CGB.CreateICmpUGT(CGB.CreateMul(NewCount, CGB.getInt64(2)),
+                                         CGB.CreateLoad(__InternCap));
+    CGB.CreateCondBr(NeedsGrow, GrowBB, LookupBB);
+    
+    IRBuilder<> GB(GrowBB);
+    InternGrow(M, GB);
+    GB.CreateBr(LookupBB);
+    
+    /* Lookup block */
+    IRBuilder<> LB(LookupBB);
+    Value *Hash = StrHash(SArg, M, LB);
+    Value *Mask = LB.CreateSub(LB.CreateLoad(__InternCap), LB.getInt64(1));
+    Value *Slots = LB.CreateLoad(__InternSlots);
+    Value *FirstSlot = LB.CreateAnd(LB.CreateZExt(Hash, Type::getInt64Ty(C)), Mask);
+    LB.CreateBr(ProbeBB);
+    
+    /* Probe block: stop on the first empty slot */
+    IRBuilder<> PB(ProbeBB);
+    PHINode *Slot = PB.CreatePHI(Type::getInt64Ty(C), 2, "slot");
+    Slot->addIncoming(FirstSlot, LookupBB);
+    Value *SlotPtr = PB.CreateGEP(Slots, Slot);
+    Value *SlotStr = PB.CreateLoad(SlotPtr);
+    PB.CreateCondBr(PB.CreateIsNull(SlotStr), AddBB, CompareBB);
+    
+    /* Compare block: same pointer, or same hash and length (then compare the bytes) */
+    IRBuilder<> CB(CompareBB);
+    Value *SlotHdrPtr = StrHeader(SlotStr, CB);
+    Value *SameHash = CB.CreateICmpEQ(CB.CreateLoad(CB.CreateStructGEP(HdrTy, SlotHdrPtr, StrHdrFieldHash)), Hash);
+    Value *SameLength = CB.CreateICmpEQ(CB.CreateLoad(CB.CreateStructGEP(HdrTy, SlotHdrPtr, StrHdrFieldLength)), Length);
+    BasicBlock *CheckContentBB = BasicBlock::Create(C, "CheckContentBlock", InternF);
+    CB.CreateCondBr(CB.CreateICmpEQ(SlotStr, SArg), RetFoundBB, CheckContentBB);
+    
+    IRBuilder<> CCB(CheckContentBB);
+    CCB.CreateCondBr(CCB.CreateAnd(SameHash, SameLength), MemcmpBB, NextBB);
+    
+    IRBuilder<> MCB(MemcmpBB);
+    
+    // i32 @memcmp(i8*, i8*, i64)
+    Type* MemcmpArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C), Type::getInt64Ty(C) };
+    FunctionType *MemcmpTy = FunctionType::get(Type::getInt32Ty(C), MemcmpArgs, false);
+    Function *MemcmpF = cast<Function>(M->getOrInsertFunction("memcmp", MemcmpTy));
+    
+    Value *Ret = MCB.CreateCall(MemcmpF, ArrayRef<Value *>{ SlotStr, SArg, Length });
+    MCB.CreateCondBr(MCB.CreateICmpEQ(Ret, MCB.getInt32(0)), RetFoundBB, NextBB);
+    
+    IRBuilder<> NB(NextBB);
+    Slot->addIncoming(NB.CreateAnd(NB.CreateAdd(Slot, NB.getInt64(1)), Mask), NextBB);
+    NB.CreateBr(ProbeBB);
+    
+    IRBuilder<> RFB(RetFoundBB);
+    RFB.CreateRet(SlotStr);
+    
+    /* Add block: global strings are kept as they are (never freed nor written) */
+    IRBuilder<> AB(AddBB);
+    Value *IsConstant = AB.CreateICmpNE(AB.CreateAnd(Flags, AB.getInt32(StringFlagConstant)), AB.getInt32(0));
+    AB.CreateCondBr(IsConstant, StoreBB, AdoptBB);
+    
+    /* Adopt block: taken only if the caller is its only owner */
+    IRBuilder<> ADB(AdoptBB);
+    Value *IsRegion = ADB.CreateICmpNE(ADB.CreateAnd(Flags, ADB.getInt32(StringFlagRegion)), ADB.getInt32(0));
+    Value *RefCount = ADB.CreateLoad(ADB.CreateStructGEP(HdrTy, HdrPtr, StrHdrFieldRefCount));
+    Value *IsShared = ADB.CreateICmpNE(RefCount, ADB.getInt64(1));
+    ADB.CreateCondBr(ADB.CreateOr(IsRegion, IsShared), CopyBB, FlagBB);
+    
+    /* Copy block */
+    IRBuilder<> CPB(CopyBB);
+    Value *Copy = NewStr(Length, M, CPB);
+    MemCpy(Copy, SArg, CPB.CreateAdd(Length, CPB.getInt64(1)), M, CPB, 1);
+    SetStrLength(Copy, Length, CPB);
+    Value *CopyHdrPtr = StrHeader(Copy, CPB);
+    CPB.CreateStore(Hash, CPB.CreateStructGEP(HdrTy, CopyHdrPtr, StrHdrFieldHash));
+    CPB.CreateBr(FlagBB);
+    
+    /* Flag block */
+    IRBuilder<> FB(FlagBB);
+    PHINode *Canonical = FB.CreatePHI(Type::getInt8PtrTy(C), 2, "canonical");
+    Canonical->addIncoming(SArg, AdoptBB);
+    Canonical->addIncoming(Copy, CopyBB);
+    Value *CanonicalFlagsPtr = FB.CreateStructGEP(HdrTy, StrHeader(Canonical, FB), StrHdrFieldFlags);
+    FB.CreateStore(FB.CreateOr(FB.CreateLoad(CanonicalFlagsPtr), FB.getInt32(StringFlagHashed | StringFlagInterned)),
+                   CanonicalFlagsPtr);
+    FB.CreateBr(StoreBB);
+    
+    /* Store block */
+    IRBuilder<> SB(StoreBB);
+    PHINode *Interned = SB.CreatePHI(Type::getInt8PtrTy(C), 2, "interned");
+    Interned->addIncoming(SArg, AddBB);
+    Interned->addIncoming(Canonical, FlagBB);
+    SB.CreateStore(Interned, SlotPtr);
+    SB.CreateStore(NewCount, __InternCount);
+    SB.CreateRet(Interned);
+  }
+  
+  // Call "intern" function
+  return B.CreateCall(InternF, Str);
+}
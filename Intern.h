@@ -0,0 +1,24 @@
+#ifndef SMIL_INTERN_H
+#define SMIL_INTERN_H
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+using namespace llvm;
+
+/*
+ * Names of variables are interned: one canonical string per content, so keys of the
+ * variable table compare by pointer. Canonical strings are owned by the intern table
+ * and live until the end of the program (StringFlagInterned, or global strings).
+ *   char ** _intern.slots; long _intern.cap; long _intern.count; (open addressing, NULL for empty slots)
+ */
+#define kInternMinSize 64 // Initial capacity of the intern table (power of two)
+
+/* Canonical string equal to |Str|: |Str| itself if it was the first one seen with this content
+ * (taken if the caller is its only owner, copied else), the caller still releases |Str| */
+// i8* @intern(i8* %str)
+Value * Intern(Value *Str, Module *M, IRBuilder<> &B);
+
+#endif // SMIL_INTERN_H
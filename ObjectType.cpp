@@ -1,16 +1,15 @@
 #include "ObjectType.h"
+#include "BigInt.h"
 
 #define kObjectFieldDataTy(C) Type::getInt64Ty(C)
-#define kObjectFieldTypeTy(C) Type::getInt1Ty(C)
 
 StructType * getObjTy(LLVMContext &C)
 {
   static StructType *Ty = NULL;
   if (!Ty) {
-    /* struct obj { long int data; int type:1; }; */
+    /* struct obj { long int data; }; (tagged word) */
     Ty = StructType::create("obj",
-                            kObjectFieldDataTy(C),
-                            kObjectFieldTypeTy(C), NULL);
+                            kObjectFieldDataTy(C), NULL);
   }
   return Ty;
 }
@@ -27,16 +26,76 @@ PointerType * getObjPtrTy(LLVMContext &C)
 /* Return the size (in bytes) of the "obj" type */
 unsigned ObjectTypeSize(LLVMContext &C)
 {
-  static unsigned Size = 0;
-  if (Size == 0) {
-    StructType *STy = getObjTy(C);
-    int NumElements = STy->getNumElements();
-    for (int i = 0; i < NumElements; i++)
-      Size += STy->getElementType(i)->getScalarSizeInBits();
-    Size = ceilf(Size / 8.);
-  }
-  return Size;
+  // A single word, without padding
+  return kObjectFieldDataTy(C)->getPrimitiveSizeInBits() / 8;
+}
+
+Value * LoadObjWord(Value *Obj, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  return B.CreateLoad(B.CreateStructGEP(getObjTy(C), Obj, ObjectFieldData));
+}
+
+void StoreObjWord(Value *Word, Value *Obj, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  B.CreateStore(Word, B.CreateStructGEP(getObjTy(C), Obj, ObjectFieldData));
+}
+
+Value * WordIsInteger(Value *Word, IRBuilder<> &B)
+{
+  return B.CreateICmpEQ(B.CreateAnd(Word, B.getInt64(kObjectTagMask)),
+                        B.getInt64(ObjectTypeInteger));
+}
+
+Value * WordIsString(Value *Word, IRBuilder<> &B)
+{
+  return B.CreateICmpEQ(B.CreateAnd(Word, B.getInt64(kObjectTagMask)),
+                        B.getInt64(ObjectTypeString));
+}
+
+Value * WordIsInlineStr(Value *Word, IRBuilder<> &B)
+{
+  return B.CreateICmpEQ(B.CreateAnd(Word, B.getInt64(kObjectStrTagMask)),
+                        B.getInt64(kObjectStrTagInline));
+}
+
+Value * WordToInt64(Value *Word, IRBuilder<> &B)
+{
+  return B.CreateAShr(Word, B.getInt64(kObjectTagBits));
+}
+
+Value * WordToStr(Value *Word, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  
+  // The bytes of an inline string are stored to a buffer of the site (into the entry block),
+  //   the last byte of |word >> 8| is always zero (NUL-terminated)
+  BasicBlock &EntryBB = B.GetInsertBlock()->getParent()->getEntryBlock();
+  IRBuilder<> EntryB(&EntryBB, EntryBB.begin());
+  Value *Buffer = EntryB.CreateAlloca(Type::getInt64Ty(C), 0, "inlinestr");
+  B.CreateStore(B.CreateLShr(Word, B.getInt64(8)), Buffer);
+  
+  Value *InlinePtr = B.CreatePointerCast(Buffer, Type::getInt8PtrTy(C));
+  Value *HeapPtr = B.CreateIntToPtr(B.CreateLShr(Word, B.getInt64(kObjectStrTagBits)),
+                                    Type::getInt8PtrTy(C));
+  
+  // Digits of big integers are written on first read (see "BigInt.h")
+  BigIntDigits(Word, B.GetInsertBlock()->getModule(), B);
+  return B.CreateSelect(WordIsInlineStr(Word, B), InlinePtr, HeapPtr);
+}
+
+Value * Int64ToWord(Value *Int, IRBuilder<> &B)
+{
+  return B.CreateShl(Int, B.getInt64(kObjectTagBits));
+}
+
+Value * StrToWord(Value *Str, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  Value *Addr = B.CreatePtrToInt(Str, Type::getInt64Ty(C));
+  return B.CreateOr(B.CreateShl(Addr, B.getInt64(kObjectStrTagBits)),
+                    B.getInt64(kObjectStrTagHeap));
 }
 
-#undef kObjectFieldTypeTy
-#undef kObjectFieldDataTy
\ No newline at end of file
+#undef kObjectFieldDataTy
@@ -3,17 +3,35 @@
 
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/IRBuilder.h"
 
 using namespace llvm;
 
+/*
+ * An object is a single tagged word (i64), the lowest bit gives the type:
+ *   integer:       (n << 1)                      | 0
+ *   heap string:   ((i64)(char *) << 2)          | 01
+ *   inline string: (bytes << 8) | (length << 2)  | 11 (up to 7 bytes, no allocation)
+ * Pointers are shifted (not or-ed with the tag), global strings are not aligned.
+ * Integers of a word are 63 bits, in [-2^62, 2^62[: anything outside (inputs, results of the
+ * arithmetic) is a big integer instead (see "BigInt.h"), never a wrapped word.
+ */
+#define kObjectTagBits 1
+#define kObjectTagMask ((1 << kObjectTagBits) - 1)
+
+#define kObjectStrTagBits 2
+#define kObjectStrTagMask ((1 << kObjectStrTagBits) - 1)
+#define kObjectStrTagHeap 1
+#define kObjectStrTagInline 3
+#define kObjectInlineStrMaxLength 7
+
 enum ObjectField {
-  ObjectFieldData = 0, // String or Integer Field (ptr: long int (Int64))
-  ObjectFieldType // Type (type: int:1 (ObjectType))
+  ObjectFieldData = 0 // Tagged word (long int (Int64))
 };
 
 enum ObjectType {
-  ObjectTypeString = 0, // String data
-  ObjectTypeInteger // Integer data
+  ObjectTypeInteger = 0, // Integer data
+  ObjectTypeString // String data
 };
 
 StructType * getObjTy(LLVMContext &C);
@@ -22,4 +40,23 @@ PointerType * getObjPtrTy(LLVMContext &C);
 /* Return the size (in bytes) of the "obj" type */
 unsigned ObjectTypeSize(LLVMContext &C);
 
-#endif // SMIL_OBJECT_TYPE_H
\ No newline at end of file
+/* Load/store the tagged word (i64) of |Obj| (%obj*) */
+Value * LoadObjWord(Value *Obj, IRBuilder<> &B);
+void StoreObjWord(Value *Word, Value *Obj, IRBuilder<> &B);
+
+/* Type of a tagged word (i1) */
+Value * WordIsInteger(Value *Word, IRBuilder<> &B);
+Value * WordIsString(Value *Word, IRBuilder<> &B);
+Value * WordIsInlineStr(Value *Word, IRBuilder<> &B);
+
+/* Payload of a tagged word: the integer (i64) or the string (i8*, with the digits of a big integer written),
+ * inline strings are copied to a buffer owned by the call site (valid until it runs again) */
+Value * WordToInt64(Value *Word, IRBuilder<> &B);
+Value * WordToStr(Value *Word, IRBuilder<> &B);
+
+/* Tagged word (i64) from an integer (i64, in [-2^62, 2^62[, unchecked) or a heap string (i8*, see
+ * "PackStr()" for short strings) */
+Value * Int64ToWord(Value *Int, IRBuilder<> &B);
+Value * StrToWord(Value *Str, IRBuilder<> &B);
+
+#endif // SMIL_OBJECT_TYPE_H
@@ -0,0 +1,356 @@
+#include <algorithm>
+
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Function.h"
+
+#include "RefCount.h"
+#include "ObjectType.h"
+#include "StringType.h"
+#include "Utilities.h"
+
+/* Strings never freed by a release */
+#define kStringUncountedFlags (StringFlagConstant | StringFlagRegion | StringFlagInterned)
+
+// void @strretain(i8* %str)
+void StrRetain(Value *Str, Module *M, IRBuilder<> &B)
+{
+  /*
+   * void strretain(char * s) {
+   *   struct strhdr * hdr = header(s);
+   *   if (!(hdr->flags & (StringFlagConstant | StringFlagRegion | StringFlagInterned)))
+   *     hdr->refcount++;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *RetainF = cast<Function>(M->getOrInsertFunction("strretain", Type::getVoidTy(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            (Type *)0));
+  if (RetainF->empty()) {
+    Argument *SArg = RetainF->arg_begin();
+    SArg->setName("str");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", RetainF);
+    BasicBlock *CountBB = BasicBlock::Create(C, "CountBlock", RetainF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", RetainF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *HdrPtr = StrHeader(SArg, EB);
+    Value *Flags = EB.CreateLoad(EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldFlags));
+    Value *IsUncounted = EB.CreateICmpNE(EB.CreateAnd(Flags, EB.getInt32(kStringUncountedFlags)),
+                                         EB.getInt32(0));
+    EB.CreateCondBr(IsUncounted, DoneBB, CountBB);
+    
+    /* Count Block */
+    IRBuilder<> CB(CountBB);
+    Value *CountPtr = CB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldRefCount);
+    CB.CreateStore(CB.CreateAdd(CB.CreateLoad(CountPtr), CB.getInt64(1)), CountPtr);
+    CB.CreateBr(DoneBB);
+    
+    /* Done Block */
+    IRBuilder<> DoneB(DoneBB);
+    DoneB.CreateRetVoid();
+  }
+  
+  // Call "strretain" function
+  B.CreateCall(RetainF, Str);
+}
+
+// void @strrelease(i8* %str)
+void StrRelease(Value *Str, Module *M, IRBuilder<> &B)
+{
+  /*
+   * void strrelease(char * s) {
+   *   struct strhdr * hdr = header(s);
+   *   if (!(hdr->flags & (StringFlagConstant | StringFlagRegion | StringFlagInterned)) && --hdr->refcount == 0)
+   *     free(hdr);
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *ReleaseF = cast<Function>(M->getOrInsertFunction("strrelease", Type::getVoidTy(C),
+                                                             Type::getInt8PtrTy(C),
+                                                             (Type *)0));
+  if (ReleaseF->empty()) {
+    Argument *SArg = ReleaseF->arg_begin();
+    SArg->setName("str");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", ReleaseF);
+    BasicBlock *CountBB = BasicBlock::Create(C, "CountBlock", ReleaseF);
+    BasicBlock *FreeBB = BasicBlock::Create(C, "FreeBlock", ReleaseF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", ReleaseF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *HdrPtr = StrHeader(SArg, EB);
+    Value *Flags = EB.CreateLoad(EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldFlags));
+    Value *IsUncounted = EB.CreateICmpNE(EB.CreateAnd(Flags, EB.getInt32(kStringUncountedFlags)),
+                                         EB.getInt32(0));
+    EB.CreateCondBr(IsUncounted, DoneBB, CountBB);
+    
+    /* Count Block */
+    IRBuilder<> CB(CountBB);
+    Value *CountPtr = CB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldRefCount);
+    Value *Count = CB.CreateSub(CB.CreateLoad(CountPtr), CB.getInt64(1));
+    CB.CreateStore(Count, CountPtr);
+    CB.CreateCondBr(CB.CreateICmpEQ(Count, CB.getInt64(0)), FreeBB, DoneBB);
+    
+    /* Free Block */
+    IRBuilder<> FB(FreeBB);
+    // void @free(i8*)
+    FunctionType *FreeTy = FunctionType::get(Type::getVoidTy(C),
+                                             ArrayRef<Type *>{ Type::getInt8PtrTy(C) }, false);
+    Function *FreeF = cast<Function>(M->getOrInsertFunction("free", FreeTy));
+    FB.CreateCall(FreeF, FB.CreatePointerCast(HdrPtr, Type::getInt8PtrTy(C)));
+    FB.CreateBr(DoneBB);
+    
+    /* Done Block */
+    IRBuilder<> DoneB(DoneBB);
+    DoneB.CreateRetVoid();
+  }
+  
+  // Call "strrelease" function
+  B.CreateCall(ReleaseF, Str);
+}
+
+// i8* @strown(i8* %str)
+Value * StrOwn(Value *Str, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * strown(char * s) {
+   *   struct strhdr * hdr = header(s);
+   *   if (hdr->flags & StringFlagRegion) {
+   *     char * copy = newstr(hdr->length);
+   *     memcpy(copy, s, hdr->length + 1);
+   *     header(copy)->length = hdr->length;
+   *     return copy;
+   *   }
+   *   strretain(s);
+   *   return s;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *OwnF = cast<Function>(M->getOrInsertFunction("strown", Type::getInt8PtrTy(C),
+                                                         Type::getInt8PtrTy(C),
+                                                         (Type *)0));
+  if (OwnF->empty()) {
+    Argument *SArg = OwnF->arg_begin();
+    SArg->setName("str");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", OwnF);
+    BasicBlock *CopyBB = BasicBlock::Create(C, "CopyBlock", OwnF);
+    BasicBlock *RetainBB = BasicBlock::Create(C, "RetainBlock", OwnF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *HdrPtr = StrHeader(SArg, EB);
+    Value *Flags = EB.CreateLoad(EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldFlags));
+    Value *IsRegion = EB.CreateICmpNE(EB.CreateAnd(Flags, EB.getInt32(StringFlagRegion)), EB.getInt32(0));
+    EB.CreateCondBr(IsRegion, CopyBB, RetainBB);
+    
+    /* Copy Block: promoted out of the region */
+    IRBuilder<> CB(CopyBB);
+    Value *Length = StrLength(SArg, CB);
+    Value *Copy = NewStr(Length, M, CB);
+    MemCpy(Copy, SArg, CB.CreateAdd(Length, CB.getInt64(1)), M, CB, 1);
+    SetStrLength(Copy, Length, CB);
+    CB.CreateRet(Copy);
+    
+    /* Retain Block */
+    IRBuilder<> RB(RetainBB);
+    StrRetain(SArg, M, RB);
+    RB.CreateRet(SArg);
+  }
+  
+  // Call "strown" function
+  return B.CreateCall(OwnF, Str);
+}
+
+// i1 @strisunique(i8* %str)
+Value * StrIsUnique(Value *Str, Module *M, IRBuilder<> &B)
+{
+  /*
+   * bool strisunique(const char * s) {
+   *   struct strhdr * hdr = header(s);
+   *   return !(hdr->flags & (kStringUncountedFlags | StringFlagBigInt)) && hdr->refcount == 1;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *UniqueF = cast<Function>(M->getOrInsertFunction("strisunique", Type::getInt1Ty(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            (Type *)0));
+  if (UniqueF->empty()) {
+    Argument *SArg = UniqueF->arg_begin();
+    SArg->setName("str");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", UniqueF);
+    IRBuilder<> EB(EntryBB);
+    
+    // Big integers keep their limbs after the digits, they are never modified
+    Value *HdrPtr = StrHeader(SArg, EB);
+    Value *Flags = EB.CreateLoad(EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldFlags));
+    Value *IsCounted = EB.CreateICmpEQ(EB.CreateAnd(Flags, EB.getInt32(kStringUncountedFlags | StringFlagBigInt)),
+                                       EB.getInt32(0));
+    Value *RefCount = EB.CreateLoad(EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldRefCount));
+    EB.CreateRet(EB.CreateAnd(IsCounted, EB.CreateICmpEQ(RefCount, EB.getInt64(1))));
+  }
+  
+  // Call "strisunique" function
+  return B.CreateCall(UniqueF, Str);
+}
+
+/* Call |Name| ("strretain" or "strrelease") on the string of |Word| if it's a heap string */
+static Function * CreateObjCountFunction(const char *Name, bool retain, Module *M)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *CountF = cast<Function>(M->getOrInsertFunction(Name, Type::getVoidTy(C),
+                                                           Type::getInt64Ty(C),
+                                                           (Type *)0));
+  if (CountF->empty()) {
+    Argument *WArg = CountF->arg_begin();
+    WArg->setName("word");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", CountF);
+    BasicBlock *HeapBB = BasicBlock::Create(C, "HeapBlock", CountF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", CountF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *IsHeap = EB.CreateICmpEQ(EB.CreateAnd(WArg, EB.getInt64(kObjectStrTagMask)),
+                                    EB.getInt64(kObjectStrTagHeap));
+    EB.CreateCondBr(IsHeap, HeapBB, DoneBB);
+    
+    /* Heap Block */
+    IRBuilder<> HB(HeapBB);
+    Value *Str = HB.CreateIntToPtr(HB.CreateLShr(WArg, HB.getInt64(kObjectStrTagBits)),
+                                   Type::getInt8PtrTy(C));
+    if (retain) StrRetain(Str, M, HB);
+    else StrRelease(Str, M, HB);
+    HB.CreateBr(DoneBB);
+    
+    /* Done Block */
+    IRBuilder<> DoneB(DoneBB);
+    DoneB.CreateRetVoid();
+  }
+  return CountF;
+}
+
+// void @objretain(i64 %word)
+void ObjRetain(Value *Word, Module *M, IRBuilder<> &B)
+{
+  /*
+   * void objretain(long word) {
+   *   if ((word & kObjectStrTagMask) == kObjectStrTagHeap)
+   *     strretain((char *)(word >> 2));
+   * }
+   */
+  
+  // Call "objretain" function
+  B.CreateCall(CreateObjCountFunction("objretain", true, M), Word);
+}
+
+// void @objrelease(i64 %word)
+void ObjRelease(Value *Word, Module *M, IRBuilder<> &B)
+{
+  /*
+   * void objrelease(long word) {
+   *   if ((word & kObjectStrTagMask) == kObjectStrTagHeap)
+   *     strrelease((char *)(word >> 2));
+   * }
+   */
+  
+  // Call "objrelease" function
+  B.CreateCall(CreateObjCountFunction("objrelease", false, M), Word);
+}
+
+/*
+ * Local (per block) elision of "@objretain" and "@objrelease" calls:
+ *  - the word is known to be an integer or an inline string (from its bits),
+ *  - a retain followed by a release of the same word, with no other use of the word
+ *    and no other call in between (net count unchanged).
+ */
+namespace {
+  struct RefCountElision : public FunctionPass {
+    static char ID;
+    RefCountElision() : FunctionPass(ID) {}
+    
+    const char *getPassName() const override { return "SMIL reference count elision"; }
+    
+    bool runOnFunction(Function &F) override;
+  };
+}
+
+char RefCountElision::ID = 0;
+
+static CallInst * CountCall(Instruction *I, const char *Name)
+{
+  CallInst *CI = dyn_cast<CallInst>(I);
+  if (CI && CI->getCalledFunction() && CI->getCalledFunction()->getName() == Name)
+    return CI;
+  return NULL;
+}
+
+static bool IsCountCall(Instruction *I)
+{
+  return CountCall(I, "objretain") || CountCall(I, "objrelease");
+}
+
+bool RefCountElision::runOnFunction(Function &F)
+{
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  bool changed = false;
+  
+  for (Function::iterator BB = F.begin(); BB != F.end(); BB++) {
+    
+    /* Words with a known tag */
+    for (BasicBlock::iterator it = BB->begin(); it != BB->end(); ) {
+      Instruction *I = &*(it++);
+      if (!IsCountCall(I))
+        continue;
+      
+      Value *Word = cast<CallInst>(I)->getArgOperand(0);
+      APInt KnownZero(64, 0), KnownOne(64, 0);
+      computeKnownBits(Word, KnownZero, KnownOne, DL, 0, nullptr, I);
+      bool isInteger = KnownZero[0];
+      bool isInline = KnownOne[0] && KnownOne[1];
+      if (isInteger || isInline) {
+        I->eraseFromParent();
+        changed = true;
+      }
+    }
+    
+    /* Retain/release pairs */
+    for (BasicBlock::iterator it = BB->begin(); it != BB->end(); ) {
+      CallInst *Retain = CountCall(&*(it++), "objretain");
+      if (!Retain)
+        continue;
+      
+      Value *Word = Retain->getArgOperand(0);
+      for (BasicBlock::iterator next = it; next != BB->end(); next++) {
+        Instruction *I = &*next;
+        CallInst *Release = CountCall(I, "objrelease");
+        if (Release && Release->getArgOperand(0) == Word) {
+          if (it == next) it++;
+          Release->eraseFromParent();
+          Retain->eraseFromParent();
+          changed = true;
+          break;
+        }
+        bool isCall = isa<CallInst>(I) || isa<InvokeInst>(I);
+        if ((isCall && !IsCountCall(I)) || std::find(I->op_begin(), I->op_end(), Word) != I->op_end())
+          break;
+      }
+    }
+  }
+  return changed;
+}
+
+FunctionPass * createRefCountElisionPass()
+{
+  return new RefCountElision();
+}
@@ -0,0 +1,44 @@
+#ifndef SMIL_REFCOUNT_H
+#define SMIL_REFCOUNT_H
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+
+/*
+ * Heap strings are reference counted (see "StrHdrFieldRefCount"): a new string has one owner,
+ * each copy of its word into a variable or onto the stack adds one and each overwritten
+ * (or dropped) word removes one, the string is freed when no owner remains.
+ * Integers, inline strings, global strings (StringFlagConstant), temporary strings
+ * (StringFlagRegion) and interned names (StringFlagInterned) are not counted.
+ */
+
+// void @strretain(i8* %str)
+void StrRetain(Value *Str, Module *M, IRBuilder<> &B);
+
+// void @strrelease(i8* %str)
+void StrRelease(Value *Str, Module *M, IRBuilder<> &B);
+
+/* New reference to |Str|, or a copy (with one owner) for a temporary string of the region */
+// i8* @strown(i8* %str)
+Value * StrOwn(Value *Str, Module *M, IRBuilder<> &B);
+
+/* True (i1) if |Str| is counted and has one owner (the caller), so it can be modified in place */
+// i1 @strisunique(i8* %str)
+Value * StrIsUnique(Value *Str, Module *M, IRBuilder<> &B);
+
+/* Retain/release the string of a tagged word (i64), nothing for other words */
+// void @objretain(i64 %word)
+void ObjRetain(Value *Word, Module *M, IRBuilder<> &B);
+
+// void @objrelease(i64 %word)
+void ObjRelease(Value *Word, Module *M, IRBuilder<> &B);
+
+/* Local elision of the count traffic (see "RefCount.cpp") */
+FunctionPass * createRefCountElisionPass();
+
+#endif // SMIL_REFCOUNT_H
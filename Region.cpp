@@ -0,0 +1,340 @@
+#include "Region.h"
+#include "ObjectType.h"
+#include "StringType.h"
+
+#define kRegionChunkHeaderSize 16
+
+StructType * getRegionChunkTy(LLVMContext &C)
+{
+  static StructType *Ty = NULL;
+  if (!Ty) {
+    /* struct regionchunk { struct regionchunk * prev; long size; }; */
+    Ty = StructType::create(C, "regionchunk");
+    Ty->setBody(Ty->getPointerTo(), Type::getInt64Ty(C), NULL);
+  }
+  return Ty;
+}
+
+/* Current chunk (%regionchunk*), bytes used into it (with the header) and the spare chunk */
+static GlobalVariable *__RegionChunk = NULL;
+static GlobalVariable *__RegionUsed = NULL;
+static GlobalVariable *__RegionSpare = NULL;
+
+static void InitRegion(Module *M)
+{
+  if (__RegionChunk)
+    return;
+  
+  LLVMContext &C = M->getContext();
+  Constant *NullChunk = ConstantPointerNull::get(getRegionChunkTy(C)->getPointerTo());
+  __RegionChunk = new GlobalVariable(*M, getRegionChunkTy(C)->getPointerTo(), false,
+                                     GlobalValue::WeakAnyLinkage, NullChunk, "_region.chunk");
+  __RegionUsed = new GlobalVariable(*M, Type::getInt64Ty(C), false,
+                                    GlobalValue::WeakAnyLinkage,
+                                    ConstantInt::get(Type::getInt64Ty(C), 0), "_region.used");
+  __RegionSpare = new GlobalVariable(*M, getRegionChunkTy(C)->getPointerTo(), false,
+                                     GlobalValue::WeakAnyLinkage, NullChunk, "_region.spare");
+}
+
+// i8* @regionalloc(i64 %size)
+Value * RegionAlloc(Value *Size, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * regionalloc(long size) {
+   *   size = (size + 7) & ~7;
+   *   struct regionchunk * c = _region.chunk;
+   *   if (!c || _region.used + size > c->size) {
+   *     struct regionchunk * n = _region.spare;
+   *     if (n && n->size >= size + 16) {
+   *       _region.spare = NULL;
+   *     } else {
+   *       long chunkSize = max(kRegionChunkSize, size + 16);
+   *       n = (struct regionchunk *)malloc(chunkSize);
+   *       n->size = chunkSize;
+   *     }
+   *     n->prev = c;
+   *     _region.chunk = c = n;
+   *     _region.used = 16;
+   *   }
+   *   char * p = (char *)c + _region.used;
+   *   _region.used += size;
+   *   return p;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  InitRegion(M);
+  
+  Function *AllocF = cast<Function>(M->getOrInsertFunction("regionalloc", Type::getInt8PtrTy(C),
+                                                           Type::getInt64Ty(C),
+                                                           (Type *)0));
+  if (AllocF->empty()) {
+    Argument *SArg = AllocF->arg_begin();
+    SArg->setName("size");
+    
+    StructType *ChunkTy = getRegionChunkTy(C);
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", AllocF);
+    BasicBlock *CheckBB = BasicBlock::Create(C, "CheckBlock", AllocF);
+    BasicBlock *GrowBB = BasicBlock::Create(C, "GrowBlock", AllocF);
+    BasicBlock *ReuseBB = BasicBlock::Create(C, "ReuseBlock", AllocF);
+    BasicBlock *NewBB = BasicBlock::Create(C, "NewBlock", AllocF);
+    BasicBlock *LinkBB = BasicBlock::Create(C, "LinkBlock", AllocF);
+    BasicBlock *BumpBB = BasicBlock::Create(C, "BumpBlock", AllocF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *Size = EB.CreateAnd(EB.CreateAdd(SArg, EB.getInt64(7)), EB.getInt64(~7LL));
+    Value *Chunk = EB.CreateLoad(__RegionChunk);
+    Value *Used = EB.CreateLoad(__RegionUsed);
+    EB.CreateCondBr(EB.CreateIsNull(Chunk), GrowBB, CheckBB);
+    
+    /* Check Block */
+    IRBuilder<> CB(CheckBB);
+    Value *ChunkSize = CB.CreateLoad(CB.CreateStructGEP(ChunkTy, Chunk, 1));
+    CB.CreateCondBr(CB.CreateICmpSGT(CB.CreateAdd(Used, Size), ChunkSize), GrowBB, BumpBB);
+    
+    /* Grow Block: the spare chunk if large enough, else a new one */
+    IRBuilder<> GB(GrowBB);
+    Value *NeededSize = GB.CreateAdd(Size, GB.getInt64(kRegionChunkHeaderSize));
+    Value *Spare = GB.CreateLoad(__RegionSpare);
+    BasicBlock *SpareBB = BasicBlock::Create(C, "SpareBlock", AllocF);
+    GB.CreateCondBr(GB.CreateIsNull(Spare), NewBB, SpareBB);
+    
+    IRBuilder<> SB(SpareBB);
+    Value *SpareSize = SB.CreateLoad(SB.CreateStructGEP(ChunkTy, Spare, 1));
+    SB.CreateCondBr(SB.CreateICmpSGE(SpareSize, NeededSize), ReuseBB, NewBB);
+    
+    /* Reuse Block */
+    IRBuilder<> RB(ReuseBB);
+    RB.CreateStore(ConstantPointerNull::get(ChunkTy->getPointerTo()), __RegionSpare);
+    RB.CreateBr(LinkBB);
+    
+    /* New Block */
+    IRBuilder<> NB(NewBB);
+    // i8* @malloc(i64)
+    FunctionType *MallocTy = FunctionType::get(Type::getInt8PtrTy(C),
+                                               ArrayRef<Type *>{ Type::getInt64Ty(C) }, false);
+    Function *MallocF = cast<Function>(M->getOrInsertFunction("malloc", MallocTy));
+    Value *NewSize = NB.CreateSelect(NB.CreateICmpSGT(NeededSize, NB.getInt64(kRegionChunkSize)),
+                                     NeededSize, NB.getInt64(kRegionChunkSize));
+    Value *NewChunk = NB.CreatePointerCast(NB.CreateCall(MallocF, NewSize), ChunkTy->getPointerTo());
+    NB.CreateStore(NewSize, NB.CreateStructGEP(ChunkTy, NewChunk, 1));
+    NB.CreateBr(LinkBB);
+    
+    /* Link Block */
+    IRBuilder<> LB(LinkBB);
+    PHINode *Next = LB.CreatePHI(ChunkTy->getPointerTo(), 2);
+    Next->addIncoming(Spare, ReuseBB);
+    Next->addIncoming(NewChunk, NewBB);
+    LB.CreateStore(Chunk, LB.CreateStructGEP(ChunkTy, Next, 0));
+    LB.CreateStore(Next, __RegionChunk);
+    LB.CreateBr(BumpBB);
+    
+    /* Bump Block */
+    IRBuilder<> BB(BumpBB);
+    PHINode *Current = BB.CreatePHI(ChunkTy->getPointerTo(), 2);
+    Current->addIncoming(Chunk, CheckBB);
+    Current->addIncoming(Next, LinkBB);
+    PHINode *Offset = BB.CreatePHI(Type::getInt64Ty(C), 2);
+    Offset->addIncoming(Used, CheckBB);
+    Offset->addIncoming(BB.getInt64(kRegionChunkHeaderSize), LinkBB);
+    BB.CreateStore(BB.CreateAdd(Offset, Size), __RegionUsed);
+    BB.CreateRet(BB.CreateGEP(BB.CreatePointerCast(Current, Type::getInt8PtrTy(C)), Offset));
+  }
+  
+  // Call "regionalloc" function
+  return B.CreateCall(AllocF, Size);
+}
+
+// i8* @regionmark()
+Value * RegionMark(Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * regionmark() {
+   *   return (_region.chunk) ? (char *)_region.chunk + _region.used : NULL;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  InitRegion(M);
+  
+  Function *MarkF = cast<Function>(M->getOrInsertFunction("regionmark", Type::getInt8PtrTy(C),
+                                                          (Type *)0));
+  if (MarkF->empty()) {
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", MarkF);
+    IRBuilder<> EB(EntryBB);
+    
+    Value *Chunk = EB.CreateLoad(__RegionChunk);
+    Value *Position = EB.CreateGEP(EB.CreatePointerCast(Chunk, Type::getInt8PtrTy(C)),
+                                   EB.CreateLoad(__RegionUsed));
+    EB.CreateRet(EB.CreateSelect(EB.CreateIsNull(Chunk),
+                                 ConstantPointerNull::get(Type::getInt8PtrTy(C)), Position));
+  }
+  
+  // Call "regionmark" function
+  return B.CreateCall(MarkF, ArrayRef<Value *>{});
+}
+
+// void @regionreset(i8* %mark)
+void RegionReset(Value *Mark, Module *M, IRBuilder<> &B)
+{
+  /*
+   * void regionreset(char * mark) {
+   *   struct regionchunk * c = _region.chunk;
+   *   while (c && !((char *)c < mark && mark <= (char *)c + c->size)) {
+   *     struct regionchunk * prev = c->prev;
+   *     free(_region.spare);
+   *     _region.spare = c;
+   *     c = prev;
+   *   }
+   *   _region.chunk = c;
+   *   _region.used = (c) ? mark - (char *)c : 0;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  InitRegion(M);
+  
+  Function *ResetF = cast<Function>(M->getOrInsertFunction("regionreset", Type::getVoidTy(C),
+                                                           Type::getInt8PtrTy(C),
+                                                           (Type *)0));
+  if (ResetF->empty()) {
+    Argument *MArg = ResetF->arg_begin();
+    MArg->setName("mark");
+    
+    StructType *ChunkTy = getRegionChunkTy(C);
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", ResetF);
+    BasicBlock *LoopBB = BasicBlock::Create(C, "LoopBlock", ResetF);
+    BasicBlock *CheckBB = BasicBlock::Create(C, "CheckBlock", ResetF);
+    BasicBlock *FreeBB = BasicBlock::Create(C, "FreeBlock", ResetF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", ResetF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *First = EB.CreateLoad(__RegionChunk);
+    Value *MarkAddr = EB.CreatePtrToInt(MArg, Type::getInt64Ty(C));
+    EB.CreateBr(LoopBB);
+    
+    /* Loop Block */
+    IRBuilder<> LB(LoopBB);
+    PHINode *Chunk = LB.CreatePHI(ChunkTy->getPointerTo(), 2, "chunk");
+    Chunk->addIncoming(First, EntryBB);
+    LB.CreateCondBr(LB.CreateIsNull(Chunk), DoneBB, CheckBB);
+    
+    /* Check Block: is |mark| into this chunk? */
+    IRBuilder<> CB(CheckBB);
+    Value *ChunkAddr = CB.CreatePtrToInt(Chunk, Type::getInt64Ty(C));
+    Value *ChunkEnd = CB.CreateAdd(ChunkAddr, CB.CreateLoad(CB.CreateStructGEP(ChunkTy, Chunk, 1)));
+    Value *Inside = CB.CreateAnd(CB.CreateICmpULT(ChunkAddr, MarkAddr), CB.CreateICmpULE(MarkAddr, ChunkEnd));
+    CB.CreateCondBr(Inside, DoneBB, FreeBB);
+    
+    /* Free Block: the chunk becomes the spare one (the previous spare is freed) */
+    IRBuilder<> FB(FreeBB);
+    // void @free(i8*)
+    FunctionType *FreeTy = FunctionType::get(Type::getVoidTy(C),
+                                             ArrayRef<Type *>{ Type::getInt8PtrTy(C) }, false);
+    Function *FreeF = cast<Function>(M->getOrInsertFunction("free", FreeTy));
+    Value *Prev = FB.CreateLoad(FB.CreateStructGEP(ChunkTy, Chunk, 0));
+    FB.CreateCall(FreeF, FB.CreatePointerCast(FB.CreateLoad(__RegionSpare), Type::getInt8PtrTy(C)));
+    FB.CreateStore(Chunk, __RegionSpare);
+    Chunk->addIncoming(Prev, FreeBB);
+    FB.CreateBr(LoopBB);
+    
+    /* Done Block */
+    IRBuilder<> DoneB(DoneBB);
+    DoneB.CreateStore(Chunk, __RegionChunk);
+    Value *Used = DoneB.CreateSub(MarkAddr, DoneB.CreatePtrToInt(Chunk, Type::getInt64Ty(C)));
+    DoneB.CreateStore(DoneB.CreateSelect(DoneB.CreateIsNull(Chunk), DoneB.getInt64(0), Used), __RegionUsed);
+    DoneB.CreateRetVoid();
+  }
+  
+  // Call "regionreset" function
+  B.CreateCall(ResetF, Mark);
+}
+
+// i8* @regionstr(i64 %capacity)
+Value * RegionStr(Value *Capacity, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * regionstr(long capacity) {
+   *   struct strhdr * hdr = (struct strhdr *)regionalloc(sizeof(struct strhdr) + capacity + 1);
+   *   hdr->length = 0; hdr->capacity = capacity;
+   *   hdr->hash = 0; hdr->flags = StringFlagRegion;
+   *   hdr->refcount = 0;
+   *   char * s = (char *)(hdr + 1);
+   *   s[0] = '\0';
+   *   return s;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *NewF = cast<Function>(M->getOrInsertFunction("regionstr", Type::getInt8PtrTy(C),
+                                                         Type::getInt64Ty(C),
+                                                         (Type *)0));
+  if (NewF->empty()) {
+    Argument *CArg = NewF->arg_begin();
+    CArg->setName("capacity");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", NewF);
+    IRBuilder<> EB(EntryBB);
+    
+    Value *Size = EB.CreateAdd(CArg, EB.getInt64(StrHdrSize(C) + 1));
+    Value *AllocPtr = RegionAlloc(Size, M, EB);
+    
+    Value *HdrPtr = EB.CreatePointerCast(AllocPtr, getStrHdrTy(C)->getPointerTo());
+    EB.CreateStore(EB.getInt64(0), EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldLength));
+    EB.CreateStore(CArg, EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldCapacity));
+    EB.CreateStore(EB.getInt32(0), EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldHash));
+    EB.CreateStore(EB.getInt32(StringFlagRegion), EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldFlags));
+    EB.CreateStore(EB.getInt64(0), EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldRefCount));
+    
+    Value *Str = EB.CreateGEP(AllocPtr, EB.getInt64(StrHdrSize(C)));
+    EB.CreateStore(EB.getInt8(0), Str);
+    EB.CreateRet(Str);
+  }
+  
+  // Call "regionstr" function
+  return B.CreateCall(NewF, Capacity);
+}
+
+// i8* @regionstrbuffer(i64 %length, i8* %scratch)
+Value * RegionStrBuffer(Value *Length, Value *Scratch, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * regionstrbuffer(long length, char * scratch) {
+   *   return (length <= kObjectInlineStrMaxLength) ? scratch : regionstr(length);
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *BufferF = cast<Function>(M->getOrInsertFunction("regionstrbuffer", Type::getInt8PtrTy(C),
+                                                            Type::getInt64Ty(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            (Type *)0));
+  if (BufferF->empty()) {
+    Function::arg_iterator it = BufferF->arg_begin();
+    Argument *LArg = it;
+    LArg->setName("length");
+    
+    Argument *SArg = ++it;
+    SArg->setName("scratch");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", BufferF);
+    BasicBlock *ScratchBB = BasicBlock::Create(C, "ScratchBlock", BufferF);
+    BasicBlock *NewBB = BasicBlock::Create(C, "NewBlock", BufferF);
+    
+    IRBuilder<> EB(EntryBB);
+    EB.CreateCondBr(EB.CreateICmpULE(LArg, EB.getInt64(kObjectInlineStrMaxLength)), ScratchBB, NewBB);
+    
+    IRBuilder<> SB(ScratchBB);
+    SB.CreateRet(SArg);
+    
+    IRBuilder<> NB(NewBB);
+    NB.CreateRet(RegionStr(LArg, M, NB));
+  }
+  
+  // Call "regionstrbuffer" function
+  return B.CreateCall(BufferF, ArrayRef<Value *>{ Length, Scratch });
+}
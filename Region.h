@@ -0,0 +1,41 @@
+#ifndef SMIL_REGION_H
+#define SMIL_REGION_H
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+using namespace llvm;
+
+/*
+ * Bump allocator for temporaries (results of binary operators consumed by the same statement):
+ * memory is taken from chunks (malloc'ed) and given back all at once by resetting the region
+ * to a mark, loops reset it at the end of each iteration.
+ *   struct regionchunk { struct regionchunk * prev; long size; }; char data[size - 16];
+ */
+#define kRegionChunkSize (64 * 1024) // Default size of a chunk (with its header)
+
+StructType * getRegionChunkTy(LLVMContext &C);
+
+/* |Size| bytes (8-byte aligned) from the region, valid until the next reset before them */
+// i8* @regionalloc(i64 %size)
+Value * RegionAlloc(Value *Size, Module *M, IRBuilder<> &B);
+
+/* Current position of the region */
+// i8* @regionmark()
+Value * RegionMark(Module *M, IRBuilder<> &B);
+
+/* Give back everything allocated since |Mark| (chunks emptied are freed, the last one is kept as spare) */
+// void @regionreset(i8* %mark)
+void RegionReset(Value *Mark, Module *M, IRBuilder<> &B);
+
+/* New empty string from the region (StringFlagRegion, never counted nor freed, see "StrOwn()") */
+// i8* @regionstr(i64 %capacity)
+Value * RegionStr(Value *Capacity, Module *M, IRBuilder<> &B);
+
+/* Like "StrBuffer()", with a string from the region */
+// i8* @regionstrbuffer(i64 %length, i8* %scratch)
+Value * RegionStrBuffer(Value *Length, Value *Scratch, Module *M, IRBuilder<> &B);
+
+#endif // SMIL_REGION_H
@@ -0,0 +1,209 @@
+#include <stdlib.h>
+
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Runtime.h"
+
+// unsigned char RuntimeLib_bc[]; unsigned int RuntimeLib_bc_len; (generated, see "Makefile")
+#include "RuntimeLib.bc.inc"
+
+void LinkRuntime(Module *M)
+{
+  StringRef Bitcode((const char *)RuntimeLib_bc, RuntimeLib_bc_len);
+  std::unique_ptr<MemoryBuffer> Buffer = MemoryBuffer::getMemBuffer(Bitcode, "RuntimeLib.bc", false);
+  ErrorOr<std::unique_ptr<Module>> Runtime = parseBitcodeFile(Buffer->getMemBufferRef(), M->getContext());
+  if (!Runtime) {
+    errs() << "Invalid runtime bitcode: " << Runtime.getError().message() << "\n";
+    exit(1);
+  }
+  
+  // Compiled by the host compiler, for the same target as the JIT
+  (*Runtime)->setDataLayout(M->getDataLayout());
+  (*Runtime)->setTargetTriple(M->getTargetTriple());
+  
+  // Only the routines used by |M| (and what they use)
+  if (Linker::linkModules(*M, std::move(*Runtime), Linker::Flags::LinkOnlyNeeded)) {
+    errs() << "Cannot link the runtime" << "\n";
+    exit(1);
+  }
+  
+  for (Module::iterator it = M->begin(); it != M->end(); it++) {
+    if (it->isDeclaration())
+      continue;
+    
+    if (it->getName().startswith("smil_rt_"))
+      it->setLinkage(GlobalValue::InternalLinkage);
+    // Generated functions have no target attributes, the inliner needs them to match
+    it->removeFnAttr("target-cpu");
+    it->removeFnAttr("target-features");
+  }
+}
+
+/*** Output ***/
+static OutputSink __OutputSink = OutputSinkStdout;
+static string __OutputPath;
+static int64_t __OutputBufferSize = 0;
+static bool __OutputAsync = false;
+static string __OutputMemory;
+
+/* Host function called by the runtime for the memory sink */
+extern "C" void smil_output_append(const char *bytes, int64_t length)
+{
+  __OutputMemory.append(bytes, length);
+}
+
+/* Close function of the output of the running program, called if it exits before closing it */
+static void (*__OutputClose)(void) = NULL;
+
+static void OutputCloseAtExit()
+{
+  if (__OutputClose)
+    __OutputClose();
+}
+
+/* Host function called by the runtime when the output is opened (|close|) and closed (NULL):
+ * registered with "atexit()" here since the code of the runtime is released with the engine */
+extern "C" void smil_output_atexit(void (*close)(void))
+{
+  static bool registered = false;
+  if (!registered) {
+    atexit(OutputCloseAtExit);
+    registered = true;
+  }
+  __OutputClose = close;
+}
+
+void MapRuntime(ExecutionEngine *EE, Module *M)
+{
+  Function *F;
+  if ((F = M->getFunction("smil_output_append")))
+    EE->addGlobalMapping(F, (void *)&smil_output_append);
+  if ((F = M->getFunction("smil_output_atexit")))
+    EE->addGlobalMapping(F, (void *)&smil_output_atexit);
+}
+
+void SetOutputSink(OutputSink sink, const string &path, int64_t bufferSize, bool async)
+{
+  __OutputSink = sink;
+  __OutputPath = path;
+  __OutputBufferSize = bufferSize;
+  __OutputAsync = async;
+}
+
+const string & OutputMemory()
+{
+  return __OutputMemory;
+}
+
+// void @smil_rt_output_open(i32 %sink, i8* %path, i64 %capacity, i32 %async)
+void RuntimeOutputOpen(Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *OpenF = cast<Function>(M->getOrInsertFunction("smil_rt_output_open", Type::getVoidTy(C),
+                                                          Type::getInt32Ty(C),
+                                                          Type::getInt8PtrTy(C),
+                                                          Type::getInt64Ty(C),
+                                                          Type::getInt32Ty(C),
+                                                          (Type *)0));
+  Value *Path = B.CreatePointerCast(B.CreateGlobalString(__OutputPath, "output.path"), Type::getInt8PtrTy(C));
+  B.CreateCall(OpenF, ArrayRef<Value *>{ B.getInt32(__OutputSink), Path, B.getInt64(__OutputBufferSize),
+                                         B.getInt32(__OutputAsync) });
+}
+
+// void @smil_rt_output_close()
+void RuntimeOutputClose(Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *CloseF = cast<Function>(M->getOrInsertFunction("smil_rt_output_close", Type::getVoidTy(C),
+                                                           (Type *)0));
+  B.CreateCall(CloseF, ArrayRef<Value *>{});
+}
+
+// void @smil_rt_write(i8* %buffer, i64 %length)
+void RuntimeWrite(Value *Buffer, Value *Length, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *WriteF = cast<Function>(M->getOrInsertFunction("smil_rt_write", Type::getVoidTy(C),
+                                                           Type::getInt8PtrTy(C),
+                                                           Type::getInt64Ty(C),
+                                                           (Type *)0));
+  B.CreateCall(WriteF, ArrayRef<Value *>{ Buffer, Length });
+}
+
+// void @smil_rt_flush()
+void RuntimeFlush(Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *FlushF = cast<Function>(M->getOrInsertFunction("smil_rt_flush", Type::getVoidTy(C),
+                                                           (Type *)0));
+  B.CreateCall(FlushF, ArrayRef<Value *>{});
+}
+
+// void @smil_rt_report(i8* %format, i32 %line, i32 %col, i8* %message)
+void RuntimeReport(Value *Format, Value *LineV, Value *ColV, Value *Message, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *ReportF = cast<Function>(M->getOrInsertFunction("smil_rt_report", Type::getVoidTy(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            Type::getInt32Ty(C),
+                                                            Type::getInt32Ty(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            (Type *)0));
+  B.CreateCall(ReportF, ArrayRef<Value *>{ Format, LineV, ColV, Message });
+}
+
+/*** Formatting and strings ***/
+// i64 @smil_rt_intlen(i64 %value)
+Value * RuntimeIntLength(Value *Int, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *LenF = cast<Function>(M->getOrInsertFunction("smil_rt_intlen", Type::getInt64Ty(C),
+                                                         Type::getInt64Ty(C),
+                                                         (Type *)0));
+  return B.CreateCall(LenF, Int);
+}
+
+// i64 @smil_rt_itoa(i64 %value, i8* %buffer)
+Value * RuntimeIntToBuffer(Value *Int, Value *Buffer, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *ItoaF = cast<Function>(M->getOrInsertFunction("smil_rt_itoa", Type::getInt64Ty(C),
+                                                          Type::getInt64Ty(C),
+                                                          Type::getInt8PtrTy(C),
+                                                          (Type *)0));
+  return B.CreateCall(ItoaF, ArrayRef<Value *>{ Int, Buffer });
+}
+
+// i8* @smil_rt_itos(i64 %value)
+Value * RuntimeIntToStr(Value *Int, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *ItosF = cast<Function>(M->getOrInsertFunction("smil_rt_itos", Type::getInt8PtrTy(C),
+                                                          Type::getInt64Ty(C),
+                                                          (Type *)0));
+  return B.CreateCall(ItosF, Int);
+}
+
+// i8* @smil_rt_strxch(i8* %str, i8* %occurrence)
+Value * RuntimeStrxch(Value *StrV, Value *Occurence, Module *M, IRBuilder<> &B)
+{
+  LLVMContext &C = M->getContext();
+  
+  Function *StrxchF = cast<Function>(M->getOrInsertFunction("smil_rt_strxch", Type::getInt8PtrTy(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            (Type *)0));
+  return B.CreateCall(StrxchF, ArrayRef<Value *>{ StrV, Occurence });
+}
+
@@ -0,0 +1,93 @@
+#ifndef SMIL_RUNTIME_H
+#define SMIL_RUNTIME_H
+
+#include <stdint.h>
+
+/*
+ * Output of the generated program: buffered by the runtime, written to the sink when full (with
+ * the bytes that didn't fit, in one "writev()"), at exit, and before assertion messages exit.
+ * With asynchronous output, the buffer is queued instead to a thread writing to the sink, so the
+ * program only waits when the queue is full (at kOutputRingSize bytes) and before it exits.
+ */
+#define kOutputBufferSize (64 * 1024) // Default size of the output buffer (bytes)
+#define kOutputRingSize (1024 * 1024) // Bytes queued for the writer thread at most (power of two)
+
+enum OutputSink {
+  OutputSinkStdout = 0,
+  OutputSinkFile, // Path given to "SetOutputSink()"
+  OutputSinkMemory // Kept by the compiler, for embedding (see "OutputMemory()")
+};
+
+#ifndef SMIL_RUNTIME_LIB // Shared with the runtime library for the constants above only
+
+#include <string>
+
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+using namespace std;
+using namespace llvm;
+
+/*
+ * Runtime routines written in C++ ("RuntimeLib.cpp"), compiled to bitcode at build time and
+ * embedded into the compiler ("RuntimeLib.bc.inc"). The generated code calls them by name
+ * (prefixed by "smil_rt_"), they are linked into the module before optimization so they can be
+ * inlined like any generated function.
+ */
+
+/* Link the runtime routines used by |M| (with internal linkage), exit on invalid bitcode */
+void LinkRuntime(Module *M);
+
+/* Map the host functions used by the runtime (see "BigInt.h" for big integers) */
+void MapRuntime(ExecutionEngine *EE, Module *M);
+
+/* Sink of the output for the programs generated next, |bufferSize| is 0 for the default size,
+ * written by a thread if |async| */
+void SetOutputSink(OutputSink sink, const string &path = "", int64_t bufferSize = 0, bool async = false);
+
+/* Bytes written so far to OutputSinkMemory */
+const string & OutputMemory();
+
+/* Select the sink set by "SetOutputSink()", at the start of the program */
+// void @smil_rt_output_open(i32 %sink, i8* %path, i64 %capacity, i32 %async)
+void RuntimeOutputOpen(Module *M, IRBuilder<> &B);
+
+/* Write all the output and close the sink (waiting for the writer thread), before the program ends */
+// void @smil_rt_output_close()
+void RuntimeOutputClose(Module *M, IRBuilder<> &B);
+
+/* Write the buffered output (written when it returns, even if asynchronous) */
+// void @smil_rt_flush()
+void RuntimeFlush(Module *M, IRBuilder<> &B);
+
+/* Message |Format| (i8*, with "%d" for the line, "%d" for the column then "%s" for |Message|),
+ * written and flushed */
+// void @smil_rt_report(i8* %format, i32 %line, i32 %col, i8* %message)
+void RuntimeReport(Value *Format, Value *LineV, Value *ColV, Value *Message, Module *M, IRBuilder<> &B);
+
+/* Number of characters of the decimal form of the integer |Int| (i64) */
+// i64 @smil_rt_intlen(i64 %value)
+Value * RuntimeIntLength(Value *Int, Module *M, IRBuilder<> &B);
+
+/* Write the decimal form of the integer |Int| (i64) to |Buffer| (not NUL-terminated), return its length */
+// i64 @smil_rt_itoa(i64 %value, i8* %buffer)
+Value * RuntimeIntToBuffer(Value *Int, Value *Buffer, Module *M, IRBuilder<> &B);
+
+/* Decimal string of the integer |Int| (i64), owned by the caller */
+// i8* @smil_rt_itos(i64 %value)
+Value * RuntimeIntToStr(Value *Int, Module *M, IRBuilder<> &B);
+
+/* Copy of |StrV| without any occurrence of |Occurence|, owned by the caller */
+// i8* @smil_rt_strxch(i8* %str, i8* %occurrence)
+Value * RuntimeStrxch(Value *StrV, Value *Occurence, Module *M, IRBuilder<> &B);
+
+/* Append |Length| (i64) bytes of |Buffer| to the output */
+// void @smil_rt_write(i8* %buffer, i64 %length)
+void RuntimeWrite(Value *Buffer, Value *Length, Module *M, IRBuilder<> &B);
+
+#endif // SMIL_RUNTIME_LIB
+
+#endif // SMIL_RUNTIME_H
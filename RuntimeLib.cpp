@@ -0,0 +1,397 @@
+/*
+ * Runtime library, compiled to bitcode at build time (see "Makefile") and linked into each
+ * module (see "LinkRuntime()"), so it must not depend on the compiler (nor on LLVM).
+ */
+#define SMIL_RUNTIME_LIB
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Runtime.h" // For the kOutput* constants only (no code from the compiler)
+
+/* Same layout as "strhdr" (see "getStrHdrTy()") */
+struct StrHeader {
+  int64_t length;
+  int64_t capacity;
+  uint32_t hash;
+  uint32_t flags;
+  int64_t refcount;
+};
+
+static inline StrHeader * Header(char *s)
+{
+  return (StrHeader *)s - 1;
+}
+
+/* Same as "@newstr": a new empty string with room for |capacity| bytes, with one owner */
+static char * NewString(int64_t capacity)
+{
+  StrHeader *hdr = (StrHeader *)malloc(sizeof(StrHeader) + capacity + 1);
+  hdr->length = 0;
+  hdr->capacity = capacity;
+  hdr->hash = 0;
+  hdr->flags = 0;
+  hdr->refcount = 1;
+
+  char *s = (char *)(hdr + 1);
+  s[0] = '\0';
+  return s;
+}
+
+static const uint64_t kPowersOf10[20] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+  1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static const char kDigitPairs[201] =
+  "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+  "40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+  "80818283848586878889" "90919293949596979899";
+
+extern "C" {
+
+/* Number of characters of the decimal form of |value| (with its sign) */
+int64_t smil_rt_intlen(int64_t value)
+{
+  uint64_t n = (value < 0) ? -(uint64_t)value : (uint64_t)value;
+  // log10 from the number of bits (1233 / 4096 ~ log10(2)), corrected by one comparison
+  // (|n| and |n| | 1 have the same number of digits)
+  uint64_t m = n | 1;
+  int t = ((64 - __builtin_clzll(m)) * 1233) >> 12;
+  return t + 1 - (m < kPowersOf10[t]) + (value < 0);
+}
+
+/* Write the decimal form of |value| to |buffer| (not NUL-terminated), return its length */
+int64_t smil_rt_itoa(int64_t value, char *buffer)
+{
+  uint64_t n = (value < 0) ? -(uint64_t)value : (uint64_t)value;
+  int64_t length = smil_rt_intlen(value);
+
+  // From the end, two digits at a time
+  char *p = buffer + length;
+  while (n >= 100) {
+    unsigned i = (n % 100) * 2;
+    n /= 100;
+    p -= 2;
+    memcpy(p, kDigitPairs + i, 2);
+  }
+  if (n >= 10) {
+    p -= 2;
+    memcpy(p, kDigitPairs + n * 2, 2);
+  } else {
+    *--p = '0' + n;
+  }
+  if (value < 0)
+    buffer[0] = '-';
+  return length;
+}
+
+/* Decimal string of |value|, owned by the caller */
+char * smil_rt_itos(int64_t value)
+{
+  char *s = NewString(smil_rt_intlen(value));
+  int64_t length = smil_rt_itoa(value, s);
+  s[length] = '\0';
+
+  Header(s)->length = length;
+  return s;
+}
+
+/* Copy of |s| without any occurrence of |occurrence| (a copy of |s| if empty), owned by the caller */
+char * smil_rt_strxch(const char *s, const char *occurrence)
+{
+  size_t length = strlen(s), occLength = strlen(occurrence);
+  char *output = NewString(length);
+  char *p = output;
+
+  if (occLength > 0) {
+    const char *match;
+    while ((match = strstr(s, occurrence))) {
+      memcpy(p, s, match - s);
+      p += match - s;
+      s = match + occLength;
+    }
+    length = strlen(s);
+  }
+  memcpy(p, s, length);
+  p += length;
+  *p = '\0';
+
+  Header(output)->length = p - output;
+  return output;
+}
+
+/*** Output ***/
+/* Bytes of the memory sink are kept by the compiler (see "MapRuntime()") */
+void smil_output_append(const char *bytes, int64_t length);
+/* Close the output at exit (exits from the host too), until it is closed (see "MapRuntime()") */
+void smil_output_atexit(void (*close)(void));
+
+static struct {
+  char *buffer;
+  int64_t capacity;
+  int64_t length;
+  int32_t sink;
+  int fd;
+  int async; // Drained to the ring of the writer thread (see below)
+} Output = { NULL, 0, 0, OutputSinkStdout, 1, 0 };
+
+/* Write all |count| buffers of |iov| to |fd| (|iov| is modified) */
+static void WriteAll(int fd, struct iovec *iov, int count)
+{
+  while (count > 0) {
+    ssize_t written = writev(fd, iov, count);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      break; // Closed or full, the output is lost (like stdio)
+    }
+    // Skip what was written (partial writes on pipes)
+    while (count > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++, count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+/*
+ * Asynchronous output: the program (the only producer) copies the drained bytes into a ring of
+ * kOutputRingSize bytes, written to the file descriptor by a writer thread (the only consumer).
+ * |head| (bytes enqueued) is only stored by the producer, |tail| (bytes written) by the writer,
+ * so neither side takes a lock while the ring is neither full nor empty; a side that must wait
+ * (full ring for the producer, empty ring for the writer) sleeps on |cond|, and is woken up by
+ * the other side if |sleeping|.
+ */
+static struct {
+  char *data; // kOutputRingSize bytes
+  int64_t head;
+  int64_t tail;
+  int32_t closing; // Set by the producer, the writer exits once the ring is empty
+  int32_t sleeping;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+} Ring;
+
+static inline int64_t RingLoad(int64_t *index)
+{
+  return __atomic_load_n(index, __ATOMIC_SEQ_CST);
+}
+
+static void RingWake(void)
+{
+  if (__atomic_load_n(&Ring.sleeping, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&Ring.lock);
+    pthread_cond_broadcast(&Ring.cond);
+    pthread_mutex_unlock(&Ring.lock);
+  }
+}
+
+/* Sleep until |done()| (checked again after |sleeping| is set, so no wake up is missed) */
+static void RingWait(bool (*done)(void))
+{
+  pthread_mutex_lock(&Ring.lock);
+  __atomic_add_fetch(&Ring.sleeping, 1, __ATOMIC_SEQ_CST);
+  while (!done())
+    pthread_cond_wait(&Ring.cond, &Ring.lock);
+  __atomic_sub_fetch(&Ring.sleeping, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&Ring.lock);
+}
+
+static bool RingHasBytes(void)
+{
+  return RingLoad(&Ring.head) != RingLoad(&Ring.tail) || __atomic_load_n(&Ring.closing, __ATOMIC_SEQ_CST);
+}
+
+static bool RingHasRoom(void)
+{
+  return RingLoad(&Ring.head) - RingLoad(&Ring.tail) < kOutputRingSize;
+}
+
+static bool RingIsEmpty(void)
+{
+  return RingLoad(&Ring.head) == RingLoad(&Ring.tail);
+}
+
+static void * RingWriter(void *)
+{
+  for (;;) {
+    // |closing| is loaded before |head|: the producer enqueues its last bytes before setting it
+    int32_t closing = __atomic_load_n(&Ring.closing, __ATOMIC_SEQ_CST);
+    int64_t tail = Ring.tail, head = RingLoad(&Ring.head);
+    if (head == tail) {
+      if (closing)
+        break;
+      RingWait(RingHasBytes);
+      continue;
+    }
+
+    // The pending bytes, in two parts if they wrap around
+    int64_t offset = tail & (kOutputRingSize - 1), length = head - tail;
+    int64_t first = (length < kOutputRingSize - offset) ? length : kOutputRingSize - offset;
+    struct iovec iov[2] = {
+      { Ring.data + offset, (size_t)first },
+      { Ring.data, (size_t)(length - first) }
+    };
+    WriteAll(Output.fd, iov, (length > first) ? 2 : 1);
+
+    __atomic_store_n(&Ring.tail, head, __ATOMIC_SEQ_CST);
+    RingWake();
+  }
+  return NULL;
+}
+
+/* Enqueue |length| bytes of |bytes|, waiting for the writer while the ring is full */
+static void RingPush(const char *bytes, int64_t length)
+{
+  while (length > 0) {
+    int64_t head = Ring.head, room = kOutputRingSize - (head - RingLoad(&Ring.tail));
+    if (room == 0) {
+      RingWait(RingHasRoom);
+      continue;
+    }
+
+    int64_t count = (length < room) ? length : room;
+    int64_t offset = head & (kOutputRingSize - 1);
+    int64_t first = (count < kOutputRingSize - offset) ? count : kOutputRingSize - offset;
+    memcpy(Ring.data + offset, bytes, first);
+    memcpy(Ring.data, bytes + first, count - first);
+
+    __atomic_store_n(&Ring.head, head + count, __ATOMIC_SEQ_CST);
+    RingWake();
+    bytes += count, length -= count;
+  }
+}
+
+/* Write the pending bytes, then |length| bytes of |bytes| (if any), in one call if possible */
+static void OutputDrain(const char *bytes, int64_t length)
+{
+  if (Output.sink == OutputSinkMemory) {
+    smil_output_append(Output.buffer, Output.length);
+    if (length)
+      smil_output_append(bytes, length);
+  } else if (Output.async) {
+    RingPush(Output.buffer, Output.length);
+    RingPush(bytes, length);
+  } else {
+    struct iovec iov[2] = {
+      { Output.buffer, (size_t)Output.length },
+      { (void *)bytes, (size_t)length }
+    };
+    WriteAll(Output.fd, iov, (length) ? 2 : 1);
+  }
+  Output.length = 0;
+}
+
+/* Write all the output, stop the writer thread and close the sink (opened again on next write) */
+void smil_rt_output_close(void)
+{
+  if (Output.buffer) {
+    OutputDrain(NULL, 0);
+    free(Output.buffer);
+    Output.buffer = NULL;
+  }
+  if (Output.async) {
+    __atomic_store_n(&Ring.closing, 1, __ATOMIC_SEQ_CST);
+    RingWake();
+    pthread_join(Ring.thread, NULL);
+    free(Ring.data);
+    Output.async = 0;
+  }
+  if (Output.fd > 2)
+    close(Output.fd);
+  Output.fd = 1;
+  smil_output_atexit(NULL);
+}
+
+/* Select the sink (|path| for OutputSinkFile) with a buffer of |capacity| bytes,
+ * the standard output if the file can't be opened; written by a thread if |async| */
+void smil_rt_output_open(int32_t sink, const char *path, int64_t capacity, int32_t async)
+{
+  smil_rt_output_close();
+
+  Output.sink = sink;
+  if (sink == OutputSinkFile) {
+    Output.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (Output.fd < 0) {
+      fprintf(stderr, "Cannot open \"%s\" for output, using the standard output\n", path);
+      Output.sink = OutputSinkStdout;
+      Output.fd = 1;
+    }
+  }
+
+  Output.capacity = (capacity > 0) ? capacity : kOutputBufferSize;
+  Output.buffer = (char *)malloc(Output.capacity);
+  Output.length = 0;
+  smil_output_atexit(smil_rt_output_close);
+
+  // The memory sink is already asynchronous for the program
+  if (async && Output.sink != OutputSinkMemory) {
+    Ring.data = (char *)malloc(kOutputRingSize);
+    Ring.head = Ring.tail = 0;
+    Ring.closing = Ring.sleeping = 0;
+    pthread_mutex_init(&Ring.lock, NULL);
+    pthread_cond_init(&Ring.cond, NULL);
+    Output.async = (pthread_create(&Ring.thread, NULL, RingWriter, NULL) == 0);
+    if (!Output.async)
+      free(Ring.data); // Written synchronously
+  }
+}
+
+/* Append |length| bytes of |bytes| to the output */
+void smil_rt_write(const char *bytes, int64_t length)
+{
+  if (!Output.buffer)
+    smil_rt_output_open(OutputSinkStdout, NULL, kOutputBufferSize, 0);
+
+  if (Output.length + length <= Output.capacity) {
+    memcpy(Output.buffer + Output.length, bytes, length);
+    Output.length += length;
+  } else {
+    OutputDrain(bytes, length);
+  }
+}
+
+/* Write the pending bytes to the sink (once written by the writer thread if asynchronous) */
+void smil_rt_flush(void)
+{
+  if (Output.length)
+    OutputDrain(NULL, 0);
+  if (Output.async && !RingIsEmpty())
+    RingWait(RingIsEmpty);
+}
+
+/* Write the message |format| (with "%d" for |line|, "%d" for |col| and "%s" for |message|)
+ * to the output, then flush (the program exits after an assertion) */
+void smil_rt_report(const char *format, int32_t line, int32_t col, const char *message)
+{
+  char stackBuffer[256];
+  int length = snprintf(stackBuffer, sizeof(stackBuffer), format, line, col, message);
+  if (length < 0)
+    return;
+
+  char *buffer = stackBuffer;
+  if ((size_t)length >= sizeof(stackBuffer)) {
+    buffer = (char *)malloc(length + 1);
+    snprintf(buffer, length + 1, format, line, col, message);
+  }
+  smil_rt_write(buffer, length);
+  smil_rt_flush();
+  if (buffer != stackBuffer)
+    free(buffer);
+}
+
+}
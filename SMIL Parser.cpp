@@ -1,4 +1,6 @@
 #include <iostream>
+#include <cerrno>
+#include <cstdlib>
 #include <sstream>
 #include <fstream>
 #include <string>
@@ -24,8 +26,10 @@
 #include "llvm/Support/Host.h"
 
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/IPO.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/IR/LegacyPassManager.h"
 
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/LLVMContext.h"
@@ -37,10 +41,15 @@
 #include "Parser.h"
 #include "Token.h"
 #include "ObjectType.h"
+#include "StringType.h"
+#include "RefCount.h"
+#include "Intern.h"
+#include "BigInt.h"
 #include "Expr.h"
 #include "CodeGen.h"
 #include "HashTable.h"
 #include "Utilities.h"
+#include "Runtime.h"
 
 using namespace std;
 using namespace llvm;
@@ -67,12 +76,46 @@ bool parseBoolArg(char **argv[], int *argc, const char *flag)
   return flagExists;
 }
 
+/* The value following |flag| (removed with it from |argv|), |defaultValue| if not found */
+string parseStringArg(char **argv[], int *argc, const char *flag, const string &defaultValue)
+{
+  string value = defaultValue;
+  for (int i = 0; i < *argc - 1; i++) {
+    
+    if (strcmp((*argv)[i], flag) == 0) {
+      value = (*argv)[i+1];
+      
+      *argc -= 2;
+      memmove(*argv + i,
+              *argv + (i+2),
+              sizeof(char *) * (*argc - i));
+      i--;
+    }
+  }
+  return value;
+}
+
 int main(int argc, char *argv[]) {
   
   // Active verbose mode if the "-v" flag is found
   bool verbose = parseBoolArg(&argv, &argc, "-v"); // @TODO: use "cl::ParseCommandLineOptions(...)" instead
   setOutEnabled(verbose);
   
+  // Write the program output to a file with "--output <path>" (the standard output else),
+  // buffered by "--output-buffer <bytes>" bytes, and written by a thread with "--async-output" (see "Runtime.h")
+  string outputPath = parseStringArg(&argv, &argc, "--output", "");
+  string outputBuffer = parseStringArg(&argv, &argc, "--output-buffer", "0");
+  char *end = NULL;
+  errno = 0;
+  long long outputBufferSize = strtoll(outputBuffer.c_str(), &end, 10);
+  if (outputBuffer.empty() || *end != '\0' || errno == ERANGE
+      || outputBufferSize < 0 || outputBufferSize > (1LL << 30)) { // Zero for the default size, up to 1 GiB
+    errs() << "Invalid output buffer size: " << outputBuffer << "\n";
+    exit(1);
+  }
+  bool outputAsync = parseBoolArg(&argv, &argc, "--async-output");
+  SetOutputSink(outputPath.empty() ? OutputSinkStdout : OutputSinkFile, outputPath, outputBufferSize, outputAsync);
+  
   const char * filename = argv[1];
   ifstream file(filename, ios::in);
   
@@ -103,6 +146,9 @@ int main(int argc, char *argv[]) {
   IRBuilder<> B(BB);
   B.SetInsertPoint(BB);
   
+  // Open the output first, assertions write to it
+  RuntimeOutputOpen(M, B);
+  
   // Throw a "SMILMissingInput" exception (|Argc| < the highest input expr)
   static Value *GMissingInputsAssertMessage = NULL;
   if (!GMissingInputsAssertMessage) {
@@ -115,8 +161,8 @@ int main(int argc, char *argv[]) {
   CreateAssert(CondV, GMissingInputsAssertMessage,
                M, B, 0, 0);
   
-  /* Init the hash table for variables */
-  InitVarTable(M);
+  /* Init the hash table for variables (names from the source, and inputs) */
+  InitVarTable(M, VarExpr::getNamesCount() + InputExpr::getIndexesCount());
   
   /* Fetch input arguments */
   Value *CounterPtr = B.CreateAlloca(Type::getInt32Ty(C));
@@ -153,13 +199,16 @@ int main(int argc, char *argv[]) {
   
   Value *Length = Strlen(InputName, M, LoopB);
   Value *Size = LoopB.CreateAdd(Length, LoopB.getInt64(1));
-  Value *Name = CastToCStr(B.CreateAlloca(Type::getInt8Ty(C), Size), LoopB);
-  MemCpy(Name, InputName, Size, M, LoopB);
+  // Keys of the table are strings with a header
+  Value *Name = NewStr(Length, M, LoopB);
+  MemCpy(Name, InputName, Size, M, LoopB, 1);
+  SetStrLength(Name, Length, LoopB);
   
   // Insert the variable
   Value *Arg = LoopB.CreateGEP(Argv, Counter);
   Value *V = ValToObj(LoopB.CreateLoad(Arg), M, LoopB);
-  InsertOrUpdate(Name, V, M, LoopB);
+  InsertOrUpdate(Intern(Name, M, LoopB), V, M, LoopB);
+  StrRelease(Name, M, LoopB); // Nothing if taken by the intern table
   
   LoopB.CreateStore(LoopB.CreateAdd(Counter, LoopB.getInt32(1)),
                     CounterPtr);
@@ -185,6 +234,8 @@ int main(int argc, char *argv[]) {
     }
   }
   
+  // Write what remains buffered (and stop the writer thread)
+  RuntimeOutputClose(M, B);
   B.CreateRet(B.getInt32(0));
   
   InitializeNativeTarget();
@@ -208,14 +259,40 @@ int main(int argc, char *argv[]) {
   const DataLayout *DL = EE->getDataLayout();
   M->setDataLayout(DL->getStringRepresentation());
   
+  // Runtime routines written in C++ (see "Runtime.h"), with the data layout of the module
+  LinkRuntime(M);
+  
   ModulePassManager *MPM = new ModulePassManager();
   MPM->run(*M);
+  
+  // Remove redundant reference counting (loads merged first to match retain/release pairs)
+  legacy::FunctionPassManager FPM(M);
+  FPM.add(createEarlyCSEPass());
+  FPM.add(createRefCountElisionPass());
+  FPM.doInitialization();
+  for (Module::iterator it = M->begin(); it != M->end(); it++) {
+    if (!it->isDeclaration())
+      FPM.run(*it);
+  }
+  FPM.doFinalization();
+  
+  // Inline the runtime routines (and small generated functions) into their callers
+  legacy::PassManager IPM;
+  IPM.add(createFunctionInliningPass());
+  IPM.add(createGlobalDCEPass());
+  IPM.run(*M);
 	
   out() << "\n" << "=== IR Dump ===" << "\n";
   if (verbose) {
     M->dump();
   }
   
+  // Big integers are computed by host functions (see "BigInt.h")
+  MapBigIntRuntime(EE, M);
+  
+  // The memory sink of the output is kept by the host (see "Runtime.h")
+  MapRuntime(EE, M);
+  
 #if __MCJIT__
   EE->finalizeObject();
 #endif
@@ -226,6 +303,9 @@ int main(int argc, char *argv[]) {
   Args[1].PointerVal = argv+2; // *argv[];
   
   out() << "\n" << "=== Program Output ===" << "\n";
+  // The program writes to the file descriptor directly, after what was written by the host
+  out().flush();
+  fflush(stdout);
   GenericValue gv = EE->runFunction(MainF, Args);
 	
   // Clean up and shutdown
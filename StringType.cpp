@@ -0,0 +1,467 @@
+#include "StringType.h"
+#include "ObjectType.h"
+#include "Utilities.h"
+
+StructType * getStrHdrTy(LLVMContext &C)
+{
+  static StructType *Ty = NULL;
+  if (!Ty) {
+    /* struct strhdr { long length; long capacity; unsigned hash; unsigned flags; long refcount; }; */
+    Ty = StructType::create("strhdr",
+                            Type::getInt64Ty(C),
+                            Type::getInt64Ty(C),
+                            Type::getInt32Ty(C),
+                            Type::getInt32Ty(C),
+                            Type::getInt64Ty(C), NULL);
+  }
+  return Ty;
+}
+
+/* Return the size (in bytes) of the "strhdr" type */
+unsigned StrHdrSize(LLVMContext &C)
+{
+  return 8 + 8 + 4 + 4 + 8; // No padding (the bytes follow at an 8-byte boundary)
+}
+
+Value * StrHeader(Value *Str, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  Value *HdrPtr = B.CreateGEP(Str, B.getInt64(-(int64_t)StrHdrSize(C)));
+  return B.CreatePointerCast(HdrPtr, getStrHdrTy(C)->getPointerTo());
+}
+
+Value * StrLength(Value *Str, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  return B.CreateLoad(B.CreateStructGEP(getStrHdrTy(C), StrHeader(Str, B), StrHdrFieldLength));
+}
+
+void SetStrLength(Value *Str, Value *Length, IRBuilder<> &B)
+{
+  LLVMContext &C = B.getContext();
+  B.CreateStore(Length, B.CreateStructGEP(getStrHdrTy(C), StrHeader(Str, B), StrHdrFieldLength));
+}
+
+// i8* @newstr(i64 %capacity)
+Value * NewStr(Value *Capacity, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * newstr(long capacity) {
+   *   struct strhdr * hdr = (struct strhdr *)malloc(sizeof(struct strhdr) + capacity + 1);
+   *   hdr->length = 0; hdr->capacity = capacity;
+   *   hdr->hash = 0; hdr->flags = 0;
+   *   hdr->refcount = 1;
+   *   char * s = (char *)(hdr + 1);
+   *   s[0] = '\0';
+   *   return s;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *NewF = cast<Function>(M->getOrInsertFunction("newstr", Type::getInt8PtrTy(C),
+                                                         Type::getInt64Ty(C),
+                                                         (Type *)0));
+  if (NewF->empty()) {
+    Argument *CArg = NewF->arg_begin();
+    CArg->setName("capacity");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", NewF);
+    IRBuilder<> EB(EntryBB);
+    
+    // i8* @malloc(i64)
+    FunctionType *MallocTy = FunctionType::get(Type::getInt8PtrTy(C),
+                                               ArrayRef<Type *>{ Type::getInt64Ty(C) }, false);
+    Function *MallocF = cast<Function>(M->getOrInsertFunction("malloc", MallocTy));
+    Value *Size = EB.CreateAdd(CArg, EB.getInt64(StrHdrSize(C) + 1));
+    Value *AllocPtr = EB.CreateCall(MallocF, Size);
+    
+    Value *HdrPtr = EB.CreatePointerCast(AllocPtr, getStrHdrTy(C)->getPointerTo());
+    EB.CreateStore(EB.getInt64(0), EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldLength));
+    EB.CreateStore(CArg, EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldCapacity));
+    EB.CreateStore(EB.getInt32(0), EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldHash));
+    EB.CreateStore(EB.getInt32(0), EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldFlags));
+    EB.CreateStore(EB.getInt64(1), EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldRefCount));
+    
+    Value *Str = EB.CreateGEP(AllocPtr, EB.getInt64(StrHdrSize(C)));
+    EB.CreateStore(EB.getInt8(0), Str);
+    EB.CreateRet(Str);
+  }
+  
+  // Call "newstr" function
+  return B.CreateCall(NewF, Capacity);
+}
+
+// i8* @strbuffer(i64 %length, i8* %scratch)
+Value * StrBuffer(Value *Length, Value *Scratch, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * strbuffer(long length, char * scratch) {
+   *   return (length <= kObjectInlineStrMaxLength) ? scratch : newstr(length);
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *BufferF = cast<Function>(M->getOrInsertFunction("strbuffer", Type::getInt8PtrTy(C),
+                                                            Type::getInt64Ty(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            (Type *)0));
+  if (BufferF->empty()) {
+    Function::arg_iterator it = BufferF->arg_begin();
+    Argument *LArg = it;
+    LArg->setName("length");
+    
+    Argument *SArg = ++it;
+    SArg->setName("scratch");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", BufferF);
+    BasicBlock *ScratchBB = BasicBlock::Create(C, "ScratchBlock", BufferF);
+    BasicBlock *NewBB = BasicBlock::Create(C, "NewBlock", BufferF);
+    
+    IRBuilder<> EB(EntryBB);
+    EB.CreateCondBr(EB.CreateICmpULE(LArg, EB.getInt64(kObjectInlineStrMaxLength)), ScratchBB, NewBB);
+    
+    IRBuilder<> SB(ScratchBB);
+    SB.CreateRet(SArg);
+    
+    IRBuilder<> NB(NewBB);
+    NB.CreateRet(NewStr(LArg, M, NB));
+  }
+  
+  // Call "strbuffer" function
+  return B.CreateCall(BufferF, ArrayRef<Value *>{ Length, Scratch });
+}
+
+// i8* @strappend(i8* %str, i8* %src, i64 %length)
+Value * StrAppend(Value *Str, Value *Src, Value *Length, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * strappend(char * s, const char * src, long n) {
+   *   struct strhdr * hdr = header(s);
+   *   long length = hdr->length + n;
+   *   if (length > hdr->capacity) {
+   *     long capacity = max(hdr->capacity * 2, length);
+   *     hdr = (struct strhdr *)realloc(hdr, sizeof(struct strhdr) + capacity + 1);
+   *     hdr->capacity = capacity;
+   *     s = (char *)(hdr + 1);
+   *   }
+   *   memcpy(s + hdr->length, src, n);
+   *   s[length] = '\0';
+   *   hdr->length = length;
+   *   hdr->flags &= ~StringFlagHashed;
+   *   return s;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *AppendF = cast<Function>(M->getOrInsertFunction("strappend", Type::getInt8PtrTy(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            Type::getInt8PtrTy(C),
+                                                            Type::getInt64Ty(C),
+                                                            (Type *)0));
+  if (AppendF->empty()) {
+    Function::arg_iterator it = AppendF->arg_begin();
+    Argument *SArg = it;
+    SArg->setName("str");
+    
+    Argument *SrcArg = ++it;
+    SrcArg->setName("src");
+    
+    Argument *LArg = ++it;
+    LArg->setName("length");
+    
+    StructType *HdrTy = getStrHdrTy(C);
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", AppendF);
+    BasicBlock *GrowBB = BasicBlock::Create(C, "GrowBlock", AppendF);
+    BasicBlock *CopyBB = BasicBlock::Create(C, "CopyBlock", AppendF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *HdrPtr = StrHeader(SArg, EB);
+    Value *OldLength = EB.CreateLoad(EB.CreateStructGEP(HdrTy, HdrPtr, StrHdrFieldLength));
+    Value *Capacity = EB.CreateLoad(EB.CreateStructGEP(HdrTy, HdrPtr, StrHdrFieldCapacity));
+    Value *NewLength = EB.CreateAdd(OldLength, LArg, "newLength");
+    EB.CreateCondBr(EB.CreateICmpSGT(NewLength, Capacity), GrowBB, CopyBB);
+    
+    /* Grow Block: amortized doubling */
+    IRBuilder<> GB(GrowBB);
+    
+    // i8* @realloc(i8*, i64)
+    Type* ReallocArgs[] = { Type::getInt8PtrTy(C), Type::getInt64Ty(C) };
+    FunctionType *ReallocTy = FunctionType::get(Type::getInt8PtrTy(C), ReallocArgs, false);
+    Function *ReallocF = cast<Function>(M->getOrInsertFunction("realloc", ReallocTy));
+    
+    Value *Doubled = GB.CreateMul(Capacity, GB.getInt64(2));
+    Value *NewCapacity = GB.CreateSelect(GB.CreateICmpSGT(Doubled, NewLength), Doubled, NewLength, "newCapacity");
+    Value *Size = GB.CreateAdd(NewCapacity, GB.getInt64(StrHdrSize(C) + 1));
+    Value *AllocPtr = GB.CreateCall(ReallocF, ArrayRef<Value *>{ GB.CreatePointerCast(HdrPtr, Type::getInt8PtrTy(C)), Size });
+    Value *NewHdrPtr = GB.CreatePointerCast(AllocPtr, HdrTy->getPointerTo());
+    GB.CreateStore(NewCapacity, GB.CreateStructGEP(HdrTy, NewHdrPtr, StrHdrFieldCapacity));
+    Value *NewStrPtr = GB.CreateGEP(AllocPtr, GB.getInt64(StrHdrSize(C)));
+    GB.CreateBr(CopyBB);
+    
+    /* Copy Block */
+    IRBuilder<> CB(CopyBB);
+    PHINode *StrPtr = CB.CreatePHI(Type::getInt8PtrTy(C), 2, "str");
+    StrPtr->addIncoming(SArg, EntryBB);
+    StrPtr->addIncoming(NewStrPtr, GrowBB);
+    
+    MemCpy(CB.CreateGEP(StrPtr, OldLength), SrcArg, LArg, M, CB, 1);
+    CB.CreateStore(CB.getInt8(0), CB.CreateGEP(StrPtr, NewLength));
+    
+    Value *StrHdrPtr = StrHeader(StrPtr, CB);
+    CB.CreateStore(NewLength, CB.CreateStructGEP(HdrTy, StrHdrPtr, StrHdrFieldLength));
+    Value *FlagsPtr = CB.CreateStructGEP(HdrTy, StrHdrPtr, StrHdrFieldFlags);
+    CB.CreateStore(CB.CreateAnd(CB.CreateLoad(FlagsPtr), CB.getInt32(~StringFlagHashed)), FlagsPtr);
+    CB.CreateRet(StrPtr);
+  }
+  
+  // Call "strappend" function
+  return B.CreateCall(AppendF, ArrayRef<Value *>{ Str, Src, Length });
+}
+
+// i8* @strtruncate(i8* %str, i64 %length)
+Value * StrTruncate(Value *Str, Value *Length, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * strtruncate(char * s, long length) {
+   *   struct strhdr * hdr = header(s);
+   *   s[length] = '\0';
+   *   hdr->length = length;
+   *   hdr->flags &= ~StringFlagHashed;
+   *   return s;
+   * }
+   */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *TruncateF = cast<Function>(M->getOrInsertFunction("strtruncate", Type::getInt8PtrTy(C),
+                                                              Type::getInt8PtrTy(C),
+                                                              Type::getInt64Ty(C),
+                                                              (Type *)0));
+  if (TruncateF->empty()) {
+    Function::arg_iterator it = TruncateF->arg_begin();
+    Argument *SArg = it;
+    SArg->setName("str");
+    
+    Argument *LArg = ++it;
+    LArg->setName("length");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", TruncateF);
+    IRBuilder<> EB(EntryBB);
+    
+    Value *HdrPtr = StrHeader(SArg, EB);
+    EB.CreateStore(EB.getInt8(0), EB.CreateGEP(SArg, LArg));
+    EB.CreateStore(LArg, EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldLength));
+    Value *FlagsPtr = EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldFlags);
+    EB.CreateStore(EB.CreateAnd(EB.CreateLoad(FlagsPtr), EB.getInt32(~StringFlagHashed)), FlagsPtr);
+    EB.CreateRet(SArg);
+  }
+  
+  // Call "strtruncate" function
+  return B.CreateCall(TruncateF, ArrayRef<Value *>{ Str, Length });
+}
+
+/* 64x64 -> 128 bits multiply, folded (xor of both halves) */
+static Value * HashMix(Value *A, Value *V, IRBuilder<> &B)
+{
+  Type *Int128Ty = Type::getIntNTy(B.getContext(), 128);
+  Value *Product = B.CreateMul(B.CreateZExt(A, Int128Ty), B.CreateZExt(V, Int128Ty));
+  return B.CreateXor(B.CreateTrunc(Product, B.getInt64Ty()),
+                     B.CreateTrunc(B.CreateLShr(Product, 64), B.getInt64Ty()));
+}
+
+// i32 @strhash(i8* %str)
+Value * StrHash(Value *Str, Module *M, IRBuilder<> &B)
+{
+  /*
+   * unsigned strhash(const char * s) {
+   *   struct strhdr * hdr = header(s);
+   *   if (hdr->flags & StringFlagHashed)
+   *     return hdr->hash;
+   *
+   *   unsigned long hash = kStrHashSeed ^ (hdr->length * kStrHashP0);
+   *   long i = 0;
+   *   for (; i + 8 <= hdr->length; i += 8)
+   *     hash = mix(*(unsigned long *)&s[i] ^ kStrHashSecret0, hash ^ kStrHashSecret1);
+   *
+   *   unsigned long tail = 0;
+   *   for (long k = i; k < hdr->length; k++)
+   *     tail |= (unsigned long)(unsigned char)s[k] << (8 * (k - i));
+   *   hash = mix(tail ^ kStrHashSecret0 ^ hdr->length, hash ^ kStrHashSecret1);
+   *
+   *   hdr->hash = (unsigned)(hash ^ (hash >> 32));
+   *   hdr->flags |= StringFlagHashed;
+   *   return hdr->hash;
+   * }
+   */
+  
+  /* This uses a wyhash-like mix of 8 bytes at each step, "kStrHashSeed" is the random
+   * seed of this compilation (see "StrHashSeed()"), "kStrHashSecret*" are derived from it */
+  
+  LLVMContext &C = M->getContext();
+  
+  Function *HashF = cast<Function>(M->getOrInsertFunction("strhash", Type::getInt32Ty(C),
+                                                          Type::getInt8PtrTy(C),
+                                                          (Type *)0));
+  if (HashF->empty()) {
+    Argument *SArg = HashF->arg_begin();
+    SArg->setName("str");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", HashF);
+    BasicBlock *CachedBB = BasicBlock::Create(C, "CachedBlock", HashF);
+    BasicBlock *ComputeBB = BasicBlock::Create(C, "ComputeBlock", HashF);
+    BasicBlock *WordLoopBB = BasicBlock::Create(C, "WordLoop", HashF);
+    BasicBlock *WordBB = BasicBlock::Create(C, "WordBlock", HashF);
+    BasicBlock *TailLoopBB = BasicBlock::Create(C, "TailLoop", HashF);
+    BasicBlock *TailBB = BasicBlock::Create(C, "TailBlock", HashF);
+    BasicBlock *DoneBB = BasicBlock::Create(C, "Done", HashF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *HdrPtr = StrHeader(SArg, EB);
+    Value *HashPtr = EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldHash);
+    Value *FlagsPtr = EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldFlags);
+    Value *Flags = EB.CreateLoad(FlagsPtr);
+    Value *Length = EB.CreateLoad(EB.CreateStructGEP(getStrHdrTy(C), HdrPtr, StrHdrFieldLength));
+    
+    Value *IsHashed = EB.CreateICmpNE(EB.CreateAnd(Flags, EB.getInt32(StringFlagHashed)), EB.getInt32(0));
+    EB.CreateCondBr(IsHashed, CachedBB, ComputeBB);
+    
+    /* Cached Block */
+    IRBuilder<> CB(CachedBB);
+    CB.CreateRet(CB.CreateLoad(HashPtr));
+    
+    /* Compute Block */
+    IRBuilder<> CPB(ComputeBB);
+    Value *Seeded = CPB.CreateXor(CPB.getInt64(StrHashSeed()),
+                                  CPB.CreateMul(Length, CPB.getInt64(kStrHashP0)));
+    CPB.CreateBr(WordLoopBB);
+    
+    /* Word Loop: while (i + 8 <= length) */
+    IRBuilder<> WLB(WordLoopBB);
+    PHINode *Index = WLB.CreatePHI(Type::getInt64Ty(C), 2, "index");
+    Index->addIncoming(WLB.getInt64(0), ComputeBB);
+    PHINode *Hash = WLB.CreatePHI(Type::getInt64Ty(C), 2, "hash");
+    Hash->addIncoming(Seeded, ComputeBB);
+    Value *NextIndex = WLB.CreateAdd(Index, WLB.getInt64(8));
+    WLB.CreateCondBr(WLB.CreateICmpSLE(NextIndex, Length), WordBB, TailLoopBB);
+    
+    /* Word Block: 8 bytes at once (unaligned load) */
+    IRBuilder<> WB(WordBB);
+    Value *WordPtr = WB.CreatePointerCast(WB.CreateGEP(SArg, Index), Type::getInt64PtrTy(C));
+    Value *Word = WB.CreateAlignedLoad(WordPtr, 1);
+    Value *NextHash = HashMix(WB.CreateXor(Word, WB.getInt64(StrHashSecret(0))),
+                              WB.CreateXor(Hash, WB.getInt64(StrHashSecret(1))), WB);
+    Index->addIncoming(NextIndex, WordBB);
+    Hash->addIncoming(NextHash, WordBB);
+    WB.CreateBr(WordLoopBB);
+    
+    /* Tail Loop: the last 0 to 7 bytes */
+    IRBuilder<> TLB(TailLoopBB);
+    PHINode *TailIndex = TLB.CreatePHI(Type::getInt64Ty(C), 2, "tailIndex");
+    TailIndex->addIncoming(Index, WordLoopBB);
+    PHINode *Tail = TLB.CreatePHI(Type::getInt64Ty(C), 2, "tail");
+    Tail->addIncoming(TLB.getInt64(0), WordLoopBB);
+    TLB.CreateCondBr(TLB.CreateICmpSLT(TailIndex, Length), TailBB, DoneBB);
+    
+    IRBuilder<> TB(TailBB);
+    Value *Char64 = TB.CreateZExt(TB.CreateLoad(TB.CreateGEP(SArg, TailIndex)), Type::getInt64Ty(C));
+    Value *Shift = TB.CreateMul(TB.CreateSub(TailIndex, Index), TB.getInt64(8));
+    TailIndex->addIncoming(TB.CreateAdd(TailIndex, TB.getInt64(1)), TailBB);
+    Tail->addIncoming(TB.CreateOr(Tail, TB.CreateShl(Char64, Shift)), TailBB);
+    TB.CreateBr(TailLoopBB);
+    
+    /* Done Block */
+    IRBuilder<> DoneB(DoneBB);
+    Value *FinalHash64 = HashMix(DoneB.CreateXor(DoneB.CreateXor(Tail, DoneB.getInt64(StrHashSecret(0))), Length),
+                                 DoneB.CreateXor(Hash, DoneB.getInt64(StrHashSecret(1))), DoneB);
+    Value *FinalHash = DoneB.CreateTrunc(DoneB.CreateXor(FinalHash64, DoneB.CreateLShr(FinalHash64, 32)),
+                                         Type::getInt32Ty(C));
+    DoneB.CreateStore(FinalHash, HashPtr);
+    DoneB.CreateStore(DoneB.CreateOr(Flags, DoneB.getInt32(StringFlagHashed)), FlagsPtr);
+    DoneB.CreateRet(FinalHash);
+  }
+  
+  // Call "strhash" function
+  return B.CreateCall(HashF, Str);
+}
+
+uint64_t StrHashSeed()
+{
+  static uint64_t seed = 0;
+  static bool initialized = false;
+  if (!initialized) {
+    random_device device;
+    seed = ((uint64_t)device() << 32) ^ device();
+    initialized = true;
+  }
+  return seed;
+}
+
+uint64_t StrHashSecret(unsigned index)
+{
+  static uint64_t secrets[2];
+  static bool initialized = false;
+  if (!initialized) {
+    // splitmix64 from the seed (odd, never zero)
+    uint64_t state = StrHashSeed();
+    for (unsigned i = 0; i < 2; i++) {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      secrets[i] = (z ^ (z >> 31)) | 1;
+    }
+    initialized = true;
+  }
+  return secrets[index];
+}
+
+static inline uint64_t HostHashMix(uint64_t a, uint64_t b)
+{
+  unsigned __int128 product = (unsigned __int128)a * b;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+unsigned HostStrHash(const string &str)
+{
+  const uint64_t length = str.size();
+  uint64_t hash = StrHashSeed() ^ (length * kStrHashP0);
+  uint64_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, str.data() + i, 8); // Host byte order, like the generated loads
+    hash = HostHashMix(word ^ StrHashSecret(0), hash ^ StrHashSecret(1));
+  }
+  
+  uint64_t tail = 0;
+  for (uint64_t k = i; k < length; k++)
+    tail |= (uint64_t)(unsigned char)str[k] << (8 * (k - i));
+  hash = HostHashMix(tail ^ StrHashSecret(0) ^ length, hash ^ StrHashSecret(1));
+  
+  return (unsigned)(hash ^ (hash >> 32));
+}
+
+Constant * ConstStr(const string &str, Module *M)
+{
+  LLVMContext &C = M->getContext();
+  
+  Constant *Header = ConstantStruct::get(getStrHdrTy(C), ArrayRef<Constant *>{
+    ConstantInt::get(Type::getInt64Ty(C), str.size()),
+    ConstantInt::get(Type::getInt64Ty(C), str.size()),
+    ConstantInt::get(Type::getInt32Ty(C), HostStrHash(str)),
+    ConstantInt::get(Type::getInt32Ty(C), StringFlagHashed | StringFlagConstant),
+    ConstantInt::get(Type::getInt64Ty(C), 0) /* not counted */ });
+  Constant *Data = ConstantDataArray::getString(C, str, true /* add NUL */);
+  Constant *Init = ConstantStruct::getAnon(C, ArrayRef<Constant *>{ Header, Data });
+  
+  GlobalVariable *GV = new GlobalVariable(*M, Init->getType(), true /* constant */,
+                                          GlobalValue::PrivateLinkage, Init, "str");
+  
+  Constant *Idxs[] = {
+    ConstantInt::get(Type::getInt32Ty(C), 0),
+    ConstantInt::get(Type::getInt32Ty(C), 1),
+    ConstantInt::get(Type::getInt32Ty(C), 0) };
+  return ConstantExpr::getInBoundsGetElementPtr(Init->getType(), GV, Idxs);
+}
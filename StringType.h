@@ -0,0 +1,90 @@
+#ifndef SMIL_STRING_TYPE_H
+#define SMIL_STRING_TYPE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <string>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+using namespace std;
+using namespace llvm;
+
+/*
+ * Heap strings (and names used as keys into the table) are preceded by a header,
+ * the pointer (i8*) passed around is the one to the bytes (still NUL-terminated):
+ *   struct strhdr { long length; long capacity; unsigned hash; unsigned flags; long refcount; };
+ *   char data[capacity + 1];
+ */
+enum StringHeaderField {
+  StrHdrFieldLength = 0, // Number of bytes, without the NUL (long int (Int64))
+  StrHdrFieldCapacity, // Allocated bytes, without the NUL (long int (Int64))
+  StrHdrFieldHash, // Hash of the bytes, valid with StringFlagHashed (int (Int32), see "StrHash()")
+  StrHdrFieldFlags, // StringFlag (int (Int32))
+  StrHdrFieldRefCount // Number of owners, freed at zero (long int (Int64), see "RefCount.h")
+};
+
+enum StringFlag {
+  StringFlagHashed = 1 << 0, // |hash| is computed
+  StringFlagConstant = 1 << 1, // Global string, must not be written nor freed
+  StringFlagRegion = 1 << 2, // Temporary string from the region (see "Region.h"), not counted
+  StringFlagBigInt = 1 << 3, // Integer too large for a word: decimal digits, then the limbs (see "BigInt.h")
+  StringFlagInterned = 1 << 4 // Canonical name owned by the intern table (see "Intern.h"), not counted
+};
+
+StructType * getStrHdrTy(LLVMContext &C);
+
+/* Return the size (in bytes) of the "strhdr" type */
+unsigned StrHdrSize(LLVMContext &C);
+
+/* Header (%strhdr*) of the string |Str| (i8*) */
+Value * StrHeader(Value *Str, IRBuilder<> &B);
+
+/* Length (i64) of the string |Str| (i8*), without scan */
+Value * StrLength(Value *Str, IRBuilder<> &B);
+void SetStrLength(Value *Str, Value *Length, IRBuilder<> &B);
+
+/* New empty string with room for |Capacity| bytes (plus the NUL), owned by the caller (refcount = 1) */
+// i8* @newstr(i64 %capacity)
+Value * NewStr(Value *Capacity, Module *M, IRBuilder<> &B);
+
+/* Buffer for a string of |Length| bytes: |Scratch| (at least 8 bytes, without header) if the string
+ * is short enough to be stored inline into an object (see "PackStr()"), else a new string */
+// i8* @strbuffer(i64 %length, i8* %scratch)
+Value * StrBuffer(Value *Length, Value *Scratch, Module *M, IRBuilder<> &B);
+
+/* Append |Length| bytes of |Src| to |Str| in place (growing its capacity by doubling, so
+ * repeated appends take linear time), |Str| must be owned only by the caller (see "StrIsUnique()") */
+// i8* @strappend(i8* %str, i8* %src, i64 %length)
+Value * StrAppend(Value *Str, Value *Src, Value *Length, Module *M, IRBuilder<> &B);
+
+/* Keep the first |Length| bytes of |Str| (at most its length) in place, without copy (the capacity
+ * is kept for later appends), |Str| must be owned only by the caller (see "StrIsUnique()") */
+// i8* @strtruncate(i8* %str, i64 %length)
+Value * StrTruncate(Value *Str, Value *Length, Module *M, IRBuilder<> &B);
+
+/* Multiplier of the length into the string hash (from wyhash) */
+#define kStrHashP0 0xa0761d6478bd642fULL
+
+/* Seeded hash of the string (8 bytes at each step), computed on first call only (cached into the header) */
+// i32 @strhash(i8* %str)
+Value * StrHash(Value *Str, Module *M, IRBuilder<> &B);
+
+/* Seed of "@strhash", random for each compilation (names from the input can not be chosen to collide) */
+uint64_t StrHashSeed();
+
+/* Secrets xor-ed to both operands of each step of "@strhash" (|index| 0 for the bytes, 1 for the hash),
+ * derived from the seed: a public constant would let a block of the input cancel the state */
+uint64_t StrHashSecret(unsigned index);
+
+/* Host version of "@strhash" (for strings known at compile time) */
+unsigned HostStrHash(const string &str);
+
+/* Global string with its header (length and hash precomputed), returns the i8* to the bytes */
+Constant * ConstStr(const string &str, Module *M);
+
+#endif // SMIL_STRING_TYPE_H
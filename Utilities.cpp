@@ -1,4 +1,11 @@
+#include "llvm/IR/MDBuilder.h"
+
 #include "Utilities.h"
+#include "StringType.h"
+#include "RefCount.h"
+#include "BigInt.h"
+#include "Intern.h"
+#include "Runtime.h"
 
 void Assert(string err, int line, int col, bool shouldExit)
 {
@@ -10,7 +17,22 @@ void Assert(string err, int line, int col, bool shouldExit)
     exit(1);
 }
 
+MDNode * LikelyBranchWeights(LLVMContext &C)
+{
+  return MDBuilder(C).createBranchWeights(kBranchWeightLikely, kBranchWeightUnlikely);
+}
+
+MDNode * UnlikelyBranchWeights(LLVMContext &C)
+{
+  return MDBuilder(C).createBranchWeights(kBranchWeightUnlikely, kBranchWeightLikely);
+}
+
 void CreateInvalidBinopAssertion(Module *M, IRBuilder<> &B, int line, int col, bool shouldExit)
+{
+  CreateInvalidBinopAssertion(B.getInt32(line), B.getInt32(col), M, B, shouldExit);
+}
+
+void CreateInvalidBinopAssertion(Value *LineV, Value *ColV, Module *M, IRBuilder<> &B, bool shouldExit)
 {
   static Value *GInvalidBinOpAssertMessage = NULL;
   if (!GInvalidBinOpAssertMessage) {
@@ -18,19 +40,24 @@ void CreateInvalidBinopAssertion(Module *M, IRBuilder<> &B, int line, int col, b
                                                       "smil.invalid.operation.assert.message");
   }
   Value *FalseV = B.getInt1(false);
-  CreateAssert(FalseV, GInvalidBinOpAssertMessage,
-               M, B, line, col);
+  CreateAssert(FalseV, GInvalidBinOpAssertMessage, LineV, ColV,
+               M, B, shouldExit);
 }
 
 void CreateAssert(Value *CondV, Value *ErrMsgV, Module *M, IRBuilder<> &B, int line, int col, bool shouldExit)
+{
+  CreateAssert(CondV, ErrMsgV, B.getInt32(line), B.getInt32(col), M, B, shouldExit);
+}
+
+void CreateAssert(Value *CondV, Value *ErrMsgV, Value *LineV, Value *ColV, Module *M, IRBuilder<> &B, bool shouldExit)
 {
   LLVMContext &C = M->getContext();
   
-  // @TODO: Create branch depending of |CondV|
+  // The throw block is laid out cold
   Function *F = B.GetInsertBlock()->getParent();
   BasicBlock *TBB = BasicBlock::Create(C, "ThrowBlock", F);
   BasicBlock *CBB = BasicBlock::Create(C, "ContinueBlock", F);
-  B.CreateCondBr(CondV, CBB, TBB);
+  B.CreateCondBr(CondV, CBB, TBB, LikelyBranchWeights(C));
   
   B.SetInsertPoint(TBB);
   IRBuilder<> TB(TBB);
@@ -40,16 +67,8 @@ void CreateAssert(Value *CondV, Value *ErrMsgV, Module *M, IRBuilder<> &B, int l
                                                  "assert.default.format");
   }
   
-  // i32 @printf(i8*, ...)
-  Type* Args[] = { Type::getInt8PtrTy(C) };
-  FunctionType *FuncTy = FunctionType::get(Type::getInt32Ty(C), Args, true);
-  Function *PrintfF = cast<Function>(M->getOrInsertFunction("printf", FuncTy));
-  Value* PrintfArgs[] = {
-    CastToCStr(GAssertDefaultFormat, TB),
-    TB.getInt32(line), TB.getInt32(col),
-    CastToCStr(ErrMsgV, TB)
-  };
-  TB.CreateCall(PrintfF, PrintfArgs);
+  // Through the output of the program (flushed, see "Runtime.h")
+  RuntimeReport(CastToCStr(GAssertDefaultFormat, TB), LineV, ColV, CastToCStr(ErrMsgV, TB), M, TB);
   
   if (shouldExit) {
     Function *ExitF = cast<Function>(M->getOrInsertFunction("exit", Type::getVoidTy(C),
@@ -75,16 +94,8 @@ void CreateWarning(Value *WarningMsgV, Module *M, IRBuilder<> &B, int line, int
                                                  "warning.default.format");
   }
   
-  // i32 @printf(i8*, ...)
-  Type* Args[] = { Type::getInt8PtrTy(C) };
-  FunctionType *FuncTy = FunctionType::get(Type::getInt32Ty(C), Args, true);
-  Function *PrintfF = cast<Function>(M->getOrInsertFunction("printf", FuncTy));
-  Value* PrintfArgs[] = {
-    CastToCStr(GWarningDefaultFormat, B),
-    B.getInt32(line), B.getInt32(col),
-    CastToCStr(WarningMsgV, B)
-  };
-  B.CreateCall(PrintfF, PrintfArgs);
+  RuntimeReport(CastToCStr(GWarningDefaultFormat, B), B.getInt32(line), B.getInt32(col),
+                CastToCStr(WarningMsgV, B), M, B);
   
   if (shouldExit) {
     Function *ExitF = cast<Function>(M->getOrInsertFunction("exit", Type::getVoidTy(C),
@@ -140,105 +151,63 @@ Value * Atoi(Value *StrV, Module *M, IRBuilder<> &B)
   return StrToInt32(StrV, M, B);
 }
 
-Value * Strxch(Value *StrV, Value *Occurence, Module *M, IRBuilder<> &B)
+// i1 @strtointkey(i8* %str, i64* %int)
+Value * StrToIntKey(Value *StrV, Value *IntPtr, Module *M, IRBuilder<> &B)
 {
   /*
-   *   int occLen = strlen(occurence);
-   *   char * output = (char *)malloc(strlen(s) + 1);
-   *
-   *   char * outputPtr = (char *)s;
-   *   while (1) {
-   *     char * oldPtr = outputPtr;
-   *
-   *     outputPtr = strstr(outputPtr, occurence);
-   *     strncat(soutput, oldPtr, (outputPtr) ? (outputPtr-oldOutputPtr) : strlen(s));
-   *
-   *     outputPtr += occLen;
-   *     if (sstr == NULL) break;
-   *   }
+   * bool strtointkey(const char * s, long long * i) {
+   *   char buffer[21];
+   *   *i = atol(s);
+   *   sprintf(buffer, "%lld", *i);
+   *   return (strcmp(buffer, s) == 0);
+   * }
    */
   
   LLVMContext &C = M->getContext();
-  Function *F = B.GetInsertBlock()->getParent();
   
-  // int occLen = strlen(occurence);
-  Value *OccLen = Strlen(Occurence, M, B);
-  
-  Value *StrLen = Strlen(StrV, M, B);
-  
-  // char * output = (char *)malloc(strlen(s) + 1);
-  Value *Output = B.CreateAlloca(Type::getInt8Ty(C),
-                                 B.CreateAdd(StrLen,
-                                             B.getInt64(1)));
-  Output->setName("Output");
-  B.CreateMemSet(Output, B.getInt8(0), B.CreateAdd(StrLen, B.getInt64(1)), 8);
-  
-  // char * outputPtr = (char *)s;
-  Value *OutputPtr = B.CreateAlloca(Type::getInt64Ty(C));
-  OutputPtr->setName("OutputPtr");
-  B.CreateStore(B.CreatePtrToInt(StrV, Type::getInt64Ty(C)),
-                OutputPtr);
-  
-  // i8* @strstr(i8*, i8*)
-  Type* StrstrArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-  FunctionType *StrstrTy = FunctionType::get(Type::getInt8PtrTy(C), StrstrArgs, false);
-  Function *StrstrF = cast<Function>(M->getOrInsertFunction("strstr", StrstrTy));
-  
-  // i8* @strncat(i8*, i8*, i64)
-  Type* StrncatArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C), Type::getInt64Ty(C) };
-  FunctionType *StrncatTy = FunctionType::get(Type::getInt8PtrTy(C), StrncatArgs, false);
-  Function *StrncatF = cast<Function>(M->getOrInsertFunction("strncat", StrncatTy));
-  
-  BasicBlock *LoopBB = BasicBlock::Create(C, "LoopBlock", F);
-  B.CreateBr(LoopBB);
-  B.SetInsertPoint(LoopBB);
-  
-  BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", F);
-  
-  IRBuilder<> LoopB(LoopBB);
-  
-  // char * oldPtr = outputPtr;
-  Value *OldPtr = LoopB.CreateAlloca(Type::getInt64Ty(C));
-  LoopB.CreateStore(LoopB.CreateLoad(OutputPtr), OldPtr);
-  
-  // outputPtr = strstr(outputPtr, occurence);
-  Value* StrstrArgs2[] = {
-    LoopB.CreateIntToPtr(LoopB.CreateLoad(OutputPtr), Type::getInt8PtrTy(C)),
-    CastToCStr(Occurence, LoopB)
-  };
-  Value *Ptr = LoopB.CreateCall(StrstrF, StrstrArgs2);
-  Value *IntPtr = LoopB.CreatePtrToInt(Ptr, Type::getInt64Ty(C));
-  LoopB.CreateStore(IntPtr, OutputPtr);
-  
-  {
-    // strncat(soutput, oldOutputPtr, (outputPtr) ? (outputPtr-oldOutputPtr) : strlen(s));
-    Value* StrncatArgs[] = {
-      CastToCStr(Output, LoopB),
-      LoopB.CreateIntToPtr(LoopB.CreateLoad(OldPtr),
-                           Type::getInt8PtrTy(C)),
-      LoopB.CreateSelect(LoopB.CreateICmpEQ(IntPtr,
-                                            LoopB.getInt64(0)),
-                         StrLen,
-                         LoopB.CreateSub(LoopB.CreateLoad(OutputPtr),
-                                         LoopB.CreateLoad(OldPtr)))
-    };
-    LoopB.CreateCall(StrncatF, StrncatArgs);
+  Function *KeyF = cast<Function>(M->getOrInsertFunction("strtointkey", Type::getInt1Ty(C),
+                                                         Type::getInt8PtrTy(C),
+                                                         Type::getInt64PtrTy(C),
+                                                         (Type *)0));
+  if (KeyF->empty()) {
+    Function::arg_iterator it = KeyF->arg_begin();
+    Argument *SArg = it;
+    SArg->setName("str");
+    
+    Argument *IArg = ++it;
+    IArg->setName("int");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", KeyF);
+    IRBuilder<> EB(EntryBB);
+    EB.SetInsertPoint(EntryBB);
+    
+    static Value *GSprintfFormat = NULL;
+    if (!GSprintfFormat) GSprintfFormat = EB.CreateGlobalString("%lld", "sprintf.format");
+    
+    // i32 @sprintf(i8*, i8*, ...)
+    Type* SprintfArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
+    FunctionType *SprintfTy = FunctionType::get(Type::getInt32Ty(C), SprintfArgs, true);
+    Function *SprintfF = cast<Function>(M->getOrInsertFunction("sprintf", SprintfTy));
+    
+    // i32 @strcmp(i8*, i8*)
+    Type* StrcmpArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
+    FunctionType *StrcmpTy = FunctionType::get(Type::getInt32Ty(C), StrcmpArgs, false);
+    Function *StrcmpF = cast<Function>(M->getOrInsertFunction("strcmp", StrcmpTy));
+    
+    Value *IntV = StrToInt64(SArg, M, EB);
+    EB.CreateStore(IntV, IArg);
+    
+    // Print back the integer, the string is canonical if both are equal
+    Value *Buffer = EB.CreateAlloca(Type::getInt8Ty(C), EB.getInt32(20 /* = log10(2^64) */ + 1));
+    Value* SprintfParams[] = { Buffer, CastToCStr(GSprintfFormat, EB), IntV };
+    EB.CreateCall(SprintfF, SprintfParams);
+    
+    Value *Ret = EB.CreateCall(StrcmpF, ArrayRef<Value *>{ Buffer, SArg });
+    EB.CreateRet(EB.CreateICmpEQ(Ret, EB.getInt32(0)));
   }
   
-  // outputPtr += occLen;
-  Value *Offset = LoopB.CreateAdd(B.CreateLoad(OutputPtr), OccLen);
-  LoopB.CreateStore(Offset, OutputPtr);
-  
-  // if (sstr == NULL) break;
-  LoopB.CreateCondBr(LoopB.CreateICmpEQ(IntPtr,
-                                        LoopB.getInt64(0)),
-                     DoneBB,
-                     LoopBB);
-  
-  B.SetInsertPoint(DoneBB);
-  IRBuilder<> DoneB(DoneBB);
-  
-  return Output;
+  // Call "strtointkey" function
+  return B.CreateCall(KeyF, ArrayRef<Value *>{ CastToCStr(StrV, B), IntPtr });
 }
 
 Value * CxxStrToVal(string &str, Module *M, IRBuilder<> &B)
@@ -249,194 +218,329 @@ Value * CxxStrToVal(string &str, Module *M, IRBuilder<> &B)
   if ((V = strings[str]))
     return V;
   
-  V = CastToCStr(B.CreateGlobalString(str, str), B);
+  // With a header (length and hash computed now), interned once at the start of the function
+  // (before any name built at run time) so it can be used as a key into the table
+  Function *F = B.GetInsertBlock()->getParent();
+  IRBuilder<> EntryB(&F->getEntryBlock(), F->getEntryBlock().begin());
+  V = Intern(ConstStr(str, M), M, EntryB);
   strings[str] = V;
   return V;
 }
 
-Value * ObjToStr(Value *Obj, Module *M, IRBuilder<> &B)
+// i64 @packstr(i8* %str, i64 %length)
+Value * PackStr(Value *StrV, Value *Length, Module *M, IRBuilder<> &B)
 {
-  // @TODO: Create a function "@otos"
+  /*
+   * long packstr(const char * s, long length) {
+   *   if (length <= kObjectInlineStrMaxLength) {
+   *     long bytes = 0;
+   *     memcpy(&bytes, s, length);
+   *     return (bytes << 8) | (length << 2) | kObjectStrTagInline;
+   *   }
+   *   header(s)->length = length;
+   *   return ((long)s << 2) | kObjectStrTagHeap;
+   * }
+   */
+  
   LLVMContext &C = M->getContext();
   
-  Value *TypePtr = B.CreateStructGEP(getObjTy(C), Obj, ObjectFieldType);
-  Value *DataPtr = B.CreateStructGEP(getObjTy(C), Obj, ObjectFieldData);
+  Function *PackF = cast<Function>(M->getOrInsertFunction("packstr", Type::getInt64Ty(C),
+                                                          Type::getInt8PtrTy(C),
+                                                          Type::getInt64Ty(C),
+                                                          (Type *)0));
+  if (PackF->empty()) {
+    Function::arg_iterator it = PackF->arg_begin();
+    Argument *SArg = it;
+    SArg->setName("str");
+    
+    Argument *LArg = ++it;
+    LArg->setName("length");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", PackF);
+    BasicBlock *InlineBB = BasicBlock::Create(C, "InlineBlock", PackF);
+    BasicBlock *HeapBB = BasicBlock::Create(C, "HeapBlock", PackF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *BytesPtr = EB.CreateAlloca(Type::getInt64Ty(C));
+    BytesPtr->setName("bytes");
+    EB.CreateCondBr(EB.CreateICmpULE(LArg, EB.getInt64(kObjectInlineStrMaxLength)), InlineBB, HeapBB);
+    
+    /* Inline Block */
+    IRBuilder<> IB(InlineBB);
+    IB.CreateStore(IB.getInt64(0), BytesPtr);
+    MemCpy(IB.CreatePointerCast(BytesPtr, Type::getInt8PtrTy(C)), SArg, LArg, M, IB, 1);
+    Value *Word = IB.CreateOr(IB.CreateShl(IB.CreateLoad(BytesPtr), IB.getInt64(8)),
+                              IB.CreateShl(LArg, IB.getInt64(kObjectStrTagBits)));
+    IB.CreateRet(IB.CreateOr(Word, IB.getInt64(kObjectStrTagInline)));
+    
+    /* Heap Block */
+    IRBuilder<> HB(HeapBB);
+    SetStrLength(SArg, LArg, HB);
+    HB.CreateRet(StrToWord(SArg, HB));
+  }
   
-  Value *CompResult = B.CreateICmpEQ(B.CreateLoad(TypePtr),
-                                     B.getInt1(ObjectTypeInteger));
+  // Call "packstr" function
+  return B.CreateCall(PackF, ArrayRef<Value *>{ CastToCStr(StrV, B), Length });
+}
+
+// i64 @strwordlen(i64 %word)
+Value * StrWordLength(Value *Word, Module *M, IRBuilder<> &B)
+{
+  /*
+   * long strwordlen(long word) {
+   *   if ((word & kObjectStrTagMask) == kObjectStrTagInline)
+   *     return (word >> 2) & 7;
+   *   return header((char *)(word >> 2))->length;
+   * }
+   */
   
-  Function *F = B.GetInsertBlock()->getParent();
-  BasicBlock *IntBB = BasicBlock::Create(C, "IntegerBlock", F);
-  BasicBlock *StrBB = BasicBlock::Create(C, "StringBlock", F);
+  LLVMContext &C = M->getContext();
   
-  B.CreateCondBr(CompResult, IntBB, StrBB);
+  Function *LenF = cast<Function>(M->getOrInsertFunction("strwordlen", Type::getInt64Ty(C),
+                                                         Type::getInt64Ty(C),
+                                                         (Type *)0));
+  if (LenF->empty()) {
+    Function::arg_iterator it = LenF->arg_begin();
+    Argument *WArg = it;
+    WArg->setName("word");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", LenF);
+    BasicBlock *InlineBB = BasicBlock::Create(C, "InlineBlock", LenF);
+    BasicBlock *HeapBB = BasicBlock::Create(C, "HeapBlock", LenF);
+    
+    IRBuilder<> EB(EntryBB);
+    EB.CreateCondBr(WordIsInlineStr(WArg, EB), InlineBB, HeapBB);
+    
+    /* Inline Block */
+    IRBuilder<> IB(InlineBB);
+    IB.CreateRet(IB.CreateAnd(IB.CreateLShr(WArg, IB.getInt64(kObjectStrTagBits)),
+                              IB.getInt64(kObjectInlineStrMaxLength)));
+    
+    /* Heap Block */
+    IRBuilder<> HB(HeapBB);
+    HB.CreateRet(StrLength(WordToStr(WArg, HB), HB));
+  }
   
-  BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", F);
+  // Call "strwordlen" function
+  return B.CreateCall(LenF, ArrayRef<Value *>{ Word });
+}
+
+// i8* @otos(%obj* %obj)
+Value * ObjToStr(Value *Obj, Module *M, IRBuilder<> &B)
+{
+  /*
+   * char * otos(obj * obj) {
+   *   long word = obj->word;
+   *   if (is_integer(word))
+   *     return smil_rt_itos(word >> 1);
+   *   if (is_inline_string(word))
+   *     return copy(word);
+   *   return strown(str(word));
+   * }
+   */
   
+  LLVMContext &C = M->getContext();
   
-  /* Integer Block */
-  B.SetInsertPoint(IntBB);
-  IRBuilder<> IntB(IntBB);
-  Value *StrPtr = NULL;
-  {
-    static Value *GSprintfFormat = NULL;
-    if (!GSprintfFormat) GSprintfFormat = IntB.CreateGlobalString("%lld", "sprintf.format");
+  Function *OtosF = cast<Function>(M->getOrInsertFunction("otos", Type::getInt8PtrTy(C),
+                                                          getObjPtrTy(C),
+                                                          (Type *)0));
+  if (OtosF->empty()) {
+    Argument *OArg = OtosF->arg_begin();
+    OArg->setName("obj");
     
-    // i32 @sprintf(i8*, i8*, ...)
-    Type* SprintfArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-    FunctionType *SprintfTy = FunctionType::get(Type::getInt32Ty(C), SprintfArgs, true);
-    Function *SprintfF = cast<Function>(M->getOrInsertFunction("sprintf", SprintfTy));
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", OtosF);
+    BasicBlock *IntBB = BasicBlock::Create(C, "IntegerBlock", OtosF);
+    BasicBlock *StrBB = BasicBlock::Create(C, "StringBlock", OtosF);
+    BasicBlock *InlineBB = BasicBlock::Create(C, "InlineBlock", OtosF);
+    BasicBlock *HeapBB = BasicBlock::Create(C, "HeapBlock", OtosF);
     
-    Value *Size = IntB.getInt32(20 /* = log10(2^64) */ + 1);
-    StrPtr = IntB.CreateAlloca(Type::getInt8Ty(C), Size);
-    Value* SprintfArgs2[] = { StrPtr, CastToCStr(GSprintfFormat, IntB), IntB.CreateLoad(DataPtr) };
-    IntB.CreateCall(SprintfF, SprintfArgs2);
-  }
-  IntB.CreateBr(DoneBB);
-  
-  /* String Block */
-  B.SetInsertPoint(StrBB);
-  IRBuilder<> StrB(StrBB);
-  Value *AllocPtr = NULL;
-  {
-    Value *Str = StrB.CreateIntToPtr(StrB.CreateLoad(DataPtr), Type::getInt8PtrTy(C));
-    Value *Length = Strlen(Str, M, StrB);
-    Value *Size = StrB.CreateAdd(Length, StrB.getInt64(1));
+    IRBuilder<> EB(EntryBB);
+    Value *Word = LoadObjWord(OArg, EB);
+    EB.CreateCondBr(WordIsInteger(Word, EB), IntBB, StrBB);
+    
+    /* Integer Block */
+    // Allocated on the heap (like strings), the result can be kept as a key into the table
+    IRBuilder<> IntB(IntBB);
+    IntB.CreateRet(RuntimeIntToStr(WordToInt64(Word, IntB), M, IntB));
+    
+    /* String Block */
+    IRBuilder<> StrB(StrBB);
+    StrB.CreateCondBr(WordIsInlineStr(Word, StrB), InlineBB, HeapBB);
+    
+    /* Inline Block: the bytes are copied to a new string */
+    IRBuilder<> InlineB(InlineBB);
+    Value *Length = StrWordLength(Word, M, InlineB);
+    Value *AllocPtr = NewStr(Length, M, InlineB);
+    MemCpy(AllocPtr, WordToStr(Word, InlineB), InlineB.CreateAdd(Length, InlineB.getInt64(1)),
+           M, InlineB, 1);
+    SetStrLength(AllocPtr, Length, InlineB);
+    InlineB.CreateRet(AllocPtr);
     
-    // i8* @malloc(i64)
-    FunctionType *MallocTy = FunctionType::get(Type::getInt8PtrTy(C),
-                                               ArrayRef<Type *>{ Type::getInt64Ty(C) }, false);
-    Function *MallocF = cast<Function>(M->getOrInsertFunction("malloc", MallocTy));
-    AllocPtr = StrB.CreateCall(MallocF, Size); // |AllocPtr| : i8*
-    
-    // i8* @strcpy(i8*, i8*)
-    Type* StrcpyArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-    FunctionType *StrcpyTy = FunctionType::get(Type::getInt8PtrTy(C), StrcpyArgs, false /* not vararg */);
-    Function *StrcpyF = cast<Function>(M->getOrInsertFunction("strcpy", StrcpyTy));
-    StrB.CreateCall(StrcpyF, ArrayRef<Value *>{ AllocPtr, Str });
+    /* Heap Block: already a string with a header (strings are never modified), one more owner
+     * (copied out of the region for temporaries) */
+    IRBuilder<> HeapB(HeapBB);
+    HeapB.CreateRet(StrOwn(WordToStr(Word, HeapB), M, HeapB));
   }
-  StrB.CreateBr(DoneBB);
   
-  /* Done Block */
-  B.SetInsertPoint(DoneBB);
-  IRBuilder<> DoneB(DoneBB);
-  
-  PHINode * PHI = DoneB.CreatePHI(Type::getInt8PtrTy(C), 2);
-  PHI->addIncoming(StrPtr, IntBB);
-  PHI->addIncoming(AllocPtr, StrBB);
-  
-  return PHI;
+  // Call "otos" function
+  return B.CreateCall(OtosF, Obj);
 }
 
+// i64 @otoi64(%obj* %obj)
 Value * ObjToInt64(Value *Obj, Module *M, IRBuilder<> &B)
 {
-  // @TODO: Create a function "i64 otoi64(%obj*)"
+  /*
+   * long otoi64(obj * obj) {
+   *   long word = obj->word;
+   *   if (is_integer(word))
+   *     return word >> 1;
+   *   if (is_bigint(word))
+   *     return smil_bigint_saturated(word);
+   *   return strwordlen(word);
+   * }
+   */
   
   LLVMContext &C = M->getContext();
-  Value *IntPtr = B.CreateAlloca(Type::getInt64Ty(C));
-  Value *Data = B.CreateLoad(B.CreateStructGEP(getObjTy(C), Obj, ObjectFieldData));
   
+  Function *OtoiF = cast<Function>(M->getOrInsertFunction("otoi64", Type::getInt64Ty(C),
+                                                          getObjPtrTy(C),
+                                                          (Type *)0));
+  if (OtoiF->empty()) {
+    Argument *OArg = OtoiF->arg_begin();
+    OArg->setName("obj");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", OtoiF);
+    BasicBlock *IntBB = BasicBlock::Create(C, "IntegerBlock", OtoiF);
+    BasicBlock *StrBB = BasicBlock::Create(C, "StringBlock", OtoiF);
+    BasicBlock *BigBB = BasicBlock::Create(C, "BigIntBlock", OtoiF);
+    BasicBlock *LengthBB = BasicBlock::Create(C, "LengthBlock", OtoiF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *Word = LoadObjWord(OArg, EB);
+    EB.CreateCondBr(WordIsInteger(Word, EB), IntBB, StrBB);
+    
+    /* Integer Block */
+    IRBuilder<> IntB(IntBB);
+    IntB.CreateRet(WordToInt64(Word, IntB));
+    
+    /* String Block */
+    IRBuilder<> StrB(StrBB);
+    StrB.CreateCondBr(WordIsBigInt(Word, M, StrB), BigBB, LengthBB);
+    
+    /* Big Integer Block */
+    IRBuilder<> BigB(BigBB);
+    BigB.CreateRet(BigIntSaturated(Word, M, BigB));
+    
+    /* Length Block */
+    IRBuilder<> LengthB(LengthBB);
+    LengthB.CreateRet(StrWordLength(Word, M, LengthB));
+  }
+  
+  // Integers inline (conditions of loops), anything else by a call to "otoi64"
   Function *F = B.GetInsertBlock()->getParent();
   BasicBlock *IntBB = BasicBlock::Create(C, "Cast64.IntegerBlock", F);
-  BasicBlock *StrBB = BasicBlock::Create(C, "Cast64.StringBlock", F);
+  BasicBlock *CallBB = BasicBlock::Create(C, "Cast64.CallBlock", F);
   BasicBlock *DoneBB = BasicBlock::Create(C, "Cast64.DoneBlock", F);
   
-  Value *FieldPtr = B.CreateStructGEP(getObjTy(C), Obj, ObjectFieldType);
-  Value *CompResult = B.CreateICmpEQ(B.CreateLoad(FieldPtr),
-                                     B.getInt1(ObjectTypeInteger));
-  B.CreateCondBr(CompResult, IntBB, StrBB);
+  Value *Word = LoadObjWord(Obj, B);
+  B.CreateCondBr(WordIsInteger(Word, B), IntBB, CallBB, LikelyBranchWeights(C));
   
   /* Integer Block */
   IRBuilder<> IntB(IntBB);
-  B.SetInsertPoint(IntBB);
-  
-  IntB.CreateStore(Data, IntPtr);
-  
+  Value *IntV = WordToInt64(Word, IntB);
   IntB.CreateBr(DoneBB);
   
-  /* String Block */
-  IRBuilder<> StrB(StrBB);
-  B.SetInsertPoint(StrBB);
+  /* Call Block */
+  IRBuilder<> CallB(CallBB);
+  Value *CallV = CallB.CreateCall(OtoiF, Obj);
+  CallB.CreateBr(DoneBB);
   
-  Value * Ptr = StrB.CreateIntToPtr(Data, Type::getInt8PtrTy(C));
-  StrB.CreateStore(Strlen(Ptr, M, B), IntPtr);
-  
-  StrB.CreateBr(DoneBB);
+  /* Done Block */
   B.SetInsertPoint(DoneBB);
-  return B.CreateLoad(IntPtr);
+  PHINode *PHI = B.CreatePHI(Type::getInt64Ty(C), 2);
+  PHI->addIncoming(IntV, IntBB);
+  PHI->addIncoming(CallV, CallBB);
+  
+  return PHI;
 }
 
+// void @valtoobj(i8* %val, %obj* %obj)
 Value * ValToObj(Value *Val, Module *M, IRBuilder<> &B)
 {
-  // @TODO: Create a function "valtoobj"
   // @TODO: Save as float (and not a integer)
+  /*
+   * void valtoobj(const char * val, obj * obj) {
+   *   long d; char c;
+   *   if (sscanf(val, "%lld%s", &d, &c) == 1) { // Only an integer
+   *     obj->word = smil_bigint_fromstr(val);
+   *   } else {
+   *     long length = strlen(val);
+   *     char * s = strbuffer(length, scratch);
+   *     memcpy(s, val, length + 1);
+   *     obj->word = packstr(s, length);
+   *   }
+   * }
+   */
   
   LLVMContext &C = M->getContext();
-  Value *Ptr = B.CreateAlloca(getObjTy(C));
-  
-  static Value *GFormat = NULL;
-  if (!GFormat) GFormat = B.CreateGlobalString("%lld%s", "sscanf.format");
   
-  // i32 @sscanf(i8*, i8*, ...)
-  Type* SscanfArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
-  FunctionType *SscanfTy = FunctionType::get(Type::getInt32Ty(C), SscanfArgs, true);
-  Function *SscanfF = cast<Function>(M->getOrInsertFunction("sscanf", SscanfTy));
-  
-  // sscanf(s, "%lld%s", &d, &c)
-  Value *PrtD = B.CreateAlloca(Type::getInt32Ty(C));
-  Value *PrtC = B.CreateAlloca(Type::getInt8Ty(C));
-  Value* SscanfArgs2[] = { CastToCStr(Val, B), CastToCStr(GFormat, B), CastToCStr(PrtD, B), CastToCStr(PrtC, B) };
-  Value *RetV = B.CreateCall(SscanfF, SscanfArgs2);
-  
-  /* The "sscanf" function returns "1" on only integer (|d| converted and not |c|) */
-  Value *CompResult = B.CreateICmpEQ(RetV, B.getInt32(1));
-  
-  Function *F = B.GetInsertBlock()->getParent();
-  BasicBlock *IntBB = BasicBlock::Create(C, "IntegerBlock", F);
-  BasicBlock *StrBB = BasicBlock::Create(C, "StringBlock", F);
-  
-  B.CreateCondBr(CompResult, IntBB, StrBB);
-  
-  BasicBlock *DoneBB = BasicBlock::Create(C, "DoneBlock", F);
-  
-  /* Integer Block */
-  B.SetInsertPoint(IntBB);
-  IRBuilder<> IntB(IntBB);
-  
-  Value *IntV = StrToInt64(Val, M, IntB);
-  
-  Value *IFPtr = IntB.CreateStructGEP(getObjTy(C), Ptr, ObjectFieldData);
-  IntB.CreateStore(IntV, IFPtr);
-  
-  /* Update the index of the field used */
-  IntB.CreateStore(IntB.getInt1(ObjectTypeInteger),
-                   IntB.CreateStructGEP(getObjTy(C), Ptr, ObjectFieldType));
-  
-  IntB.CreateBr(DoneBB);
-  
-  /* String Block */
-  B.SetInsertPoint(StrBB);
-  IRBuilder<> StrB(StrBB);
-  
-  Value *CFPtr = StrB.CreateStructGEP(getObjTy(C), Ptr, ObjectFieldData);
-  
-  Value *Length = Strlen(Val, M, StrB);
-  Value *Size = StrB.CreateAdd(Length, StrB.getInt64(1));
-  Value *AllocPtr = StrB.CreateAlloca(Type::getInt8Ty(C), Size);
-  
-  StrB.CreateMemSet(AllocPtr, StrB.getInt8(0), Size, 8);
-  MemCpy(AllocPtr, Val, Length, M, StrB);
-  StrB.CreateStore(StrB.CreatePtrToInt(AllocPtr, Type::getInt64Ty(C)),
-                   CFPtr);
-  
-  /* Update the index of the field used */
-  StrB.CreateStore(StrB.getInt1(ObjectTypeString),
-                   StrB.CreateStructGEP(getObjTy(C), Ptr, ObjectFieldType));
-  
-  StrB.CreateBr(DoneBB);
+  Function *ValF = cast<Function>(M->getOrInsertFunction("valtoobj", Type::getVoidTy(C),
+                                                         Type::getInt8PtrTy(C),
+                                                         getObjPtrTy(C),
+                                                         (Type *)0));
+  if (ValF->empty()) {
+    Function::arg_iterator it = ValF->arg_begin();
+    Argument *VArg = it;
+    VArg->setName("val");
+    
+    Argument *OArg = ++it;
+    OArg->setName("obj");
+    
+    BasicBlock *EntryBB = BasicBlock::Create(C, "EntryBlock", ValF);
+    BasicBlock *IntBB = BasicBlock::Create(C, "IntegerBlock", ValF);
+    BasicBlock *StrBB = BasicBlock::Create(C, "StringBlock", ValF);
+    
+    IRBuilder<> EB(EntryBB);
+    Value *ScratchPtr = EB.CreateAlloca(Type::getInt64Ty(C));
+    Value *PrtD = EB.CreateAlloca(Type::getInt64Ty(C));
+    Value *PrtC = EB.CreateAlloca(Type::getInt8Ty(C));
+    
+    static Value *GFormat = NULL;
+    if (!GFormat) GFormat = EB.CreateGlobalString("%lld%s", "sscanf.format");
+    
+    // i32 @sscanf(i8*, i8*, ...)
+    Type* SscanfArgs[] = { Type::getInt8PtrTy(C), Type::getInt8PtrTy(C) };
+    FunctionType *SscanfTy = FunctionType::get(Type::getInt32Ty(C), SscanfArgs, true);
+    Function *SscanfF = cast<Function>(M->getOrInsertFunction("sscanf", SscanfTy));
+    
+    // sscanf(s, "%lld%s", &d, &c)
+    Value* SscanfArgs2[] = { VArg, CastToCStr(GFormat, EB), CastToCStr(PrtD, EB), PrtC };
+    Value *RetV = EB.CreateCall(SscanfF, SscanfArgs2);
+    
+    /* The "sscanf" function returns "1" on only integer (|d| converted and not |c|) */
+    EB.CreateCondBr(EB.CreateICmpEQ(RetV, EB.getInt32(1)), IntBB, StrBB);
+    
+    /* Integer Block */
+    // Integer word, or a big integer if too large
+    IRBuilder<> IntB(IntBB);
+    StoreObjWord(BigIntFromStr(VArg, M, IntB), OArg, IntB);
+    IntB.CreateRetVoid();
+    
+    /* String Block */
+    IRBuilder<> StrB(StrBB);
+    Value *Length = Strlen(VArg, M, StrB);
+    Value *Size = StrB.CreateAdd(Length, StrB.getInt64(1));
+    // Inputs are strings with a header too (or inline, nothing to free then)
+    Value *AllocPtr = StrBuffer(Length, CastToCStr(ScratchPtr, StrB), M, StrB);
+    
+    MemCpy(AllocPtr, VArg, Size, M, StrB, 1);
+    StoreObjWord(PackStr(AllocPtr, Length, M, StrB), OArg, StrB);
+    StrB.CreateRetVoid();
+  }
   
-  /* Done Block */
-  B.SetInsertPoint(DoneBB);
+  Value *Ptr = B.CreateAlloca(getObjTy(C)); // One object per input (kept by the table)
   
+  // Call "valtoobj" function
+  B.CreateCall(ValF, ArrayRef<Value *>{ CastToCStr(Val, B), Ptr });
   return Ptr;
 }
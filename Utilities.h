@@ -14,10 +14,20 @@
 using namespace std;
 using namespace llvm;
 
+#define kBranchWeightLikely 2000 // Same weights as "__builtin_expect()"
+#define kBranchWeightUnlikely 1
+
 void Assert(string err, int line, int col, bool shouldExit = true);
 
+/* Branch weights (for "IRBuilder::CreateCondBr()") of a condition almost always true, or false */
+MDNode * LikelyBranchWeights(LLVMContext &C);
+MDNode * UnlikelyBranchWeights(LLVMContext &C);
+
 void CreateInvalidBinopAssertion(Module *M, IRBuilder<> &B, int line, int col, bool shouldExit = true);
 
+/* Same with the position given at run time (i32), for code shared by several sites */
+void CreateInvalidBinopAssertion(Value *LineV, Value *ColV, Module *M, IRBuilder<> &B, bool shouldExit = true);
+
 /* Module *M = [...]; IRBuilder<> B = [...]; Value *CondV = [...];
  * CreateAssert(CondV,
  *              B.CreateGlobalString("this should be true", "SMILTrueAssertMessage"),
@@ -25,6 +35,8 @@ void CreateInvalidBinopAssertion(Module *M, IRBuilder<> &B, int line, int col, b
  */
 void CreateAssert(Value *CondV, Value *ErrMsgV, Module *M, IRBuilder<> &B, int line, int col, bool shouldExit = true);
 
+void CreateAssert(Value *CondV, Value *ErrMsgV, Value *LineV, Value *ColV, Module *M, IRBuilder<> &B, bool shouldExit = true);
+
 void CreateWarning(Value *WarningMsgV, Module *M, IRBuilder<> &B, int line, int col, bool shouldExit = false);
 
 /*
@@ -47,14 +59,33 @@ Value * StrToInt32(Value *StrV, Module *M, IRBuilder<> &B);
 
 Value * Atoi(Value *StrV, Module *M, IRBuilder<> &B);
 
-Value * Strxch(Value *StrV, Value *Occurence, Module *M, IRBuilder<> &B);
+/* Return true (i1) if |StrV| is the canonical decimal form of an integer (like "42" or "-7",
+ * but not "042", "+7" or " 7") and store this integer to |IntPtr| (i64*) */
+// i1 @strtointkey(i8* %str, i64* %int)
+Value * StrToIntKey(Value *StrV, Value *IntPtr, Module *M, IRBuilder<> &B);
 
+/* Interned global string (i8*) for the name |str| (see "Intern.h") */
 Value * CxxStrToVal(string &str, Module *M, IRBuilder<> &B);
 
+/* Tagged word of the string |StrV| of |Length| bytes: the bytes for short strings (inline),
+ * else |StrV| itself (which must stay valid) */
+// i64 @packstr(i8* %str, i64 %length)
+Value * PackStr(Value *StrV, Value *Length, Module *M, IRBuilder<> &B);
+
+/* Length of the string of a tagged word, without scan for inline strings */
+// i64 @strwordlen(i64 %word)
+Value * StrWordLength(Value *Word, Module *M, IRBuilder<> &B);
+
+/* String (with a header) of |Obj|, the caller must release it (see "RefCount.h") */
+// i8* @otos(%obj* %obj)
 Value * ObjToStr(Value *Obj, Module *M, IRBuilder<> &B);
 
+/* Integer value of |Obj|: integers inline, the length of strings (or a saturated big integer) by a call */
+// i64 @otoi64(%obj* %obj)
 Value * ObjToInt64(Value *Obj, Module *M, IRBuilder<> &B);
 
+/* New object (alloca) for the input |Val| (i8*): an integer if it's one, else a string */
+// void @valtoobj(i8* %val, %obj* %obj)
 Value * ValToObj(Value *Val, Module *M, IRBuilder<> &B);
 
 #endif // SMIL_UTILITIES_H
\ No newline at end of file